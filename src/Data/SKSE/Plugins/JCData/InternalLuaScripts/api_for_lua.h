@@ -51,6 +51,7 @@ handle JValue_release(handle obj);
 handle JValue_count(handle obj);
 uint32_t JValue_typeId(handle obj);
 JCToLuaValue JValue_solvePath(handle context, handle obj, cstring path);
+void JValue_solveMany(handle context, handle obj, const cstring* paths, uint32_t count, JCToLuaValue* results);
 
 JCToLuaValue JArray_getValue(handle obj, index key);
 void JArray_setValue(handle obj, index key, const JCValue* val);
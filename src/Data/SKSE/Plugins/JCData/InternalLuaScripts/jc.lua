@@ -300,6 +300,20 @@ function JValue.solvePath(optr, path)
   return returnLuaValue(jclib.JValue_solvePath(jc_context, optr.___id, path))
 end
 
+-- returns a table of the values at the paths, the paths sharing a prefix get resolved together
+function JValue.solveMany(optr, paths)
+  local count = #paths
+  local results = ffi.new('JCToLuaValue[?]', count)
+  -- the paths table keeps the strings alive during the call
+  jclib.JValue_solveMany(jc_context, optr.___id, ffi.new('cstring[?]', count, paths), count, results)
+
+  local values = {}
+  for i = 1, count do
+    values[i] = returnLuaValue(results[i - 1])
+  end
+  return values
+end
+
 -- JArray
 do
   -- converts 1-based positive indexes to 0-based, doesn't change negative ones
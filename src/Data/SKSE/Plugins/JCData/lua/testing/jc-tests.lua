@@ -34,6 +34,19 @@ return {
 
     assert(jc.accumulateValues(obj, math.max, '.magnitude') == 11)
     assert(jc.accumulateValues(obj, function(a,b) return a + b end, '.magnitude') == 5)
+  end,
+
+  solveMany = function()
+    local obj = JValue.objectFromPrototype [[
+      { "npc": { "stats": { "hp": 100, "mp": 50.5 }, "name": "Lydia" } }
+    ]]
+
+    local values = JValue.solveMany(obj, { '.npc.stats.hp', '.npc.stats.mp', '.npc.name', '.npc.missing', '.npc.stats@sum.value' })
+    assert(values[1] == 100)
+    assert(values[2] == 50.5)
+    assert(values[3] == 'Lydia')
+    assert(values[4] == nil)
+    assert(values[5] == 150.5)
   end
 
 }
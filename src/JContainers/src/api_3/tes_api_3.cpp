@@ -8,6 +8,7 @@
 #include <set>
 #include <thread>
 #include <array>
+#include <unordered_map>
 
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
@@ -17,6 +18,7 @@
 #include "gtest.h"
 #include "util/util.h"
 #include "jcontainers_constants.h"
+#include "rw_mutex.h"
 
 #include "skse/string.h"
 #include "skse/papyrus_args.hpp"
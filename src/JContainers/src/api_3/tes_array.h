@@ -26,15 +26,15 @@ namespace tes_api_3 {
 
         // TODO: are these to go to private, all used?
         static bool validateReadIndex(const array *obj, UInt32 index) {
-            return obj && index < obj->_array.size();
+            return obj && index < (UInt32)obj->u_count();
         }
 
         static bool validateReadIndexRange(const array *obj, UInt32 begin, UInt32 end) {
-            return obj && begin < end && end <= obj->_array.size();
+            return obj && begin < end && end <= (UInt32)obj->u_count();
         }
 
         static bool validateWriteIndex(const array *obj, UInt32 index) {
-            return obj && index <= obj->_array.size();
+            return obj && index <= (UInt32)obj->u_count();
         }
 
         typedef array::Index Index;
@@ -50,7 +50,7 @@ namespace tes_api_3 {
 
             auto& obj = array::objectWithInitializer ([&] (array &me)
             {
-                me._array.resize (size);
+                me.u_resize (size);
             }
             , ctx);
 
@@ -64,11 +64,11 @@ namespace tes_api_3 {
             JC_LOG_API ("...");
 
             auto obj = &array::objectWithInitializer([&](array &me) {
-                me.u_container().reserve(arr.Length());
+                me.u_reserve(arr.Length());
                 for (UInt32 i = 0; i < arr.Length(); ++i) {
                     TesType val;
                     arr.Get(&val, i);
-                    me.u_container().emplace_back(reflection::binding::get_converter<JCType>::convert2J(val, ctx));
+                    me.u_push(reflection::binding::get_converter<JCType>::convert2J(val, ctx));
                 }
             },
                 ctx);
@@ -98,7 +98,7 @@ objectWithBooleans converts booleans into integers");
             }
 
             auto obj = &array::objectWithInitializer([&](array &me) {
-                me._array.insert(me.begin(), source->begin() + startIndex, source->begin() + endIndex);
+                me.u_insert(0, *source, startIndex, endIndex);
             },
                 ctx);
 
@@ -117,7 +117,7 @@ objectWithBooleans converts booleans into integers");
             object_lock g2(another);
 
             doWriteOp(obj, insertAtIndex, [&obj, &another](uint32_t whereTo) {
-                obj->_array.insert(obj->begin() + whereTo, another->begin(), another->end());
+                obj->u_insert(whereTo, *another, 0, another->u_count());
             });
         }
         REGISTERF2(addFromArray, "* source insertAtIndex=-1",
@@ -135,7 +135,7 @@ NEGATIVE_IDX_COMMENT);
             struct inserter : BGSListForm::Visitor {
 
                 virtual bool Accept(TESForm * form) override {
-                    arr->u_container().insert(arr->u_container().begin() + insertIdx, item{ make_weak_form_id(form, context) });
+                    arr->u_insert(insertIdx, item{ make_weak_form_id(form, context) });
                     return false;
                 }
 
@@ -158,7 +158,7 @@ NEGATIVE_IDX_COMMENT);
             JC_LOG_API ("%p, %d, ...", (void*) obj, index);
 
             doReadOp(obj, index, [=, &t](uint32_t idx) {
-                t = obj->_array[idx].readAs<T>();
+                t = obj->u_item_at(idx).readAs<T>();
             });
 
             return t;
@@ -181,11 +181,12 @@ NEGATIVE_IDX_COMMENT);
             if (!obj)
                 return v;
 
-            object_lock lck (obj);
-            v.reserve (obj->_array.size ());
+            object_read_lock lck (obj);
+            const SInt32 count = obj->u_count ();
+            v.reserve (count);
 
-            for (auto& i : obj->_array)
-                v.emplace_back (i.readAs<T> ());
+            for (SInt32 i = 0; i < count; ++i)
+                v.emplace_back (obj->u_item_at (i).readAs<T> ());
 
             return v;
         }
@@ -206,11 +207,11 @@ NEGATIVE_IDX_COMMENT);
 
             doReadOp(obj, pySearchStartIndex, [=, &result](uint32_t idx) {
                 if (pySearchStartIndex >= 0) {
-                    auto itr = std::find(obj->begin() + idx, obj->end(), item(value));
-                    result = itr != obj->end() ? (itr - obj->begin()) : -1;
+                    result = obj->u_find(item(value), idx);
                 } else {
-                    auto itr = std::find(obj->rbegin() + (-pySearchStartIndex - 1), obj->rend(), item(value));
-                    result = itr != obj->rend() ? (obj->rend() - itr) : -1;
+                    // the reverse search has always reported the position following the found item
+                    auto found = obj->u_rfind(item(value), idx);
+                    result = found != -1 ? found + 1 : -1;
                 }
             });
 
@@ -226,6 +227,39 @@ NEGATIVE_IDX_COMMENT);
         REGISTERF(findVal<object_base*>, "findObj", "* container searchStartIndex=0", "");
         REGISTERF(findVal<form_ref>, "findForm", "* value searchStartIndex=0", "");
 
+        static void createIndex(tes_context& ctx, ref obj, const char *path)
+        {
+            JC_LOG_API ("%p, %s", (void*) obj, path);
+
+            if (obj && path) {
+                create_index(ctx, *obj, path);
+            }
+        }
+        REGISTERF2(createIndex, "* path",
+"Indexes the containers of the array by their values at the @path, so that the findByIndex functions\n\
+find an item without looking through all of them. For example, the \".name\" index finds a map of the array by its name.\n\
+The array keeps the index up to date when its items get added, removed or replaced,\n\
+but it doesn't see the values change inside of the contained containers: see findIntByIndex.\n\
+Only integer, float, string (case-insensitively) and form values get indexed. The indexes are not saved");
+
+        template<class T>
+        static SInt32 findByIndex(tes_context& ctx, ref obj, const char *path, T value)
+        {
+            JC_LOG_API ("%p, %s, ...", (void*) obj, path);
+
+            return obj && path ? find_by_index(ctx, *obj, path, item(value)) : -1;
+        }
+        REGISTERF(findByIndex<SInt32>, "findIntByIndex", "* path value",
+"Returns the index of the first container whose value at the @path equals the @value, or -1.\n\
+Uses the index created by createIndex, searches through all the items if there is no index for the @path.\n\
+The values changed inside of the contained containers after the indexing are still found: if the index\n\
+has no match, all the items are searched through, so a miss costs as much as without the index.\n\
+But if the index has a match, a container which got the @value later may be skipped for that match.\n\
+The changed items found by the function are indexed again, createIndex re-indexes all of them");
+        REGISTERF(findByIndex<Float32>, "findFltByIndex", "* path value", "");
+        REGISTERF(findByIndex<const char *>, "findStrByIndex", "* path value", "");
+        REGISTERF(findByIndex<form_ref>, "findFormByIndex", "* path value", "");
+
         template<class T>
         static SInt32 count_item (tes_context& ctx, ref obj, T value)
         {
@@ -235,8 +269,7 @@ NEGATIVE_IDX_COMMENT);
             if (obj) 
             {
                 object_lock g (obj);
-                auto n = std::count (obj->u_container ().begin (), obj->u_container ().end (), item (value));
-                result = static_cast<SInt32> (n);
+                result = static_cast<SInt32> (obj->u_count_equal (item (value)));
             }
             return result;
         }
@@ -251,8 +284,9 @@ NEGATIVE_IDX_COMMENT);
         {
             JC_LOG_API ("%p, %d, ...", (void*) obj, index);
 
-            doReadOp(obj, index, [=](uint32_t idx) {
-                obj->_array[idx] = item(val);
+            item value = ctx.make_item(val);
+            doUpdateOp(obj, index, [&](uint32_t idx) {
+                obj->u_replace(idx, std::move(value));
             });
         }
         REGISTERF(replaceItemAtIndex<SInt32>, "setInt", "* index value", "Replaces existing value at the @index of the array with the new @value.\n"
@@ -267,8 +301,9 @@ NEGATIVE_IDX_COMMENT);
         {
             JC_LOG_API ("%p, ..., %d", (void*) obj, addToIndex);
 
+            item value = ctx.make_item(val);
             doWriteOp(obj, addToIndex, [&](uint32_t idx) {
-                (void)obj->_array.emplace(obj->begin() + idx, val);
+                obj->u_insert(idx, std::move(value));
             });
         }
         REGISTERF(addItemAt<SInt32>, "addInt", "* value addToIndex=-1", "Appends the @value/@container to the end of the array.\n\
@@ -294,8 +329,8 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
         {
             JC_LOG_API ("%p, %d", (void*) obj, index);
 
-            doReadOp(obj, index, [=](uint32_t idx) {
-                obj->_array.erase(obj->begin() + idx);
+            doUpdateOp(obj, index, [=](uint32_t idx) {
+                obj->u_erase(idx, idx + 1);
             });
         }
         REGISTERF2(eraseIndex, "* index", "Erases the item at the index. "NEGATIVE_IDX_COMMENT);
@@ -309,9 +344,9 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
             // -1 is 4th index
             // begin + 4 is last, valid iterator
             SInt32 pyIndexes[] { first, last };
-            doReadOp(obj, pyIndexes, [=](const std::array<uint32_t, 2>& indices) {
+            doUpdateOp(obj, pyIndexes, [=](const std::array<uint32_t, 2>& indices) {
                 if (indices[0] <= indices[1]) {
-                    obj->_array.erase(obj->begin() + indices[0], obj->begin() + indices[1] + 1);
+                    obj->u_erase(indices[0], indices[1] + 1);
                 }
             });
         }
@@ -327,9 +362,7 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
             if (obj) 
             {
                 object_lock g (obj);
-                auto new_end = std::remove (obj->u_container ().begin (), obj->u_container ().end (), item (value));
-                result = static_cast<SInt32> (std::distance (new_end, obj->u_container ().end ()));
-                obj->u_container ().erase (new_end, obj->u_container ().end ());
+                result = static_cast<SInt32> (obj->u_erase_equal (item (value)));
             }
             return result;
         }
@@ -345,7 +378,7 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
 
             SInt32 type = item_type::no_item;
             doReadOp(obj, index, [=, &type](uint32_t idx) {
-                type = obj->_array[idx].type();
+                type = obj->u_type_at(idx);
             });
 
             return type;
@@ -357,10 +390,10 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
             JC_LOG_API ("%p, %d, %d", (void*) obj, idx, idx2);
 
             SInt32 pyIndexes[] = { idx, idx2 };
-            doReadOp(obj, pyIndexes, [=](const std::array<uint32_t, 2>& indices) {
+            doUpdateOp(obj, pyIndexes, [=](const std::array<uint32_t, 2>& indices) {
 
                 if (indices[0] != indices[1]) {
-                    std::swap(obj->u_container()[indices[0]], obj->u_container()[indices[1]]);
+                    obj->u_swap_items(indices[0], indices[1]);
                 }
             });
         }
@@ -372,7 +405,7 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
 
             if (obj) {
                 object_lock g(obj);
-                std::sort(obj->u_container().begin(), obj->u_container().end());
+                obj->u_apply([](auto& values) { std::sort(values.begin(), values.end()); });
             }
             return obj;
         }
@@ -384,9 +417,10 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
 
             if (obj) {
                 object_lock g(obj);
-                std::sort(obj->u_container().begin(), obj->u_container().end());
-                auto newEnd = std::unique(obj->u_container().begin(), obj->u_container().end());
-                obj->u_container().erase(newEnd, obj->u_container().end());
+                obj->u_apply([](auto& values) {
+                    std::sort(values.begin(), values.end());
+                    values.erase(std::unique(values.begin(), values.end()), values.end());
+                });
             }
             return obj;
         }
@@ -398,7 +432,7 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
             if (obj) 
             {
                 object_lock g (obj);
-                std::reverse (obj->u_container ().begin (), obj->u_container ().end ());
+                obj->u_apply ([](auto& values) { std::reverse (values.begin (), values.end ()); });
             }
             return obj;
         }
@@ -446,11 +480,10 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
 
             for (int32_t i = 0; i < countToRead; ++i) {
 
-                const item& itemVal = (*obj)[i + *readIdx];
-                auto *valuePtr = itemVal.get<ValueType>();
+                const item itemVal = obj->u_item_at(i + *readIdx);
 
-                if (valuePtr) {
-                    auto tesValue = converter_t::convert2Tes(*valuePtr);
+                if (itemVal.is_type<ValueType>()) {
+                    auto tesValue = converter_t::convert2Tes(itemVal.readAs<ValueType>());
                     targetArray.Set(&tesValue, i + *fstIdx);
                 } else {
                     targetArray.Set(&tesValueDefault, i + *fstIdx);
@@ -25,8 +25,6 @@ namespace tes_api_3 {
             T previousVal = default_value<T>();
             bool assing_succeed = true;
 
-            using internal_item_type = typename item::user2variant_t<T>;
-
             bool succeed = ca::visit_value(
                 *obj, path,
                 createMissingKeys ? ca::creative : ca::constant,
@@ -34,18 +32,56 @@ namespace tes_api_3 {
                     if (item_value.isNull()) {
                         item_value = func(initialValue, inputValue);
                     }
-                    else if (internal_item_type *asT = item_value.get<internal_item_type>()) {
-                        previousVal = const_cast<const internal_item_type&>(*asT);
-                        *asT = func(const_cast<const internal_item_type&>(*asT), inputValue);
-                    }
                     else {
-                        assing_succeed = false;
+                        assing_succeed = modify_item(item_value, previousVal,
+                            [&](const auto& current) { return func(current, inputValue); },
+                            is_copied<T>{});
                     }
                 });
 
             return (succeed && assing_succeed) ? previousVal : onError;
         }
 
+        template<class T>
+        using is_copied = std::integral_constant<bool,
+            std::is_same<item::user2variant_t<T>, std::string>::value || std::is_same<item::user2variant_t<T>, form_ref>::value>;
+
+        // Strings and forms have no in-place representation inside an item, the other types are modified in-place
+        template<class T, class F>
+        static bool modify_item(item& itm, T& previousVal, F&& modify, std::false_type) {
+            using internal_item_type = typename item::user2variant_t<T>;
+            if (internal_item_type *asT = itm.get<internal_item_type>()) {
+                previousVal = const_cast<const internal_item_type&>(*asT);
+                *asT = modify(const_cast<const internal_item_type&>(*asT));
+                return true;
+            }
+            return false;
+        }
+
+        template<class T, class F>
+        static bool modify_item(item& itm, T& previousVal, F&& modify, std::true_type) {
+            if (itm.is_type<T>()) {
+                previousVal = itm.readAs<item::user2variant_t<T>>();
+                itm = modify(const_cast<const T&>(previousVal));
+                return true;
+            }
+            return false;
+        }
+
+        template<class T>
+        static void read_item(const item& itm, T& value, std::false_type) {
+            if (const auto* valuePtr = itm.get<T>()) {
+                value = *valuePtr;
+            }
+        }
+
+        template<class T>
+        static void read_item(const item& itm, T& value, std::true_type) {
+            if (itm.is_type<T>()) {
+                value = itm.readAs<item::user2variant_t<T>>();
+            }
+        }
+
         struct ignore_first {
             template<class T, class D>
             T&& operator()(const D&, T&& newValue) const {
@@ -85,19 +121,10 @@ namespace tes_api_3 {
                 *obj, path,
                 createMissingKeys ? ca::creative : ca::constant,
                 [&](item& itemValue) {
-                    if (itemValue == comparer) {
-
-                        if (auto* valuePtr = itemValue.get<T>()) {
-                            previousVal = std::move(*valuePtr);
-                        }
+                    read_item(itemValue, previousVal, is_copied<T>{});
 
+                    if (itemValue == comparer) {
                         itemValue = std::move(newValue);
-                    } else {
-
-                        if (const auto* valuePtr = itemValue.get<T>()) {
-                            previousVal = *valuePtr;
-                        }
-
                     }
                 });
 
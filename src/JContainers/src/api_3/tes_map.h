@@ -6,6 +6,25 @@ namespace tes_api_3 {
 
     using namespace collections;
 
+    const char *tes_map_getNthKey_comment = "Retrieves N-th key. " NEGATIVE_IDX_COMMENT "\nThe complexity is O(1) for JIntMap. For JMap and JFormMap it's O(1) until the keys get removed, O(log n) after that";
+
+    const char *tes_map_nextKey_comment =
+R"===(Simplifies iteration over container's contents.
+Accepts the @previousKey, returns the next key.
+If @previousKey == @endKey the function returns the first key.
+The function always returns so-called 'valid' keys (the ones != @endKey).
+The function returns @endKey ('invalid' key) only once to signal that iteration has reached its end.
+In most cases, if the map doesn't contain an invalid key ("" for JMap, None form-key for JFormMap)
+it's ok to omit the @endKey.
+
+Usage:
+
+    string key = JMap.nextKey(map, previousKey="", endKey="")
+    while key != ""
+      <retrieve values here>
+      key = JMap.nextKey(map, key, endKey="")
+    endwhile
+)===";
 
     template<class Key
         , class Cnt
@@ -43,7 +62,7 @@ namespace tes_api_3 {
         template<class T>
         static void setItem(tes_context& ctx, ref obj, key_cref key, T val) {
             JC_LOG_API ("%p, ..., ...", (void*) obj);
-            map_functions::doWriteOp(obj, key, [&](item& itm) { itm = val; });
+            map_functions::doWriteOp(obj, key, [&](item& itm) { itm = ctx.make_item(val); });
         }
         REGISTERF(setItem<SInt32>, "setInt", "* key value", "Inserts @key: @value pair. Replaces existing pair with the same @key");
         REGISTERF(setItem<Float32>, "setFlt", "* key value", "");
@@ -51,6 +70,81 @@ namespace tes_api_3 {
         REGISTERF(setItem<object_base*>, "setObj", "* key container", "");
         REGISTERF(setItem<form_ref>, "setForm", "* key value", "");
 
+        //////////////////////////////////////////////////////////////////////////
+
+        using tes_key_in = reflection::binding::convert_to_tes_type<Key>;
+
+        // reads the Papyrus keys. The converted string keys point into the @tesKeys
+        static std::vector<Key> readKeys(tes_context& ctx, VMArray<tes_key_in>& keysArray, std::vector<tes_key_in>& tesKeys) {
+            const UInt32 count = keysArray.Length();
+            tesKeys.resize(count);
+            std::vector<Key> keys;
+            keys.reserve(count);
+            for (UInt32 i = 0; i < count; ++i) {
+                keysArray.Get(&tesKeys[i], i);
+                keys.push_back(reflection::binding::get_converter<Key>::convert2J(tesKeys[i], ctx));
+            }
+            return keys;
+        }
+
+        template<class T>
+        static void setItemMany(tes_context& ctx, ref obj, VMArray<tes_key_in> keysArray,
+            VMArray<reflection::binding::convert_to_tes_type<T>> valuesArray)
+        {
+            JC_LOG_API ("%p, ..., ...", (void*) obj);
+
+            if (!obj) {
+                return;
+            }
+
+            std::vector<tes_key_in> tesKeys;
+            auto keys = readKeys(ctx, keysArray, tesKeys);
+
+            const UInt32 count = (std::min)(keysArray.Length(), valuesArray.Length());
+            std::vector<item> values;
+            values.reserve(count);
+            for (UInt32 i = 0; i < count; ++i) {
+                reflection::binding::convert_to_tes_type<T> val;
+                valuesArray.Get(&val, i);
+                values.emplace_back(ctx.make_item(reflection::binding::get_converter<T>::convert2J(val, ctx)));
+            }
+
+            map_functions::setMany(obj, keys, std::move(values));
+        }
+        REGISTERF(setItemMany<SInt32>, "setIntMany", "* keys values", "Inserts @keys[i]: @values[i] pairs, taking the lock once. Replaces existing pairs with the same keys.\n"
+            "If the arrays differ in length, the extra keys or values are ignored");
+        REGISTERF(setItemMany<Float32>, "setFltMany", "* keys values", "");
+        REGISTERF(setItemMany<const char *>, "setStrMany", "* keys values", "");
+        REGISTERF(setItemMany<object_base*>, "setObjMany", "* keys values", "");
+        REGISTERF(setItemMany<form_ref>, "setFormMany", "* keys values", "");
+
+        template<class T>
+        static VMResultArray<reflection::binding::convert_to_tes_type<T>> getItemMany(tes_context& ctx, ref obj,
+            VMArray<tes_key_in> keysArray, T def = default_value<T>())
+        {
+            JC_LOG_API ("%p, ...", (void*) obj);
+
+            std::vector<tes_key_in> tesKeys;
+            auto keys = readKeys(ctx, keysArray, tesKeys);
+
+            std::vector<boost::optional<item>> found;
+            map_functions::getMany(obj, keys, found);
+
+            // the conversion happens outside of the lock, the found items keep the objects alive
+            VMResultArray<reflection::binding::convert_to_tes_type<T>> values;
+            values.reserve(found.size());
+            for (const auto& itm : found) {
+                values.push_back(reflection::binding::get_converter<T>::convert2Tes(itm ? itm->readAs<T>() : def));
+            }
+            return values;
+        }
+        REGISTERF(getItemMany<SInt32>, "getIntMany", "* keys default=0", "Returns an array of the values associated with the @keys, taking the lock once.\n"
+            "The missing keys produce @default values");
+        REGISTERF(getItemMany<Float32>, "getFltMany", "* keys default=0.0", "");
+        REGISTERF(getItemMany<skse::string_ref>, "getStrMany", "* keys default=\"\"", "");
+        REGISTERF(getItemMany<object_base*>, "getObjMany", "* keys default=0", "");
+        REGISTERF(getItemMany<form_ref>, "getFormMany", "* keys default=None", "");
+
         static bool hasKey(tes_context& ctx, ref obj, key_cref key) {
             JC_LOG_API ("%p, ...", (void*) obj);
             return valueType(ctx, obj, key) != 0;
@@ -65,6 +159,13 @@ namespace tes_api_3 {
         }
         REGISTERF2(valueType, "* key", "Returns type of the value associated with the @key.\n"VALUE_TYPE_COMMENT);
 
+        // JMap and JFormMap keep the keys in the insertion order, JIntMap sorts them
+        static const char * keys_order_comment();
+
+        static std::string allKeys_comment() {
+            return std::string("Returns a new array containing all keys.\n") + keys_order_comment();
+        }
+
         static object_base* allKeys(tes_context& ctx, ref obj)
         {
             JC_LOG_API ("%p", (void*) obj);
@@ -76,14 +177,14 @@ namespace tes_api_3 {
             return &array::objectWithInitializer([&](array &arr) {
                 object_lock g(obj);
 
-                arr._array.reserve(obj->u_count());
+                arr.u_reserve(obj->u_count());
                 for each(auto& pair in obj->u_container()) {
-                    arr.u_container().emplace_back(pair.first);
+                    arr.u_push(pair.first);
                 }
             },
                 ctx);
         }
-        REGISTERF(allKeys, "allKeys", "*", "Returns a new array containing all keys");
+        REGISTERF(allKeys, "allKeys", "*", &allKeys_comment);
 
         static VMResultArray<tes_key> allKeysPArray(tes_context& ctx, ref obj)
         {
@@ -105,7 +206,7 @@ namespace tes_api_3 {
 
             return keys;
         }
-        REGISTERF2(allKeysPArray, "*", "");
+        REGISTERF2(allKeysPArray, "*", &allKeys_comment);
 
         static object_base* allValues(tes_context& ctx, ref obj)
         {
@@ -118,9 +219,9 @@ namespace tes_api_3 {
             return &array::objectWithInitializer([&](array &arr) {
                 object_lock g(obj);
 
-                arr._array.reserve(obj->u_count());
+                arr.u_reserve(obj->u_count());
                 for each(auto& pair in obj->u_container()) {
-                    arr._array.push_back(pair.second);
+                    arr.u_push(pair.second);
                 }
             },
                 ctx);
@@ -184,6 +285,31 @@ namespace tes_api_3 {
         }
         REGISTERF2(addPairs, "* source overrideDuplicates", "Inserts key-value pairs from the source container");
 
+        static SInt32 indexOfKey(tes_context& ctx, ref obj, key_cref key)
+        {
+            JC_LOG_API ("%p, ...", (void*) obj);
+            return map_functions::indexOfKey(obj, key);
+        }
+        REGISTERF2(indexOfKey, "* key", "Returns the position of the @key in the iteration order (the index getNthKey accepts) or -1 if there is no such key");
+
+        static object_base* keysInRange(tes_context& ctx, ref obj, SInt32 start, SInt32 count)
+        {
+            JC_LOG_API ("%p, %d, %d", (void*) obj, start, count);
+
+            if (!obj) {
+                return nullptr;
+            }
+
+            return &array::objectWithInitializer([&](array &arr) {
+                map_functions::keysInRange(obj, start, count, [&arr](const auto& key) {
+                    arr.u_push(key);
+                });
+            },
+                ctx);
+        }
+        REGISTERF2(keysInRange, "* start count", "Returns a new array containing @count keys starting from the @start position in the iteration order.\n"
+            "The @start may be negative, " NEGATIVE_IDX_COMMENT " The range is clipped to the existing keys");
+
         void additionalSetup();
 
         //////////////////////////////////////////////////////////////////////////
@@ -197,6 +323,74 @@ namespace tes_api_3 {
             map_functions::getNthKey(obj, keyIndex, [&](const typename Cnt::key_type& key) { ith = key; });
             return ith;
         }
+
+        static std::string nextKey_comment() {
+            return std::string(tes_map_nextKey_comment) + "\n" + keys_order_comment();
+        }
+
+        static std::string getNthKey_comment() {
+            return std::string(tes_map_getNthKey_comment) + "\n" + keys_order_comment();
+        }
+
+        //////////////////////////////////////////////////////////////////////////
+
+        static const char * iterBegin_comment() {
+            return R"===(Starts the iteration over container's contents.
+Returns the cursor pointing to the first key-value pair or zero if there are no pairs.
+Unlike nextKey, the cursor remembers its position, so the whole iteration is O(n).
+The cursor survives the container modifications. If the pair it points to gets removed,
+the iteration continues with the pair which followed it, so the pairs can be removed while iterating.
+The cursor stays valid until iterNext returns zero, iterEnd releases it or its container gets destroyed:
+the script which stops iterating early should call iterEnd.
+
+Usage:
+
+    int cursor = JMap.iterBegin(map)
+    while cursor
+      string key = JMap.iterKey(cursor)
+      <retrieve values here, with iterValue* functions, for ex.>
+      cursor = JMap.iterNext(cursor)
+    endwhile
+)===";
+        }
+
+        static SInt32 iterBegin(tes_context& ctx, ref obj) {
+            JC_LOG_API ("%p", (void*) obj);
+            return obj ? ctx._map_cursors.begin(ctx, *obj) : 0;
+        }
+        REGISTERF2(iterBegin, "*", iterBegin_comment());
+
+        static SInt32 iterNext(tes_context& ctx, SInt32 cursor) {
+            JC_LOG_API ("%d", cursor);
+            return ctx._map_cursors.next<Cnt>(ctx, cursor);
+        }
+        REGISTERF2(iterNext, "cursor", "Moves the @cursor to the next pair and returns it.\n"
+            "Returns zero once there are no more pairs - the cursor is released then");
+
+        static void iterEnd(tes_context& ctx, SInt32 cursor) {
+            JC_LOG_API ("%d", cursor);
+            ctx._map_cursors.end(cursor);
+        }
+        REGISTERF2(iterEnd, "cursor", "Releases the @cursor. Only needed if the iteration stops before iterNext returns zero,\n"
+            "otherwise the cursor is kept until its container gets destroyed");
+
+        template<class T>
+        static T iterValue(tes_context& ctx, SInt32 cursor, T def = default_value<T>()) {
+            JC_LOG_API ("%d", cursor);
+            ctx._map_cursors.visit<Cnt>(ctx, cursor, [&](const typename Cnt::value_type& pair) { def = pair.second.readAs<T>(); });
+            return def;
+        }
+        REGISTERF(iterValue<SInt32>, "iterValueInt", "cursor default=0", "Returns the value of the pair the @cursor points to. If the cursor is not valid or the pair has been removed, returns @default value");
+        REGISTERF(iterValue<Float32>, "iterValueFlt", "cursor default=0.0", "");
+        REGISTERF(iterValue<skse::string_ref>, "iterValueStr", "cursor default=\"\"", "");
+        REGISTERF(iterValue<object_base*>, "iterValueObj", "cursor default=0", "");
+        REGISTERF(iterValue<form_ref>, "iterValueForm", "cursor default=None", "");
+
+        static Key iterKey(tes_context& ctx, SInt32 cursor) {
+            Key key;
+            ctx._map_cursors.visit<Cnt>(ctx, cursor, [&](const typename Cnt::value_type& pair) { key = pair.first; });
+            return key;
+        }
     };
 
     typedef tes_map_t<const char*, map, const char*, const char*> tes_map;
@@ -215,55 +409,59 @@ namespace tes_api_3 {
         metaInfo._className = "JIntMap";
     }
 
+    const char * tes_map::keys_order_comment() {
+        return "The keys go in the order they were inserted: setting an existing key keeps its position, "
+            "a removed and inserted again key goes last. Saving and loading keeps the order";
+    }
+
+    const char * tes_form_map::keys_order_comment() {
+        return tes_map::keys_order_comment();
+    }
+
+    const char * tes_integer_map::keys_order_comment() {
+        return "The keys go in the ascending order";
+    }
+
     TES_META_INFO(tes_map);
     TES_META_INFO(tes_form_map);
     TES_META_INFO(tes_integer_map);
 
     //////////////////////////////////////////////////////////////////////////
 
-    const char *tes_map_nextKey_comment =
-R"===(Simplifies iteration over container's contents.
-Accepts the @previousKey, returns the next key.
-If @previousKey == @endKey the function returns the first key.
-The function always returns so-called 'valid' keys (the ones != @endKey).
-The function returns @endKey ('invalid' key) only once to signal that iteration has reached its end.
-In most cases, if the map doesn't contain an invalid key ("" for JMap, None form-key for JFormMap)
-it's ok to omit the @endKey.
-
-Usage:
-
-    string key = JMap.nextKey(map, previousKey="", endKey="")
-    while key != ""
-      <retrieve values here>
-      key = JMap.nextKey(map, key, endKey="")
-    endwhile
-)===";
-
     struct tes_map_ext : class_meta < tes_map_ext > {
         REGISTER_TES_NAME("JMap");
         template<class Key>
         static Key nextKey(tes_context& ctx, map* obj, const char* previousKey = "", const char * endKey = "") {
             Key str(endKey);
-            map_functions::nextKey(obj, previousKey, [&](const std::string& key) { str = key.c_str(); });
+            map_functions::nextKey(obj, previousKey, [&](const util::shared_string& key) { str = key.c_str(); });
             return str;
         }
-        REGISTERF(nextKey<skse::string_ref>, "nextKey", STR(* previousKey="" endKey=""), tes_map_nextKey_comment);
-
-        static const char * getNthKey_comment() { return "Retrieves N-th key. " NEGATIVE_IDX_COMMENT "\nWorst complexity is O(n/2)"; }
+        REGISTERF(nextKey<skse::string_ref>, "nextKey", STR(* previousKey="" endKey=""), &tes_map::nextKey_comment);
 
         template<class Key>
         static Key getNthKey(tes_context& ctx, map* obj, SInt32 keyIndex) {
             Key ith;
-            map_functions::getNthKey(obj, keyIndex, [&](const std::string& key) { ith = key.c_str(); });
+            map_functions::getNthKey(obj, keyIndex, [&](const util::shared_string& key) { ith = key.c_str(); });
             return ith;
         }
-        REGISTERF(getNthKey<skse::string_ref>, "getNthKey", "* keyIndex", getNthKey_comment());
+        REGISTERF(getNthKey<skse::string_ref>, "getNthKey", "* keyIndex", &tes_map::getNthKey_comment);
+
+        static const char * iterKey_comment() { return "Returns the key of the pair the @cursor points to"; }
+
+        template<class Key>
+        static Key iterKey(tes_context& ctx, SInt32 cursor) {
+            Key key;
+            ctx._map_cursors.visit<map>(ctx, cursor, [&](const map::value_type& pair) { key = pair.first.c_str(); });
+            return key;
+        }
+        REGISTERF(iterKey<skse::string_ref>, "iterKey", "cursor", iterKey_comment());
     };
 
     struct tes_form_map_ext : class_meta < tes_form_map_ext > {
         REGISTER_TES_NAME("JFormMap");
-        REGISTERF(tes_form_map_ext::nextKey, "nextKey", STR(* previousKey=None endKey=None), tes_map_nextKey_comment);
-        REGISTERF(tes_form_map::getNthKey, "getNthKey", "* keyIndex", tes_map_ext::getNthKey_comment());
+        REGISTERF(tes_form_map_ext::nextKey, "nextKey", STR(* previousKey=None endKey=None), &tes_form_map::nextKey_comment);
+        REGISTERF(tes_form_map::getNthKey, "getNthKey", "* keyIndex", &tes_form_map::getNthKey_comment);
+        REGISTERF(tes_form_map::iterKey, "iterKey", "cursor", tes_map_ext::iterKey_comment());
 
         struct KeyCompareForNextKey {
             template<class K1, class K2>
@@ -284,8 +482,9 @@ Usage:
 
     struct tes_integer_map_ext : class_meta < tes_integer_map_ext > {
         REGISTER_TES_NAME("JIntMap");
-        REGISTERF(tes_integer_map::nextKey, "nextKey", STR(* previousKey=0 endKey=0), tes_map_nextKey_comment);
-        REGISTERF(tes_integer_map::getNthKey, "getNthKey", "* keyIndex", tes_map_ext::getNthKey_comment());
+        REGISTERF(tes_integer_map::nextKey, "nextKey", STR(* previousKey=0 endKey=0), &tes_integer_map::nextKey_comment);
+        REGISTERF(tes_integer_map::getNthKey, "getNthKey", "* keyIndex", &tes_integer_map::getNthKey_comment);
+        REGISTERF(tes_integer_map::iterKey, "iterKey", "cursor", tes_map_ext::iterKey_comment());
     };
 
     TES_META_INFO(tes_map_ext);
@@ -321,4 +520,205 @@ Usage:
         EXPECT_EQ(countIterations(fmap), 2);
     }
 
+    JC_TEST(tes_integer_map, cursor_iteration)
+    {
+        integer_map* imap = tes_object::object<integer_map>(context);
+        for (int32_t i = 0; i < 100; ++i) {
+            imap->set(i, i * 2);
+        }
+
+        int32_t sum = 0, visited = 0;
+        for (auto cursor = tes_integer_map::iterBegin(context, imap); cursor; cursor = tes_integer_map::iterNext(context, cursor)) {
+            EXPECT_EQ(visited, tes_integer_map::iterKey(context, cursor));
+            sum += tes_integer_map::iterValue<SInt32>(context, cursor);
+            ++visited;
+        }
+        EXPECT_EQ(100, visited);
+        EXPECT_EQ(9900, sum);
+        EXPECT_EQ(0u, context._map_cursors.active_count());
+
+        // the modifications which keep the current pair keep the cursor going
+        auto cursor = tes_integer_map::iterBegin(context, imap);
+        cursor = tes_integer_map::iterNext(context, cursor);
+        EXPECT_EQ(1, tes_integer_map::iterKey(context, cursor));
+        imap->set(1, 100);
+        imap->erase(0);
+        imap->set(1000, 1);
+        EXPECT_EQ(100, tes_integer_map::iterValue<SInt32>(context, cursor));
+        cursor = tes_integer_map::iterNext(context, cursor);
+        EXPECT_EQ(2, tes_integer_map::iterKey(context, cursor));
+
+        // the removal of the current pair: no value, the iteration continues with the next key
+        imap->erase(2);
+        imap->erase(3);
+        EXPECT_EQ(-1, tes_integer_map::iterValue<SInt32>(context, cursor, -1));
+        cursor = tes_integer_map::iterNext(context, cursor);
+        EXPECT_EQ(4, tes_integer_map::iterKey(context, cursor));
+
+        // the released cursor stays invalid
+        tes_integer_map::iterEnd(context, cursor);
+        EXPECT_EQ(0, tes_integer_map::iterNext(context, cursor));
+        auto another = tes_integer_map::iterBegin(context, imap);
+        EXPECT_NE(cursor, another);
+        EXPECT_EQ(0, tes_integer_map::iterNext(context, cursor));
+        tes_integer_map::iterEnd(context, another);
+        EXPECT_EQ(0, tes_integer_map::iterNext(context, another));
+
+        // the cursor of other map type is not accepted
+        another = tes_integer_map::iterBegin(context, imap);
+        EXPECT_EQ(0, tes_map::iterNext(context, another));
+        tes_integer_map::iterEnd(context, another);
+
+        // the cursors in use are never taken away by the new ones
+        std::vector<SInt32> cursors;
+        for (int i = 0; i < 5000; ++i) {
+            cursors.push_back(tes_integer_map::iterBegin(context, imap));
+        }
+        EXPECT_EQ(5000u, context._map_cursors.active_count());
+        for (auto c : cursors) {
+            EXPECT_EQ(1, tes_integer_map::iterKey(context, c));
+            EXPECT_EQ(4, tes_integer_map::iterKey(context, tes_integer_map::iterNext(context, c)));
+            tes_integer_map::iterEnd(context, c);
+        }
+        EXPECT_EQ(0u, context._map_cursors.active_count());
+
+        EXPECT_EQ(0, tes_map::iterBegin(context, tes_object::object<map>(context)));
+    }
+
+    JC_TEST(tes_map, cursor_iteration)
+    {
+        map* m = tes_object::object<map>(context);
+        for (int32_t i = 0; i < 10; ++i) {
+            m->set("key" + std::to_string(i), i);
+        }
+
+        // the pairs removed while iterating: every pair is still visited once
+        std::vector<std::string> visited;
+        for (auto cursor = tes_map::iterBegin(context, m); cursor; cursor = tes_map::iterNext(context, cursor)) {
+            const std::string key = tes_map_ext::iterKey<std::string>(context, cursor);
+            visited.push_back(key);
+            if (tes_map::iterValue<SInt32>(context, cursor) % 2 == 0) {
+                m->erase(key.c_str());
+            }
+        }
+        ASSERT_EQ(10u, visited.size());
+        for (int32_t i = 0; i < 10; ++i) {
+            EXPECT_EQ("key" + std::to_string(i), visited[i]);
+        }
+        EXPECT_EQ(5, m->s_count());
+        EXPECT_EQ(0u, context._map_cursors.active_count());
+
+        // the removed pair has no key, the next one follows
+        auto cursor = tes_map::iterBegin(context, m);
+        m->erase("KEY1");
+        EXPECT_EQ(std::string(), tes_map_ext::iterKey<std::string>(context, cursor));
+        cursor = tes_map::iterNext(context, cursor);
+        EXPECT_EQ(std::string("key3"), tes_map_ext::iterKey<std::string>(context, cursor));
+
+        // the removal of the last pair ends the iteration
+        while (tes_map_ext::iterKey<std::string>(context, cursor) != "key9") {
+            cursor = tes_map::iterNext(context, cursor);
+        }
+        m->erase("key9");
+        EXPECT_EQ(0, tes_map::iterNext(context, cursor));
+        EXPECT_EQ(0u, context._map_cursors.active_count());
+    }
+
+    JC_TEST(tes_form_map, cursor_iteration)
+    {
+        using namespace collections;
+
+        form_map* fmap = tes_object::object<form_map>(context);
+        auto formKey = [&](uint32_t id) { return make_weak_form_id(util::to_enum<FormId>(id), context); };
+        fmap->u_container()[formKey(0x14)] = item{ 1 };
+        fmap->u_container()[form_ref::make_expired(util::to_enum<FormId>(0x15))] = item{ 2 };
+        fmap->u_container()[formKey(0x20)] = item{ 3 };
+        fmap->u_container()[form_ref::make_expired(util::to_enum<FormId>(0x21))] = item{ 4 };
+        fmap->u_container()[formKey(0x30)] = item{ 5 };
+
+        // the expired keys are skipped
+        std::vector<FormId> visited;
+        int32_t sum = 0;
+        for (auto cursor = tes_form_map::iterBegin(context, fmap); cursor; cursor = tes_form_map::iterNext(context, cursor)) {
+            visited.push_back(tes_form_map::iterKey(context, cursor).get());
+            sum += tes_form_map::iterValue<SInt32>(context, cursor);
+        }
+        EXPECT_EQ((std::vector<FormId>{ util::to_enum<FormId>(0x14), util::to_enum<FormId>(0x20), util::to_enum<FormId>(0x30) }), visited);
+        EXPECT_EQ(9, sum);
+
+        // the removal of the current pair: the iteration continues with the next not expired key
+        auto cursor = tes_form_map::iterBegin(context, fmap);
+        cursor = tes_form_map::iterNext(context, cursor);
+        EXPECT_EQ(util::to_enum<FormId>(0x20), tes_form_map::iterKey(context, cursor).get());
+        EXPECT_TRUE(fmap->erase(formKey(0x20)));
+        EXPECT_EQ(-1, tes_form_map::iterValue<SInt32>(context, cursor, -1));
+        cursor = tes_form_map::iterNext(context, cursor);
+        EXPECT_EQ(util::to_enum<FormId>(0x30), tes_form_map::iterKey(context, cursor).get());
+        EXPECT_EQ(0, tes_form_map::iterNext(context, cursor));
+        EXPECT_EQ(0u, context._map_cursors.active_count());
+    }
+
+    JC_TEST(tes_map, key_positions)
+    {
+        map* m = tes_object::object<map>(context);
+        for (int32_t i = 0; i < 1000; ++i) {
+            m->set("key" + std::to_string(i), i);
+        }
+
+        EXPECT_EQ(500, tes_map::indexOfKey(context, m, "KEY500"));
+        EXPECT_EQ(-1, tes_map::indexOfKey(context, m, "missing"));
+        EXPECT_EQ(std::string("key999"), tes_map_ext::getNthKey<std::string>(context, m, -1));
+
+        m->erase("key0");
+        EXPECT_EQ(499, tes_map::indexOfKey(context, m, "key500"));
+        EXPECT_EQ(std::string("key500"), tes_map_ext::getNthKey<std::string>(context, m, 499));
+
+        auto keys = tes_map::keysInRange(context, m, 997, 10)->as<array>();
+        ASSERT_TRUE(keys != nullptr);
+        EXPECT_EQ(2, keys->u_count());
+        EXPECT_TRUE(keys->u_item_at(0) == "key998");
+
+        EXPECT_EQ(0, tes_map::keysInRange(context, m, 2000, 10)->as<array>()->u_count());
+
+        integer_map* imap = tes_object::object<integer_map>(context);
+        imap->set(-1000000, 1);
+        imap->set(1000000, 2);
+        EXPECT_EQ(1, tes_integer_map::indexOfKey(context, imap, 1000000));
+    }
+
+    JC_TEST(tes_map, batch_access)
+    {
+        map* m = tes_object::object<map>(context);
+
+        std::vector<const char*> keys = { "a", "B", "", "c" };
+        std::vector<item> values;
+        values.emplace_back(1);
+        values.emplace_back(2.5f);
+        values.emplace_back(3);
+        values.emplace_back("text");
+        map_functions::setMany(m, keys, std::move(values));
+
+        // the empty key is skipped
+        EXPECT_EQ(3, m->s_count());
+        EXPECT_TRUE(m->findOrDef("b") == 2.5f);
+
+        std::vector<boost::optional<item>> found;
+        map_functions::getMany(m, std::vector<const char*>{ "A", "missing", "C" }, found);
+        ASSERT_EQ(3u, found.size());
+        EXPECT_TRUE(found[0] && *found[0] == 1);
+        EXPECT_FALSE(found[1]);
+        EXPECT_TRUE(found[2] && *found[2] == "text");
+
+        integer_map* imap = tes_object::object<integer_map>(context);
+        std::vector<int32_t> intKeys;
+        std::vector<item> intValues;
+        for (int32_t i = 0; i < 500; ++i) {
+            intKeys.push_back(i);
+            intValues.emplace_back(i * 3);
+        }
+        integer_map_functions::setMany(imap, intKeys, std::move(intValues));
+        EXPECT_EQ(500, imap->s_count());
+        EXPECT_TRUE(imap->findOrDef(499) == 1497);
+    }
+
 }
@@ -96,22 +96,37 @@ Retains and returns the object.)==="
         {
             JC_LOG_API ("\"%s\"", tag ? tag : "<nullptr>");
 
-            if (tag && *tag)
-            {
-                auto objects = ctx.filter_objects ([tag] (const object_base& obj) {
-                    return obj.has_equal_tag (tag);
-                });
-
-                for (auto& ref : objects) {
-                    while (ref->_tes_refCount != 0)
-                        ref->tes_release ();
-                }
+            for (auto& ref : ctx.objects_with_tag (tag)) {
+                while (ref->_tes_refCount != 0)
+                    ref->tes_release ();
             }
         }
         REGISTERF2(releaseObjectsWithTag, "tag",
 "Releases all objects tagged with @tag.\n"
 "Internally invokes JValue.release on each object same amount of times it has been retained.");
 
+        static SInt32 countObjectsWithTag (tes_context& ctx, const char *tag)
+        {
+            JC_LOG_API ("\"%s\"", tag ? tag : "<nullptr>");
+            return static_cast<SInt32> (ctx.count_objects_with_tag (tag));
+        }
+        REGISTERF2(countObjectsWithTag, "tag", "Returns the number of objects tagged with @tag");
+
+        static object_base* objectsWithTag (tes_context& ctx, const char *tag)
+        {
+            JC_LOG_API ("\"%s\"", tag ? tag : "<nullptr>");
+
+            auto objects = ctx.objects_with_tag (tag);
+            return &array::objectWithInitializer ([&] (array &arr) {
+                arr.u_reserve (objects.size ());
+                for (auto& ref : objects) {
+                    arr.u_push (ref.get ());
+                }
+            },
+                ctx);
+        }
+        REGISTERF2(objectsWithTag, "tag", "Returns a new array containing the objects tagged with @tag, in no particular order");
+
         static ref zeroLifetime (tes_context& ctx, ref obj)
         {
             JC_LOG_API ("0x%p", (void*) obj);
@@ -365,6 +380,44 @@ For ex. JValue.hasPath(container, \".player.health\") will test whether @contain
         REGISTERF(resolveGetter<Handle>, "solveObj", "* path default=0", nullptr);
         REGISTERF(resolveGetter<form_ref>, "solveForm", "* path default=None", nullptr);
 
+        template<class T>
+        static VMResultArray<reflection::binding::convert_to_tes_type<T>> solveMany(tes_context& ctx, object_base *obj,
+            VMArray<skse::string_ref> pathsArray, T def = default_value<T>())
+        {
+            JC_LOG_API ("0x%p, ...", (void*) obj);
+
+            const UInt32 count = pathsArray.Length();
+            std::vector<skse::string_ref> tesPaths(count);
+            std::vector<const char *> paths(count);
+            for (UInt32 i = 0; i < count; ++i) {
+                pathsArray.Get(&tesPaths[i], i);
+                paths[i] = tesPaths[i].c_str();
+            }
+
+            std::vector<boost::optional<item>> found(count);
+            path_resolving::resolve_many(ctx, obj, paths.data(), count, [&](size_t i, item *itm) {
+                if (itm) {
+                    found[i] = *itm;
+                }
+            });
+
+            // the conversion happens outside of the locks, the found items keep the objects alive
+            VMResultArray<reflection::binding::convert_to_tes_type<T>> values;
+            values.reserve(count);
+            for (const auto& itm : found) {
+                values.push_back(reflection::binding::get_converter<T>::convert2Tes(itm ? itm->readAs<T>() : def));
+            }
+            return values;
+        }
+        REGISTERF(solveMany<SInt32>, "solveIntMany", "* paths default=0",
+"Returns an array of the values at the @paths, the failed paths produce @default values.\n\
+The paths sharing a prefix are resolved together, so reading many values under one subtree\n\
+(for ex. \".npc.stats.hp\", \".npc.stats.mp\") walks the shared part of the paths once");
+        REGISTERF(solveMany<Float32>, "solveFltMany", "* paths default=0.0", nullptr);
+        REGISTERF(solveMany<skse::string_ref>, "solveStrMany", "* paths default=\"\"", nullptr);
+        REGISTERF(solveMany<object_base*>, "solveObjMany", "* paths default=0", nullptr);
+        REGISTERF(solveMany<form_ref>, "solveFormMany", "* paths default=None", nullptr);
+
         template<class T>
         static bool solveSetter(tes_context& ctx, object_base* obj, const char* path, T value, bool createMissingKeys = false)
         {
@@ -373,7 +426,7 @@ For ex. JValue.hasPath(container, \".player.health\") will test whether @contain
             if (!obj || !path)
                 return false;
 
-            return ca::assign(*obj, path, value, createMissingKeys ? ca::creative : ca::constant);
+            return ca::assign(*obj, path, ctx.make_item(value), createMissingKeys ? ca::creative : ca::constant);
         }
         REGISTERF(solveSetter<Float32>, "solveFltSetter", "* path value createMissingKeys=false",
             "Attempts to assign the value. If @createMissingKeys is False it may fail to assign - if no such path exist.\n"
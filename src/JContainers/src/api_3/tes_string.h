@@ -35,7 +35,7 @@ namespace collections {
             return &array::objectWithInitializer([&](array &obj) {
 
                 for (auto& str : *strings) {
-                    obj.u_container().emplace_back(std::move(str));
+                    obj.u_push(std::move(str));
                 }
             },
                 ctx);
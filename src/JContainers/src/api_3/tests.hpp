@@ -131,6 +131,38 @@ namespace tes_api_3 {
             shouldReturnNumber(obj, "@minNum", 1);
 
             shouldReturnNumber(obj, "@minFlt", 0);
+
+            shouldReturnInt(obj, "@sum", 21);
+            shouldReturnNumber(obj, "@avg", 3.5f);
+            shouldReturnInt(obj, "@count", 6);
+            shouldReturnInt(obj, "@product", 720);
+        }
+        {
+            object_stack_ref obj = tes_object::objectFromPrototype(ctx, STR([1.5, 2, "text", 0.5]));
+
+            shouldReturnNumber(obj, "@sum", 4);
+            shouldReturnNumber(obj, "@avg", 4.0f / 3);
+            shouldReturnInt(obj, "@count", 4);
+            shouldReturnNumber(obj, "@product", 1.5f);
+            shouldReturnNumber(obj, "@maxNum", 2);
+        }
+        {
+            // the ints wrap around only while there are no floats
+            object_stack_ref obj = tes_object::objectFromPrototype(ctx, STR([65537, 65537]));
+            shouldReturnInt(obj, "@product", 131073);
+
+            obj = tes_object::objectFromPrototype(ctx, STR([100000, 100000, 0.5]));
+            shouldReturnNumber(obj, "@product", 5e9f);
+            obj = tes_object::objectFromPrototype(ctx, STR([0.5, 100000, -100000]));
+            shouldReturnNumber(obj, "@product", -5e9f);
+        }
+        {
+            object_stack_ref obj = tes_object::objectFromPrototype(ctx, STR([]));
+
+            shouldReturnInt(obj, "@count", 0);
+            path_resolving::resolve(ctx, obj, "@sum", [&](item * item) {
+                EXPECT_TRUE(item && item->isNull());
+            });
         }
         {
             object_base *obj = tes_object::objectFromPrototype(ctx, STR(
@@ -159,6 +191,68 @@ namespace tes_api_3 {
         }
     }
 
+    // The operators over the packed arrays against the item-by-item path they used to take
+    TEST(path_resolving, collections_operators_performance)
+    {
+        tes_context_standalone  ctx;
+
+        const int32_t count = 100000;
+        array::ref ints = array::object(ctx);
+        array::ref reals = array::object(ctx);
+        // no zeros, so that the products are not zero: odd ints, the reals in reciprocal pairs
+        for (int32_t i = 0; i < count; ++i) {
+            ints->push((i % 1000 - 500) | 1);
+            const float real = 1.0f + static_cast<float>(i / 2 % 1000) * 0.001f;
+            reals->push(i % 2 == 0 ? real : 1.0f / real);
+        }
+
+        const char *operators[] = { "sum", "avg", "maxNum", "minInt", "product" };
+        const int repeats = 100;
+
+        for (array* obj : { ints.get(), reals.get() }) {
+            for (auto opName : operators) {
+                auto opr = operators::get_operator(opName);
+                ASSERT_TRUE(opr != nullptr);
+
+                // the way the operators worked before: copy the array, visit every item
+                item expected;
+                util::do_with_timing((std::string("@") + opName + " over 100k items, item-by-item").c_str(), [&]() {
+                    for (int i = 0; i < repeats; ++i) {
+                        operators::operator_state state;
+                        for (auto& itm : obj->container_copy()) {
+                            opr->func(itm, state);
+                        }
+                        if (opr->finish) {
+                            opr->finish(state);
+                        }
+                        expected = std::move(state.value);
+                    }
+                });
+
+                std::string path = std::string("@") + opName;
+                item actual;
+                util::do_with_timing((path + " over 100k items, packed").c_str(), [&]() {
+                    for (int i = 0; i < repeats; ++i) {
+                        path_resolving::resolve(ctx, obj, path.c_str(), [&](item * itm) {
+                            actual = itm ? *itm : item();
+                        });
+                    }
+                });
+
+                EXPECT_EQ(expected.type(), actual.type());
+                if (expected.is_type<SInt32>()) {
+                    EXPECT_EQ(expected.intValue(), actual.intValue());
+                }
+                else {
+                    EXPECT_FLOAT_EQ(expected.fltValue(), actual.fltValue());
+                }
+                if (std::string(opName) == "product") {
+                    EXPECT_NE(0.f, actual.fltValue());
+                }
+            }
+        }
+    }
+
     TEST(path_resolving, explicit_key_construction)
     {
         tes_context_standalone  ctx;
@@ -192,6 +286,108 @@ namespace tes_api_3 {
         EXPECT_TRUE(obj2->_tes_refCount == 1);
     }
 
+    TEST(tes_object, objectsWithTag)
+    {
+        tes_context_standalone  ctx;
+        object_stack_ref a = tes_object::object<map>(ctx);
+        object_stack_ref b = tes_object::object<array>(ctx);
+        object_stack_ref c = tes_object::object<map>(ctx);
+
+        tes_object::retain(ctx, a, "Quest");
+        tes_object::retain(ctx, b, "quest");
+        tes_object::retain(ctx, c, "other");
+
+        // the tags are case-insensitive
+        EXPECT_EQ(2, tes_object::countObjectsWithTag(ctx, "QUEST"));
+        EXPECT_EQ(1, tes_object::countObjectsWithTag(ctx, "other"));
+        EXPECT_EQ(0, tes_object::countObjectsWithTag(ctx, "missing"));
+        EXPECT_EQ(0, tes_object::countObjectsWithTag(ctx, ""));
+        EXPECT_EQ(0, tes_object::countObjectsWithTag(ctx, nullptr));
+
+        object_stack_ref tagged = tes_object::objectsWithTag(ctx, "quest");
+        EXPECT_EQ(2, tagged->s_count());
+        auto items = tagged->as<array>()->container_copy();
+        EXPECT_TRUE(std::count(items.begin(), items.end(), item(a.get())) == 1);
+        EXPECT_TRUE(std::count(items.begin(), items.end(), item(b.get())) == 1);
+
+        // retagging moves the object between the tags, the untagged objects are not indexed
+        tes_object::retain(ctx, a, "other");
+        EXPECT_EQ(1, tes_object::countObjectsWithTag(ctx, "quest"));
+        EXPECT_EQ(2, tes_object::countObjectsWithTag(ctx, "other"));
+        tes_object::retain(ctx, c, nullptr);
+        EXPECT_EQ(1, tes_object::countObjectsWithTag(ctx, "other"));
+
+        tes_object::releaseObjectsWithTag(ctx, "other");
+        EXPECT_TRUE(a->_tes_refCount == 0);
+        EXPECT_TRUE(b->_tes_refCount == 1);
+        EXPECT_TRUE(c->_tes_refCount == 2);
+    }
+
+    // the tagging takes the object lock and the registry lock one after another, never nested:
+    // the object locks are held while registering the new objects
+    TEST(tes_object, tag_lock_order)
+    {
+        tes_context_standalone  ctx;
+        object_stack_ref obj = tes_object::object<map>(ctx);
+
+        std::atomic<bool> locked{ false };
+        auto holder = std::async(std::launch::async, [&]() {
+            object_lock g(obj);
+            locked = true;
+            // lets the tagging thread come to the object lock
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            // a missing key gets created under the lock of the container
+            obj->as<map>()->u_set("child", item(tes_object::object<map>(ctx)));
+        });
+        while (!locked) {
+            std::this_thread::yield();
+        }
+        tes_object::retain(ctx, obj, "tagged");
+        holder.get();
+
+        EXPECT_EQ(1, tes_object::countObjectsWithTag(ctx, "tagged"));
+        EXPECT_TRUE(obj->has_equal_tag("tagged"));
+    }
+
+    TEST(tes_map, long_string_values_shared)
+    {
+        tes_context_standalone ctx;
+        const std::string value = "a string value which is too long to be stored in-place";
+
+        map& root = map::object(ctx);
+        ctx.set_root(&root);
+        map* m = tes_object::object<map>(ctx);
+        array* arr = tes_object::object<array>(ctx);
+        tes_map::setItem(ctx, &root, "map", (object_base*)m);
+        tes_map::setItem(ctx, &root, "array", (object_base*)arr);
+
+        // the values set by the scripts: the copies of the same string share the memory
+        tes_map::setItem(ctx, m, "a", std::string(value).c_str());
+        EXPECT_TRUE(tes_object::solveSetter(ctx, &root, ".b", std::string(value).c_str(), true));
+        tes_array::addItemAt(ctx, arr, std::string(value).c_str());
+        tes_array::replaceItemAtIndex(ctx, arr, 0, std::string(value).c_str());
+        tes_array::addItemAt(ctx, arr, std::string(value).c_str());
+
+        auto expectShared = [&]() {
+            map& r = ctx.root();
+            const item a = r.findOrDef("map").object()->as<map>()->findOrDef("a");
+            const item b = r.findOrDef("b");
+            const array* values = r.findOrDef("array").object()->as<array>();
+            ASSERT_TRUE(values != nullptr && values->u_count() == 2);
+
+            EXPECT_EQ(value, a.strValue());
+            EXPECT_EQ(a.strValue(), b.strValue());
+            EXPECT_EQ(a.strValue(), values->u_item_at(0).strValue());
+            EXPECT_EQ(a.strValue(), values->u_item_at(1).strValue());
+        };
+        expectShared();
+
+        // and still after a save-load round trip
+        auto state = ctx.write_to_string();
+        ctx.read_from_string(state);
+        expectShared();
+    }
+
     TEST(tes_map, nextKey)
     {
         tes_context_standalone  ctx;
@@ -200,13 +396,83 @@ namespace tes_api_3 {
         auto key = tes_map_ext::nextKey<std::string>(ctx, m);
         auto itr = m->u_container().begin();
         while (!key.empty()) {
-            EXPECT_TRUE(key == itr->first);
+            EXPECT_TRUE(key == itr->first.c_str());
             ++itr;
             key = tes_map_ext::nextKey<std::string>(ctx, m, key.c_str());
         }
         EXPECT_TRUE(itr == m->u_container().end());
     }
 
+    TEST(tes_map, keys_insertion_order)
+    {
+        tes_context_standalone ctx;
+
+        map& root = map::object(ctx);
+        ctx.set_root(&root);
+        map* m = tes_object::object<map>(ctx);
+        form_map* fm = tes_object::object<form_map>(ctx);
+        tes_map::setItem(ctx, &root, "map", (object_base*)m);
+        tes_map::setItem(ctx, &root, "formMap", (object_base*)fm);
+
+        auto formKey = [&](uint32_t id) {
+            return form_ref_lightweight{ util::to_enum<FormId>(id), ctx._form_watcher };
+        };
+
+        for (auto key : { "c", "a", "b", "d" }) {
+            tes_map::setItem<SInt32>(ctx, m, key, 0);
+        }
+        for (uint32_t id : { 0x30u, 0x10u, 0x20u, 0x40u }) {
+            tes_form_map::setItem<SInt32>(ctx, fm, formKey(id), 0);
+        }
+
+        // setting an existing key keeps its position, a removed and inserted again key goes last
+        tes_map::setItem<SInt32>(ctx, m, "A", 1);
+        EXPECT_TRUE(tes_map::removeKey(ctx, m, "c"));
+        tes_map::setItem<SInt32>(ctx, m, "c", 2);
+
+        tes_form_map::setItem<SInt32>(ctx, fm, formKey(0x10), 1);
+        EXPECT_TRUE(tes_form_map::removeKey(ctx, fm, formKey(0x30)));
+        tes_form_map::setItem<SInt32>(ctx, fm, formKey(0x30), 2);
+
+        const std::vector<std::string> expectedKeys = { "a", "b", "d", "c" };
+        const std::vector<uint32_t> expectedForms = { 0x10, 0x20, 0x40, 0x30 };
+
+        auto expectOrder = [&](map* m, form_map* fm) {
+            ASSERT_TRUE(m && fm);
+
+            std::vector<std::string> keys;
+            for (auto key = tes_map_ext::nextKey<std::string>(ctx, m); !key.empty();
+                key = tes_map_ext::nextKey<std::string>(ctx, m, key.c_str())) {
+                keys.push_back(key);
+            }
+            EXPECT_TRUE(keys == expectedKeys);
+
+            std::vector<uint32_t> forms;
+            for (auto key = tes_form_map_ext::nextKey(ctx, fm, {}, {}); key; key = tes_form_map_ext::nextKey(ctx, fm, key, {})) {
+                forms.push_back(util::to_integral(key.get()));
+            }
+            EXPECT_TRUE(forms == expectedForms);
+
+            const array* allKeys = tes_map::allKeys(ctx, m)->as<array>();
+            const array* allForms = tes_form_map::allKeys(ctx, fm)->as<array>();
+            ASSERT_TRUE(allKeys && allKeys->u_count() == 4 && allForms && allForms->u_count() == 4);
+
+            for (int32_t i = 0; i < 4; ++i) {
+                EXPECT_TRUE(expectedKeys[i] == tes_map_ext::getNthKey<std::string>(ctx, m, i));
+                EXPECT_TRUE(expectedKeys[i] == allKeys->u_item_at(i).strValue());
+                EXPECT_EQ(expectedForms[i], util::to_integral(tes_form_map::getNthKey(ctx, fm, i).get()));
+                EXPECT_EQ(expectedForms[i], util::to_integral(allForms->u_item_at(i).formId()));
+            }
+        };
+        expectOrder(m, fm);
+
+        // and still after a save-load round trip
+        auto state = ctx.write_to_string();
+        ctx.read_from_string(state);
+        map& loaded = ctx.root();
+        expectOrder(loaded.findOrDef("map").object()->as<map>(), loaded.findOrDef("formMap").object()->as<form_map>());
+    }
+
     TEST(tes_object, pool)
     {
         tes_context_standalone ctx;
@@ -5,13 +5,14 @@
 #include <boost/range/algorithm/find_if.hpp>
 #include <boost/range/algorithm/find_end.hpp>
 
+#include <algorithm>
 #include <functional>
 
 #include "forms/form_handling.h"
 #include "collections/collections.h"
 #include "collections/context.h"
 #include "collections/operators.h"
-#include "util/cstring.h"
+#include "collections/path_cache.h"
 
 namespace collections
 {
@@ -20,72 +21,412 @@ namespace collections
         namespace bs = boost;
         namespace ss = std;
 
-        typedef ss::function<item* (object_base*)> NodeFunc;
-        typedef ss::function<void (const item& , item&)> ElementFunc;
-        typedef boost::iterator_range<const char*> path_type;
+        //////////////////////////////////////////////////////////////////////////
 
-        struct state {
-            bool succeed;
-            path_type path;
-            NodeFunc nodeGetter;
-            object_base *object;
+        enum {
+            path_length_max = 1024,
+        };
+
+        // Parses the segments up to the first malformed one
+        static compiled_path compile(const char *text, size_t length) {
+            compiled_path path;
+            const char *p = text;
+            const char *const end = text + length;
+
+            while (p != end) {
+                path_token token;
+
+                if (*p == '@' && end - p >= 2) {
+                    const char *nameEnd = std::find(p + 1, end, '.');
+                    if (nameEnd == p + 1) {
+                        break;
+                    }
+                    token.type = path_token::kind::operation;
+                    token.operation = operators::get_operator(ss::string(p + 1, nameEnd).c_str());
+                    token.text.assign(nameEnd, end);
+                    p = end;
+                }
+                else if (*p == '.' && end - p >= 2) {
+                    const char *keyEnd = std::find_if(p + 1, end, [](char c) { return c == '.' || c == '['; });
+                    if (keyEnd == p + 1) {
+                        break;
+                    }
+                    token.type = path_token::kind::key;
+                    token.text.assign(p + 1, keyEnd);
+                    p = keyEnd;
+                }
+                else if (*p == '[' && end - p >= 3) {
+                    const char *indexEnd = std::find(p + 1, end, ']');
+                    if (indexEnd == p + 1 || indexEnd == end) {
+                        break;
+                    }
+                    token.text.assign(p + 1, indexEnd);
+                    if (forms::is_form_string(token.text.c_str())) {
+                        auto split = forms::split_form_string(token.text.c_str());
+                        if (!split) {
+                            break;
+                        }
+                        token.type = path_token::kind::form;
+                        token.form_id = split->second;
+                        token.text.assign(split->first.begin(), split->first.end());
+                    }
+                    else {
+                        token.type = path_token::kind::index;
+                        try {
+                            token.index = std::stoi(token.text, nullptr, 0);
+                        }
+                        catch (const std::invalid_argument& ) {
+                            break;
+                        }
+                        catch (const std::out_of_range& ) {
+                            break;
+                        }
+                        token.text.clear();
+                    }
+                    p = indexEnd + 1;
+                }
+                else {
+                    break;
+                }
+
+                path.tokens.push_back(std::move(token));
+            }
+
+            path.complete = (p == end);
+            return path;
+        }
+
+        static path_cache& compiled_paths() {
+            static path_cache cache;
+            return cache;
+        }
+
+        const compiled_path* compiled(const char *cpath) {
+            jc_assert(path_cache::is_pinned());
+            const size_t length = strnlen_s(cpath, path_length_max);
+            auto path = compiled_paths().find(cpath, length);
+            if (!path) {
+                path = compiled_paths().insert(cpath, length, std::make_shared<compiled_path>(compile(cpath, length)));
+            }
+            return path;
+        }
+
+        path_cache::statistics cache_statistics() {
+            return compiled_paths().get_statistics();
+        }
+
+        //////////////////////////////////////////////////////////////////////////
+
+        // the item of the @container the @token points to, the container must be locked exclusively
+        static item *u_token_item(tes_context& context, object_base& container, const path_token& token, FormId form, bool createMissingKeys) {
+            switch (token.type) {
+            case path_token::kind::key:
+                if (auto obj = container.as<map>()) {
+                    item *itemPtr = obj->u_get(token.text.c_str());
+                    if (!itemPtr && createMissingKeys) {
+                        itemPtr = obj->u_set(token.text.c_str(), item());
+                    }
+                    return itemPtr;
+                }
+                return nullptr;
+            case path_token::kind::index:
+                if (auto obj = container.as<array>()) {
+                    // the packed values are never collections: there is nothing to step into, the array stays packed
+                    return obj->u_packing() == item_type::none ? obj->u_get(token.index) : nullptr;
+                }
+                else if (auto obj = container.as<integer_map>()) {
+                    return obj->u_get(token.index);
+                }
+                return nullptr;
+            case path_token::kind::form:
+                if (auto obj = container.as<form_map>()) {
+                    return obj->u_get(make_weak_form_id(form, context));
+                }
+                return nullptr;
+            default:
+                return nullptr;
+            }
+        }
+
+        // The same for the readers sharing the lock: the container is not modified,
+        // the value of a packed array gets copied into the @scratch instead of promoting the array
+        static const item *u_read_token_item(tes_context& context, const object_base& container, const path_token& token, FormId form, item& scratch) {
+            switch (token.type) {
+            case path_token::kind::key:
+                if (auto obj = container.as<map>()) {
+                    return obj->u_get(token.text.c_str());
+                }
+                return nullptr;
+            case path_token::kind::index:
+                if (auto obj = container.as<array>()) {
+                    auto idx = obj->u_convertIndex(token.index);
+                    if (!idx) {
+                        return nullptr;
+                    }
+                    if (obj->u_packing() != item_type::none) {
+                        scratch = obj->u_item_at(*idx);
+                        return &scratch;
+                    }
+                    return &obj->u_container()[*idx];
+                }
+                else if (auto obj = container.as<integer_map>()) {
+                    return obj->u_get(token.index);
+                }
+                return nullptr;
+            case path_token::kind::form:
+                if (auto obj = container.as<form_map>()) {
+                    return obj->u_get(make_weak_form_id(form, context));
+                }
+                return nullptr;
+            default:
+                return nullptr;
+            }
+        }
+
+        static bool u_walk(tes_context& context, object_base& collection, const compiled_path& path,
+            item_visitor itemFunction, bool createMissingKeys, bool mayWait);
+
+        // Applies the operator to the items of a collection, or to the values the rest of the path points to.
+        // The collection gets iterated in place, under the lock the walker holds. The paths which follow its items
+        // get walked without waiting for the locks: an item whose path is busy gets visited later,
+        // once the lock of the collection is released (see object_lock_chain)
+        class operator_application {
+            tes_context& _context;
+            const operators::coll_operator& _opr;
+            operators::operator_state _state;
+            const compiled_path *_rest = nullptr;   // the path which follows the items
+            std::vector<object_stack_ref> _busy;    // the items whose paths were busy
+
+            void u_accumulate(const item& itm) {
+                _opr.func(itm, _state);
+            }
+
+            void u_walk_rest(object_base& obj) {
+                auto visitor = [this](item *itm) {
+                    if (itm) {
+                        u_accumulate(*itm);
+                    }
+                };
+                if (!u_walk(_context, obj, *_rest, visitor, false, false)) {
+                    _busy.emplace_back(&obj);
+                }
+            }
+
+            void u_apply(const array& arr, const char *rightPath) {
+                if (!*rightPath) {
+                    if (arr.u_packing() != item_type::none) {
+                        _opr.packed(arr.u_packed(), _state);
+                    }
+                    else {
+                        for (const auto& itm : arr.u_container()) {
+                            u_accumulate(itm);
+                        }
+                    }
+                    return;
+                }
 
-            state(bool _succeed, const NodeFunc& _node, object_base *_object, const path_type& _path) {
-                succeed = _succeed;
-                nodeGetter = _node;
-                path = _path;
-                object = _object;
+                // the packed values are never collections
+                if (arr.u_packing() != item_type::none) {
+                    return;
+                }
+                _rest = compiled(rightPath);
+                for (const auto& itm : arr.u_container()) {
+                    if (auto obj = itm.object()) {
+                        u_walk_rest(*obj);
+                    }
+                }
             }
 
-            state(bool _succeed, const state& st) {
-                succeed = _succeed;
-                nodeGetter = st.nodeGetter;
-                path = st.path;
-                object = st.object;
+            // the map's keys or values, the path has to start with .key or .value
+            template<class T>
+            void u_apply(const T& cnt, const char *rightPath) {
+                if (bs::istarts_with(rightPath, ".key")) {
+                    // there is nothing to resolve beyond the keys as they are never collections
+                    if (rightPath[bs::size(".key") - 1]) {
+                        return;
+                    }
+                    item itm;
+                    for (const auto& pair : cnt.u_container()) {
+                        itm = pair.first;
+                        u_accumulate(itm);
+                    }
+                }
+                else if (bs::istarts_with(rightPath, ".value")) {
+                    rightPath += bs::size(".value") - 1;
+                    if (!*rightPath) {
+                        for (const auto& pair : cnt.u_container()) {
+                            u_accumulate(pair.second);
+                        }
+                        return;
+                    }
+                    _rest = compiled(rightPath);
+                    for (const auto& pair : cnt.u_container()) {
+                        if (auto obj = pair.second.object()) {
+                            u_walk_rest(*obj);
+                        }
+                    }
+                }
+            }
+
+        public:
+
+            operator_application(tes_context& context, const operators::coll_operator& opr)
+                : _context(context), _opr(opr) {}
+
+            // the @collection must be locked
+            void u_apply(const object_base& collection, const char *rightPath) {
+                perform_on_object(collection, [&](const auto& cnt) { u_apply(cnt, rightPath); });
+            }
+
+            bool has_busy() const { return !_busy.empty(); }
+
+            // walks the busy paths waiting for the locks, the thread must not hold any object lock
+            void visit_busy() {
+                auto visitor = [this](item *itm) {
+                    if (itm) {
+                        u_accumulate(*itm);
+                    }
+                };
+                for (auto& obj : _busy) {
+                    u_walk(_context, *obj, *_rest, visitor, false, true);
+                }
+                _busy.clear();
+            }
+
+            item result() {
+                if (_opr.finish) {
+                    _opr.finish(_state);
+                }
+                return std::move(_state.value);
             }
         };
 
-        template<class T>
-        static bool _map_visit_helper(tes_context& context, T& container, path_type path, std::function<void(item *)>&& function)
+        // Walks the compiled path from the @collection, hand over hand (see object_lock_chain): the readers share the locks,
+        // the walker creating the missing keys locks exclusively. The item a token points to is looked up
+        // once the next token is reached (or the path ends), the container holding the item stays locked till then.
+        //
+        // The walker which may not wait for the locks (as the thread holds another one) gives up once the next lock is busy,
+        // then it returns false without visiting anything.
+        //
+        // The walker owns the container it is in: the reference gets taken while the parent is still locked, as the parent
+        // may drop the container once unlocked (the walker waiting for the container's lock), and it's kept till the walker leaves
+        static bool u_walk(tes_context& context, object_base& collection, const compiled_path& path,
+            item_visitor itemFunction, bool createMissingKeys, bool mayWait)
         {
-            if (path.empty()) {
+            object_stack_ref owned;    // released after the chain's lock
+            object_lock_chain chain(!createMissingKeys);
+            auto step = [&](object_base& next) {
+                if (mayWait) {
+                    chain.step(next);
+                    return true;
+                }
+                return chain.try_step(next);
+            };
+
+            if (!step(collection)) {
                 return false;
             }
 
-            bool isKeyVisit = false;
+            object_base *container = &collection;   // the container of the pending item, locked
+            const path_token *pending = nullptr;    // the token of the pending item, the collection itself if null
+            FormId pendingForm = FormId::Zero;
+            item scratch;
+
+            auto u_pending_item = [&](const path_token *next) -> item* {
+                if (!createMissingKeys) {
+                    return const_cast<item *>(u_read_token_item(context, *container, *pending, pendingForm, scratch));
+                }
+                item *node = u_token_item(context, *container, *pending, pendingForm, true);
+                if (next && next->type == path_token::kind::key && node && node->isNull()) {
+                    *node = map::object(context);
+                }
+                return node;
+            };
+
+            auto fail = [&]() {
+                chain.release();
+                itemFunction(nullptr);
+                return true;
+            };
+
+            for (const path_token& token : path.tokens) {
+                FormId form = FormId::Zero;
+
+                if (token.type == path_token::kind::form) {
+                    if (auto fId = forms::form_from_file(token.text, token.form_id)) {
+                        form = *fId;
+                    }
+                    else {
+                        return fail();
+                    }
+                }
+
+                if (pending) {
+                    item *node = u_pending_item(&token);
+                    object_base *next = node ? node->object() : nullptr;
+                    if (!next) {
+                        return fail();
+                    }
+                    object_stack_ref nextRef(next);
+                    if (!step(*next)) {
+                        return false;
+                    }
+                    owned = std::move(nextRef);
+                    container = next;
+                }
 
-            path_type::iterator rightPath;
+                if (token.type == path_token::kind::operation) {
+                    if (!token.operation) {
+                        return fail();
+                    }
 
-            if (bs::istarts_with(path, ".key")) {
-                isKeyVisit = true;
-                rightPath = path.begin() + bs::size(".key") - 1;
+                    operator_application application(context, *token.operation);
+                    application.u_apply(*container, token.text.c_str());
+                    if (application.has_busy()) {
+                        if (!mayWait) {
+                            return false;
+                        }
+                        chain.release();
+                        application.visit_busy();
+                    }
+                    chain.release();
+
+                    item result = application.result();
+                    itemFunction(&result);
+                    return true;
+                }
+
+                pending = &token;
+                pendingForm = form;
             }
-            else if (bs::istarts_with(path, ".value")) {
-                isKeyVisit = false;
-                rightPath = path.begin() + bs::size(".value") - 1;
-            } else {
-                return false;
+
+            if (!path.complete) {
+                return fail();
             }
 
-            auto copy = container.container_copy();
+            if (!pending) {
+                item itm(container);
+                itemFunction(&itm);
+                return true;
+            }
 
-            if (isKeyVisit) {
-                item itm;
-                for (auto &pair : copy) {
-                    itm = pair.first;
-                    resolve(context, itm, rightPath, function);
-                }
-            } else { // is value visit
-                for (auto &pair : copy) {
-                    resolve(context, pair.second, rightPath, function);
+            // the writer gets the value of a packed array copied, the value is stored back then:
+            // the array stays packed if the new value fits it (see array::u_modify)
+            if (createMissingKeys && pending->type == path_token::kind::index) {
+                if (auto arr = container->as<array>()) {
+                    if (!arr->u_modify(pending->index, [&](item& itm) { itemFunction(&itm); })) {
+                        itemFunction(nullptr);
+                    }
+                    return true;
                 }
             }
 
+            itemFunction(u_pending_item(nullptr));
             return true;
         }
 
         void resolve(tes_context& context, item& target, const char *cpath,
-            const std::function<void(item *)>& itemFunction, bool createMissingKeys)
+            item_visitor itemFunction, bool createMissingKeys)
         {
             if (!cpath) {
                 return;
@@ -100,7 +441,7 @@ namespace collections
         }
 
         void resolve(tes_context& context, object_base *collection, const char *cpath,
-            const std::function<void(item *)>& itemFunction, bool createMissingKeys)
+            item_visitor itemFunction, bool createMissingKeys)
         {
 
             if (!collection || !cpath) {
@@ -114,424 +455,318 @@ namespace collections
                 return ;
             }
 
-            namespace bs = boost;
-            namespace ss = std;
+            path_cache::pin pinned;
+            u_walk(context, *collection, *compiled(cpath), itemFunction, createMissingKeys, true);
+        }
 
-            auto path = bs::make_iterator_range(cpath, cpath + strnlen_s(cpath, 1024));
+        //////////////////////////////////////////////////////////////////////////
 
-            auto operatorRule = [createMissingKeys, &context](const state &st) -> state {
-                const auto& path = st.path;
+        // The prefix trie of the paths: a node per distinct token sequence, the paths sharing a prefix share its nodes.
+        // Walked by the readers only. A collection gets visited under its lock, the lock of the next one is taken without
+        // waiting (see object_lock_chain): a busy subtree gets walked later, once the thread holds no lock
+        class path_trie {
 
-                if (!bs::starts_with(path, "@") || path.size() < 2) {
-                    return state(false, st);
-                }
+            enum : uint32_t {
+                none = ~0u,
+            };
 
-                auto begin = path.begin() + 1;
-                auto end = bs::find_if(path_type(begin, path.end()), bs::is_any_of("."));
-                auto operationStr = ss::string(begin, end);
+            struct node {
+                const path_token *token = nullptr;  // null for the root
+                std::optional<FormId> form;         // [__formData|...], none if there is no such form
+                uint32_t first_child = none;
+                uint32_t next_sibling = none;
+                uint32_t first_path = none;         // the paths ending at the node, linked through the _next_path
+            };
 
-                if (operationStr.empty()) {
-                    return state(false, st);
-                }
+            tes_context& _context;
+            indexed_item_visitor _visitor;
+            std::vector<node> _nodes;
+            std::vector<uint32_t> _next_path;
+            std::vector<std::pair<uint32_t, object_stack_ref>> _busy;  // the subtrees to walk later and their collections
 
-                auto rightPath = path_type(end, path.end());
+            static bool same_token(const path_token& left, const path_token& right) {
+                return left.type == right.type && left.index == right.index && left.form_id == right.form_id
+                    && left.operation == right.operation && left.text == right.text;
+            }
 
-                auto collection = st.nodeGetter(st.object)->object();
+            uint32_t u_child(uint32_t parent, const path_token& token) {
+                uint32_t *link = &_nodes[parent].first_child;
+                for (; *link != none; link = &_nodes[*link].next_sibling) {
+                    if (same_token(*_nodes[*link].token, token)) {
+                        return *link;
+                    }
+                }
 
-                if (!collection) {
-                    return state(false, st);
+                node child;
+                child.token = &token;
+                if (token.type == path_token::kind::form) {
+                    child.form = forms::form_from_file(token.text, token.form_id);
                 }
+                const uint32_t childIdx = static_cast<uint32_t>(_nodes.size());
+                *link = childIdx;   // before the push, which may move the nodes
+                _nodes.push_back(child);
+                return childIdx;
+            }
 
-                auto opr = operators::get_operator(operationStr.c_str());
+            void visit_paths(uint32_t nodeIdx, item *itm) {
+                for (uint32_t path = _nodes[nodeIdx].first_path; path != none; path = _next_path[path]) {
+                    _visitor(path, itm);
+                }
+            }
 
-                if (!opr) {
-                    return state(false, st);
+            // the paths of the subtree lead nowhere
+            void visit_missing(uint32_t nodeIdx) {
+                visit_paths(nodeIdx, nullptr);
+                for (uint32_t child = _nodes[nodeIdx].first_child; child != none; child = _nodes[child].next_sibling) {
+                    visit_missing(child);
                 }
+            }
+
+            // the @collection must be locked
+            void u_walk_children(uint32_t nodeIdx, const object_base& collection) {
+                for (uint32_t childIdx = _nodes[nodeIdx].first_child; childIdx != none; childIdx = _nodes[childIdx].next_sibling) {
+                    const node& child = _nodes[childIdx];
+                    if (child.token->type == path_token::kind::form && !child.form) {
+                        visit_missing(childIdx);
+                        continue;
+                    }
 
-                item sharedItem;
+                    item scratch;
+                    item *itm = const_cast<item *>(u_read_token_item(_context, collection, *child.token,
+                        child.form.value_or(FormId::Zero), scratch));
+                    visit_paths(childIdx, itm);
 
-                auto itemVisitFunc = [&](item *item) {
-                    if (item) {
-                        opr->func(*item, sharedItem);
+                    if (child.first_child == none) {
+                        continue;
                     }
-                };
 
-                struct 
-                {
-                    decltype(context)       context;
-                    decltype(rightPath)     *rightPath;
-                    decltype(itemVisitFunc) *visitFunc;
-
-                    void operator()(array& arr) {
-                        // have to copy array to prevent its modification during iteration
-                        auto array_copy = arr.container_copy();
-                        for (auto &itm : array_copy) {
-                            resolve(context, itm, rightPath->begin(), *visitFunc);
+                    object_base *next = itm ? itm->object() : nullptr;
+                    if (!next) {
+                        for (uint32_t grandChild = child.first_child; grandChild != none; grandChild = _nodes[grandChild].next_sibling) {
+                            visit_missing(grandChild);
                         }
+                        continue;
                     }
-                    void operator()(map& cnt) {
-                        _map_visit_helper(context, cnt, *rightPath, *visitFunc);
-                    }
-                    void operator()(form_map& cnt) {
-                        _map_visit_helper(context, cnt, *rightPath, *visitFunc);
+
+                    object_lock_chain chain(true);
+                    if (chain.try_step(*next)) {
+                        u_walk_children(childIdx, *next);
                     }
-                    void operator()(integer_map& cnt) {
-                        _map_visit_helper(context, cnt, *rightPath, *visitFunc);
+                    else {
+                        _busy.emplace_back(childIdx, object_stack_ref(next));
                     }
+                }
+            }
 
-                } helper{ context, &rightPath, &itemVisitFunc };
-
-                perform_on_object(*collection, helper);
-
-                return state(true,
-                    [=](object_base *) mutable -> item* { return &sharedItem;},
-                    nullptr,
-                    path_type());
-            };
-
-            auto mapRule = [createMissingKeys, &context](const state &st) -> state {
+        public:
 
-                const auto& path = st.path;
+            path_trie(tes_context& context, indexed_item_visitor visitor)
+                : _context(context), _visitor(visitor), _nodes(1) {}
 
-                if (!bs::starts_with(path, ".") || path.size() < 2) {
-                    return state(false, st);
+            void insert(uint32_t pathIdx, const compiled_path& path) {
+                uint32_t nodeIdx = 0;
+                for (const path_token& token : path.tokens) {
+                    nodeIdx = u_child(nodeIdx, token);
                 }
-
-                auto begin = path.begin() + 1;
-                auto end = bs::find_if(path_type(begin, path.end()), bs::is_any_of(".["));
-
-                if (begin == end) {
-                    return state(false, st);
+                if (_next_path.size() <= pathIdx) {
+                    _next_path.resize(pathIdx + 1, none);
                 }
+                _next_path[pathIdx] = _nodes[nodeIdx].first_path;
+                _nodes[nodeIdx].first_path = pathIdx;
+            }
 
-                object_lock lock(st.object);
-                auto node = st.nodeGetter(st.object);
-
-                if (createMissingKeys && node && node->isNull()) {
-                    *node = map::object(context);
+            void walk(object_base& collection) {
+                {
+                    object_lock_chain chain(true);
+                    chain.step(collection);
+                    u_walk_children(0, collection);
                 }
 
-                auto container = node ? node->object() : nullptr;
+                while (!_busy.empty()) {
+                    auto subtree = std::move(_busy.back());
+                    _busy.pop_back();
 
-                if (!container) {
-                    return state(false, st);
+                    object_lock_chain chain(true);
+                    chain.step(*subtree.second);
+                    u_walk_children(subtree.first, *subtree.second);
                 }
+            }
+        };
 
-                return state(   true,
-                                    [=](object_base *container) {
-                                        item *itemPtr = nullptr;
-
-                                        if (auto obj = container->as<map>()) {
-                                            ss::string key(begin, end);
-                                            itemPtr = obj->u_get(key);
-
-                                            if (!itemPtr && createMissingKeys) {
-                                                obj->u_set(key, item());
-                                                itemPtr = obj->u_get(key);
-                                            }
-                                        }
-
-                                        return itemPtr;
-                                },
-                                container,
-                                path_type(end, path.end()) );
-            };
+        void resolve_many(tes_context& context, object_base *collection, const char *const *paths, size_t count,
+            indexed_item_visitor itemFunction)
+        {
+            if (!collection || !paths) {
+                return;
+            }
 
-            auto arrayRule = [&context](const state &st) -> state {
+            // the compiled paths stay alive till the end, the trie points to their tokens
+            path_cache::pin pinned;
 
-                const auto& path = st.path;
+            path_trie trie(context, itemFunction);
+            bool hasTrie = false;
 
-                if (!bs::starts_with(path, "[") || path.size() < 3) {
-                    return state(false, st);
+            for (size_t i = 0; i < count; ++i) {
+                const char *cpath = paths[i];
+                if (!cpath) {
+                    itemFunction(i, nullptr);
+                    continue;
                 }
-
-                auto begin = path.begin() + 1;
-                auto end = bs::find_if(path_type(begin, path.end()), bs::is_any_of("]"));
-                auto indexRange = path_type(begin, end);
-
-                if (indexRange.empty()) {
-                    return state(false, st);
+                if (!*cpath) {
+                    item itm(collection);
+                    itemFunction(i, &itm);
+                    continue;
                 }
 
-                int32_t indexOrFormId = 0;
-                FormId frmId = FormId::Zero;
-
-                if (!forms::is_form_string(indexRange.begin())) {
-                    try {
-                        indexOrFormId = std::stoi(ss::string(indexRange.begin(), indexRange.end()), nullptr, 0);
-                    }
-                    catch (const std::invalid_argument& ) {
-                        return state(false, st);
-                    }
-                    catch (const std::out_of_range& ) {
-                        return state(false, st);
-                    }
+                auto path = compiled(cpath);
+                if (!path->complete) {
+                    itemFunction(i, nullptr);
+                    continue;
                 }
-                else {
-                    if (auto fId = forms::string_to_form (indexRange.begin ()))
-                        frmId = *fId;
-                    else
-                        return state (false, st);
-                }
-
-                object_lock lock(st.object);
-                auto container = st.nodeGetter(st.object)->object();
-
-                if (!container) {
-                    return state(false, st);
-                }
-
-                return state(   true,
-                                [=, &context](object_base* container) {
-                                    if (container->as<array>()) {
-                                        return container->as<array>()->u_get(indexOrFormId);
-                                    }
-                                    else if (container->as<form_map>()) {
-                                        return container->as<form_map>()->u_get(make_weak_form_id(frmId, context));
-                                    }
-                                    else if (container->as<integer_map>()) {
-                                        return container->as<integer_map>()->u_get(indexOrFormId);
-                                    }
-                                    else {
-                                        return (item *)nullptr;
-                                    } 
-                                },
-                                container,
-                                path_type(end + 1, path.end()) );
-            };
-
-            const ss::function<state (const state &st) > rules[] = {operatorRule, mapRule, arrayRule};
 
-            item root(collection);
-            state st(true, [&](object_base*) { return &root;}, collection, path);
-
-            while (true) {
-
-                bool anySucceed = false;
-                for (auto& func : rules) {
-                    st = func(st);
-                    anySucceed = st.succeed;
-                    if (anySucceed) {
-                        break;
-                    }
+                // the operators take the locks their own way
+                const bool hasOperator = !path->tokens.empty() && path->tokens.back().type == path_token::kind::operation;
+                if (hasOperator) {
+                    resolve(context, collection, cpath, [&](item *itm) { itemFunction(i, itm); });
+                    continue;
                 }
 
-                if (st.path.empty() && anySucceed) {
-
-                    if (st.object) {
-                        object_lock lock(st.object);
-                        itemFunction( st.nodeGetter(st.object));
-                    } else {
-                        itemFunction( st.nodeGetter(nullptr));
-                    }
-
-                    break;
-                }
+                trie.insert(static_cast<uint32_t>(i), *path);
+                hasTrie = true;
+            }
 
-                if (!anySucceed) {
-                    itemFunction(nullptr);
-                    break;
-                }
+            if (hasTrie) {
+                trie.walk(*collection);
             }
         }
     }
 
     namespace ca {
 
-        enum {
-            string_path_length_max = 1024,
-            string_number_length_max = 20,
-        };
-
         namespace bs = boost;
 
-        using std::forward;
         using std::string;
+        using path_resolving::compiled_path;
+        using path_resolving::path_token;
 
         namespace {
-        using cstring = util::cstring;
-        //using keys = std::vector<key_variant>;
-
-        template<class R, class Arg, class F1, class ... F>
-        boost::optional<R> parse_path_helper(Arg&& a, F1&& f1, F&& ... funcs) {
-            auto result = f1(std::forward<Arg>(a));
-            if (result) {
-                return result;
-            }
-            else {
-                return parse_path_helper<R>(std::forward<Arg>(a), std::forward<F>(funcs)...);
-            }
-        };
-
-        template<class R, class Arg>
-        boost::none_t parse_path_helper(Arg&&) {
-            return boost::none;
-        }
-
-        struct key_and_rest {
-            key_variant key;
-            cstring rest_of_path;
-        };
 
+        // the key of the @index-th token, none if there is no such token or the token is not a key
         template<class Context>
-        bs::optional<key_and_rest> parse_path(Context& context, const cstring& path) {
-
-            if (path.empty()) {
+        bs::optional<key_variant> key_at(Context& context, const compiled_path& path, size_t index) {
+            if (index >= path.tokens.size()) {
                 return bs::none;
             }
 
-            auto mapRule = [](const cstring &path)-> bs::optional < key_and_rest > {
-
-                if (!bs::starts_with(path, ".") || path.size() < 2) {
-                    return bs::none;
-                }
-
-                auto begin = path.begin() + 1;
-                auto end = bs::find_if(cstring(begin, path.end()), bs::is_any_of(".["));
-
-                if (begin == end) {
-                    return bs::none;
-                }
-
-                string str(begin, end);
-                return key_and_rest{ std::move(str), cstring(end, path.end()) };
-            };
-
-            auto arrayRule = [&context](const cstring &path)-> bs::optional < key_and_rest > {
-
-                if (!bs::starts_with(path, "[") || path.size() < 3) {
-                    return bs::none;
+            const path_token& token = path.tokens[index];
+            switch (token.type) {
+            case path_token::kind::key:
+                return key_variant{ token.text.c_str() };
+            case path_token::kind::index:
+                return key_variant{ token.index };
+            case path_token::kind::form:
+                if (auto fId = forms::form_from_file(token.text, token.form_id)) {
+                    return key_variant{ make_weak_form_id(*fId, context) };
                 }
-
-                auto begin = path.begin() + 1;
-                auto end = bs::find_if(cstring(begin, path.end()), bs::is_any_of("]"));
-                auto indexRange = cstring(begin, end);
-
-                if (indexRange.empty()) {
-                    return bs::none;
-                }
-
-                if (!forms::is_form_string(indexRange.begin())) {
-                    int32_t index = 0;
-                    try {
-                        index = std::stoi(string(indexRange.begin(), indexRange.end()), nullptr, 0);
-                    }
-                    catch (const std::invalid_argument&) {
-                        return bs::none;
-                    }
-                    catch (const std::out_of_range&) {
-                        return bs::none;
-                    }
-
-                    return key_and_rest{ index, cstring(end + 1, path.end()) };
-                }
-                else {
-                    auto fId = forms::string_to_form (indexRange.begin ());
-                    if (!fId)
-                        return bs::none;
-
-                    return key_and_rest{ make_weak_form_id(*fId, context), cstring(end + 1, path.end()) };
-                }
-            };
-
-            return parse_path_helper<key_and_rest>(path, arrayRule, mapRule);
+                return bs::none;
+            default:
+                return bs::none;
+            }
         }
 
         struct constant_accessor {
-            static bs::optional<object_base*> access_value(object_base& collection, const bs::optional<key_and_rest>& key) {
-                if (!key) {
-                    return bs::none;
-                }
-                object_lock lock(collection);
-                auto itemPtr = u_access_value(collection, key->key);
-                return itemPtr ? bs::make_optional(itemPtr->object()) : bs::none;
+            enum { creates_items = false };
+
+            static object_base* access_value(object_base& collection, const key_variant& key, const compiled_path&, size_t) {
+                object_read_lock lock(collection);
+                item scratch;
+                auto itemPtr = u_read_value(collection, key, scratch);
+                return itemPtr ? itemPtr->object() : nullptr;
             }
         };
 
         struct creative_accessor {
-            static bs::optional<object_base*> access_value(object_base& collection, const bs::optional<key_and_rest>& key) {
-                if (!key) {
-                    return bs::none;
-                }
+            enum { creates_items = true };
+
+            // @next is the index of the token which follows the @key
+            static object_base* access_value(object_base& collection, const key_variant& key, const compiled_path& path, size_t next) {
                 object_lock lock(collection);
-                auto itemPtr = u_access_value(collection, key->key);
+                item scratch;
+                if (auto itemPtr = u_read_value(collection, key, scratch)) {
+                    return itemPtr->object();
+                }
                 /*  is int-map and key is int
                 is form-map
                 is map and key is string
                 failure
                 */
-                if (!itemPtr) {
-                    itemPtr = u_assign_value(collection, key->key, item());
-                    auto next_key = parse_path(HACK_get_tcontext(collection), key->rest_of_path);
-                    if (itemPtr && next_key) {
-                        struct creator : public bs::static_visitor<object_base*> {
-                            object_context* ctx;
-                            explicit creator(object_context* c) : ctx(c) {}
-
-                            object_base* operator ()(const int32_t& k) const { return &integer_map::object(*ctx); }
-                            object_base* operator ()(const string& k) const { return &map::object(*ctx); }
-                            object_base* operator ()(const form_ref& k) const { return &form_map::object(*ctx); }
-                        };
-                        *itemPtr = bs::apply_visitor(creator(&collection.context()), next_key->key);
-                    }
+                item *itemPtr = u_assign_value(collection, key, item());
+                auto next_key = key_at(HACK_get_tcontext(collection), path, next);
+                if (itemPtr && next_key) {
+                    struct creator : public bs::static_visitor<object_base*> {
+                        object_context* ctx;
+                        explicit creator(object_context* c) : ctx(c) {}
+
+                        object_base* operator ()(const int32_t& k) const { return &integer_map::object(*ctx); }
+                        object_base* operator ()(const char* k) const { return &map::object(*ctx); }
+                        object_base* operator ()(const form_ref& k) const { return &form_map::object(*ctx); }
+                    };
+                    *itemPtr = bs::apply_visitor(creator(&collection.context()), *next_key);
                 }
 
-                return itemPtr ? bs::make_optional(itemPtr->object()) : bs::none;
+                return itemPtr ? itemPtr->object() : nullptr;
             }
 
         };
 
+        // Walks the compiled path down to the last key: the collection which should hold the value and the value's key.
+        // Every key but the last one must point to a collection
         template<class access_value>
         struct last_kv_pair_retriever {
 
-            /* Propotype:
-
-            retrieve obj -> str -> (obj, key)
-            retrieve obj str = recurs obj[(key, rest)] (key, rest) obj
-                                where
-                                    (key, rest) = parse str
+            static bs::optional<accesss_info> retrieve(object_base& collection, const compiled_path& path) {
+                object_base *source = &collection;
 
-            recurs v    (key, rest)     src = recurs v[(nkey, nrest)] (nkey, nrest) v where (nkey, nrest) = parse rest
-            recurs V    (key, Nothing)  src = (src, key)
-            recurs None (key, Nothing)  src = (src, key) ????
-            recurs _    _               _   = Nothing
-            
-            */
-
-            static bs::optional<accesss_info> retrieve(object_base& collection, const cstring& path) {
-                auto key_opt = parse_path(HACK_get_tcontext(collection), path);
-                return recurs(access_value::access_value(collection, key_opt), key_opt, collection);
-            }
-
-            static bs::optional<accesss_info> recurs(bs::optional<object_base*>&& value, const bs::optional<key_and_rest>& k, object_base& source) {
-                if (!k) {
-                    return bs::none;
-                }
+                for (size_t i = 0; ; ++i) {
+                    auto key = key_at(HACK_get_tcontext(*source), path, i);
+                    if (!key) {
+                        return bs::none;
+                    }
 
-                object_base* as_object = value.get_value_or(nullptr);
+                    // the rest of the path is empty. The caller accesses the value itself,
+                    // there is no need to lock the collection for the constant access
+                    const bool last = (i + 1 == path.tokens.size() && path.complete);
+                    if (last && !access_value::creates_items) {
+                        return accesss_info{ *source, std::move(*key) };
+                    }
 
-                if (k->rest_of_path.empty()) {
-                    return accesss_info{ source, std::move(k->key) };
-                }
-                else if (as_object && !k->rest_of_path.empty()) {
-                    auto next_key = parse_path(HACK_get_tcontext(source), k->rest_of_path);
-                    return recurs(access_value::access_value(*as_object, next_key), next_key, *as_object);
-                }
-                else {
-                    return bs::none;
+                    object_base *value = access_value::access_value(*source, *key, path, i + 1);
+                    if (last) {
+                        return accesss_info{ *source, std::move(*key) };
+                    }
+                    if (!value) {
+                        return bs::none;
+                    }
+                    source = value;
                 }
             }
         };
         }
 
         bs::optional<accesss_info> access_constant(object_base& collection, const char* cpath) {
-            auto all_path = util::make_cstring_safe(cpath, string_path_length_max);
-            return last_kv_pair_retriever<constant_accessor>::retrieve(collection, all_path);
+            if (!cpath) {
+                return bs::none;
+            }
+            const auto path = path_resolving::compiled(cpath);
+            return last_kv_pair_retriever<constant_accessor>::retrieve(collection, *path);
         }
 
         bs::optional<accesss_info> access_creative(object_base& collection, const char* cpath) {
-            auto all_path = util::make_cstring_safe(cpath, string_path_length_max);
-            return last_kv_pair_retriever<creative_accessor>::retrieve(collection, all_path);
+            if (!cpath) {
+                return bs::none;
+            }
+            const auto path = path_resolving::compiled(cpath);
+            return last_kv_pair_retriever<creative_accessor>::retrieve(collection, *path);
         }
     }
 }
@@ -7,6 +7,8 @@
 
 #include "collections/collections.h"
 #include "collections/default_value.h"
+#include "collections/path_cache.h"
+#include "util/function_ref.h"
 
 namespace collections
 {
@@ -16,11 +18,29 @@ namespace collections
 
     namespace path_resolving {
 
+        // the path parsed into the tokens, the paths get compiled once and cached.
+        // The path stays valid while the calling thread holds a path_cache::pin
+        const compiled_path* compiled(const char *cpath);
+        path_cache::statistics cache_statistics();
+
+        // the resolved item or null. The item is valid during the call only and must not be modified:
+        // the visitor runs under the lock the walker shares with the other readers
+        typedef util::function_ref<void(item *)> item_visitor;
+
         void resolve(tes_context& ctx, item& target, const char *cpath,
-            const std::function<void(item *)>& itemFunction, bool createMissingKeys = false);
+            item_visitor itemFunction, bool createMissingKeys = false);
 
         void resolve(tes_context& ctx, object_base *target, const char *cpath,
-            const std::function<void(item *)>& itemFunction, bool createMissingKeys = false);
+            item_visitor itemFunction, bool createMissingKeys = false);
+
+        // the item of the path with the index given, or null. The same rules as for the item_visitor
+        typedef util::function_ref<void(size_t index, item *)> indexed_item_visitor;
+
+        // Resolves the @count paths at once. The paths sharing a prefix share its walk: each container on the way
+        // gets locked and looked up once, whatever the number of the paths going through it.
+        // The @itemFunction gets called once per path (if there is the @target), in no particular order of the paths
+        void resolve_many(tes_context& ctx, object_base *target, const char *const *paths, size_t count,
+            indexed_item_visitor itemFunction);
 
         template<class T>
         inline T _resolve(tes_context& ctx, object_base *target, const char *cpath, T def = default_value<T>()) {
@@ -38,28 +58,69 @@ namespace collections
     namespace ca {
         namespace bs = boost;
 
-        using key_variant = boost::variant<int32_t, std::string, form_ref>;
+        // The key of a collection. The map keys point into the compiled path, so the key is valid
+        // as long as the path is (see path_resolving::path_cache::pin) - no copy of the key text is made
+        using key_variant = boost::variant<int32_t, const char*, form_ref>;
 
-        struct u_access_value_helper {
+        template<class Collection> struct variant_key { using type = typename Collection::key_type; };
+        template<> struct variant_key<map> { using type = const char*; };
+
+        // the value at the @key, null if there is none. The collection is not changed: the value of a packed array gets copied into the @scratch
+        struct u_read_value_helper {
             template<class Collection>
-            item* operator () (Collection& collection, const key_variant& key) {
-                if (auto idx = bs::get<typename Collection::key_type>(&key)) {
+            const item* operator () (const Collection& collection, const key_variant& key, item& scratch) {
+                if (auto idx = bs::get<typename variant_key<Collection>::type>(&key)) {
                     return collection.u_get(*idx);
                 }
                 return nullptr;
             }
+
+            const item* operator () (const array& collection, const key_variant& key, item& scratch) {
+                if (auto idx = bs::get<int32_t>(&key)) {
+                    return collection.u_get(*idx, scratch);
+                }
+                return nullptr;
+            }
         };
 
-        inline auto u_access_value(object_base& collection, const key_variant& key) -> item* {
-            return perform_on_object_and_return<item* >(collection, u_access_value_helper(), key);
+        inline auto u_read_value(const object_base& collection, const key_variant& key, item& scratch) -> const item* {
+            return perform_on_object_and_return<const item* >(collection, u_read_value_helper(), key, scratch);
         };
+
+        // calls the @func with the value at the @key, which the function may change. False if there is no value.
+        // A packed array stays packed as long as the new value fits it (see array::u_modify)
+        struct u_modify_value_helper {
+            template<class Collection, class F>
+            bool operator () (Collection& collection, const key_variant& key, F& func) {
+                if (auto idx = bs::get<typename variant_key<Collection>::type>(&key)) {
+                    if (item *itm = collection.u_get(*idx)) {
+                        func(*itm);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            template<class F>
+            bool operator () (array& collection, const key_variant& key, F& func) {
+                if (auto idx = bs::get<int32_t>(&key)) {
+                    return collection.u_modify(*idx, func);
+                }
+                return false;
+            }
+        };
+
+        template<class F>
+        inline bool u_modify_value(object_base& collection, const key_variant& key, F&& func) {
+            return perform_on_object_and_return<bool >(collection, u_modify_value_helper(), key, func);
+        }
         // 
 
         template<class Value>
         struct u_assign_value_helper {
             template<class T>
             item* operator()(T& obj, const key_variant& key, Value&& value) {
-                if (auto idx = bs::get<typename T::key_type>(&key)) {
+                if (auto idx = bs::get<typename variant_key<T>::type>(&key)) {
                     return obj.u_set(*idx, std::forward<Value>(value));
                 }
                 return nullptr;
@@ -75,7 +136,7 @@ namespace collections
         struct u_erase_key_helper {
             template<class T>
             bool operator()(T& obj, const key_variant& key) {
-                if (auto idx = bs::get<typename T::key_type>(&key)) {
+                if (auto idx = bs::get<typename variant_key<T>::type>(&key)) {
                     return obj.u_erase(*idx);
                 }
                 return false;
@@ -101,16 +162,19 @@ namespace collections
             creative,
         };
 
+        // the caller holds a path_resolving::path_cache::pin while it uses the result
         bs::optional<accesss_info> access_constant(object_base& tree, const char* path);
         bs::optional<accesss_info> access_creative(object_base& tree, const char* path);
 
 
         inline bs::optional<item> get(object_base& target, const char *cpath) {
+            path_resolving::path_cache::pin pinned;
             auto ac_info = access_constant(target, cpath);
             if (ac_info) {
-                object_lock g(ac_info->collection);
-                auto itmPtr = u_access_value(ac_info->collection, ac_info->key);
-                return _opt_from_pointer(itmPtr);
+                object_read_lock g(ac_info->collection);
+                item scratch;
+                auto itmPtr = u_read_value(ac_info->collection, ac_info->key, scratch);
+                return itmPtr ? bs::optional<item>(*itmPtr) : bs::none;
             }
             else {
                 return bs::none;
@@ -119,14 +183,13 @@ namespace collections
 
         template<class Func, class ...Args>
         inline bool visit_value(object_base& target, const char *cpath, access_way way, Func f, Args&&... args) {
+            path_resolving::path_cache::pin pinned;
             auto ac_info = (way == constant ? access_constant(target, cpath) : access_creative(target, cpath));
             if (ac_info) {
                 object_lock g(ac_info->collection);
-                auto itmPtr = u_access_value(ac_info->collection, ac_info->key);
-                if (itmPtr) {
-                    f(*itmPtr, std::forward<Args>(args)...);
-                }
-                return itmPtr != nullptr;
+                return u_modify_value(ac_info->collection, ac_info->key, [&](item& itm) {
+                    f(itm, std::forward<Args>(args)...);
+                });
             }
             else {
                 return false;
@@ -135,31 +198,35 @@ namespace collections
 
         template<class Value>
         inline bs::optional<Value> get(object_base& target, const char *cpath) {
+            path_resolving::path_cache::pin pinned;
             auto ac_info = access_constant(target, cpath);
             if (ac_info) {
-                object_lock g(ac_info->collection);
-                auto itmPtr = u_access_value(ac_info->collection, ac_info->key);
-                return itmPtr ? _opt_from_pointer(itmPtr->get<Value>()) : bs::none;
+                object_read_lock g(ac_info->collection);
+                item scratch;
+                auto itmPtr = u_read_value(ac_info->collection, ac_info->key, scratch);
+                auto value = itmPtr ? itmPtr->get<Value>() : nullptr;
+                return value ? bs::optional<Value>(*value) : bs::none;
             }
             else {
                 return bs::none;
             }
         }
 
+        // the existing value gets assigned in place (a packed array stays packed if the value fits it),
+        // the creative assignment adds the missing one
         template<class Value>
         bool assign(object_base& target, const char *cpath, Value&& value, access_way way = constant) {
+            path_resolving::path_cache::pin pinned;
             auto ac_info = (way == constant ? access_constant(target, cpath) : access_creative(target, cpath));
             if (ac_info) {
                 object_lock g(ac_info->collection);
-                if (way == constant) {
-                    auto itmPtr = u_access_value(ac_info->collection, ac_info->key);
-                    if (itmPtr) {
-                        *itmPtr = std::forward<Value>(value);
-                    }
-                    return itmPtr != nullptr;
-                } else {
-                    return u_assign_value(ac_info->collection, ac_info->key, std::forward<Value>(value)) != nullptr;
+                const bool assigned = u_modify_value(ac_info->collection, ac_info->key, [&](item& itm) {
+                    itm = std::forward<Value>(value);
+                });
+                if (assigned || way == constant) {
+                    return assigned;
                 }
+                return u_assign_value(ac_info->collection, ac_info->key, std::forward<Value>(value)) != nullptr;
             }
             else {
                 return false;
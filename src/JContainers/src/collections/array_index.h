@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "util/stl_ext.h"
+#include "collections/item.h"
+
+namespace collections {
+
+    // Index of an array of collections by the value found at a path inside of each item:
+    // the ".name" index maps the names of the maps the array contains to their positions.
+    //
+    // The array keeps the positions up to date: they shift with the insertions and erasures,
+    // the inserted and the replaced items are pending - their values are to be read yet,
+    // the changes which move many items at once (sorting, swapping, assignment) make the whole index stale.
+    // Reading the values means locking the items, which is not allowed while the array is locked,
+    // so it happens later, outside of the array lock (see array_functions::refresh_index).
+    //
+    // The items themselves are not watched: an item whose value changes is still found by its old value,
+    // until the index gets rebuilt. The lookups check the found items against the value.
+    // Only integer, float, form and string values get indexed, the strings case-insensitively
+    class array_field_index {
+    public:
+
+        // the value in a comparable form: the strings lower-cased, the forms by their identifiers
+        struct key {
+            item_type type = item_type::no_item;
+            uint32_t bits = 0;
+            std::string text;
+
+            bool operator == (const key& other) const {
+                return type == other.type && bits == other.bits && text == other.text;
+            }
+        };
+
+        struct key_hash {
+            size_t operator () (const key& k) const {
+                size_t hash = std::hash<std::string>()(k.text);
+                hash ^= (size_t(k.bits) + size_t(util::to_integral(k.type)) * 0x9e3779b9u) + (hash << 6) + (hash >> 2);
+                return hash;
+            }
+        };
+
+        // false if the value can't be indexed
+        static bool make_key(const item& value, key& k) {
+            k.type = value.type();
+            k.bits = 0;
+            k.text.clear();
+
+            switch (k.type) {
+            case item_type::integer:
+                k.bits = static_cast<uint32_t>(value.intValue());
+                return true;
+            case item_type::real: {
+                float real = value.fltValue();
+                real = (real == 0.f ? 0.f : real);  // -0 equals 0
+                std::memcpy(&k.bits, &real, sizeof(real));
+                return true;
+            }
+            case item_type::form:
+                k.bits = util::to_integral(value.formId());
+                return true;
+            case item_type::string: {
+                const char *str = value.strValue();
+                k.text.assign(str, str + std::strlen(str));
+                std::transform(k.text.begin(), k.text.end(), k.text.begin(),
+                    [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+                return true;
+            }
+            default:
+                return false;
+            }
+        }
+
+    private:
+
+        std::string _path;
+        std::unordered_multimap<key, uint32_t, key_hash> _positions;
+        std::vector<uint32_t> _pending;
+        bool _stale = true;
+        uint32_t _generation = 0;   // changes with every change of the index
+
+        // @shift updates the position, returns false if the position is gone
+        template<class F>
+        void u_shift(F&& shift) {
+            for (auto itr = _positions.begin(); itr != _positions.end();) {
+                if (shift(itr->second)) {
+                    ++itr;
+                }
+                else {
+                    itr = _positions.erase(itr);
+                }
+            }
+            _pending.erase(std::remove_if(_pending.begin(), _pending.end(), [&](uint32_t& position) { return !shift(position); }),
+                _pending.end());
+        }
+
+    public:
+
+        explicit array_field_index(std::string path) : _path(std::move(path)) {}
+
+        const std::string& path() const { return _path; }
+
+        uint32_t u_generation() const { return _generation; }
+
+        // all the values are to be read
+        bool u_is_stale() const { return _stale; }
+
+        // the positions of the items whose values are to be read
+        const std::vector<uint32_t>& u_pending() const { return _pending; }
+
+        bool u_is_current() const { return !_stale && _pending.empty(); }
+
+        // calls @func with the positions of the items whose value equals @value, in no particular order
+        template<class F>
+        void u_find(const item& value, F&& func) const {
+            key k;
+            if (make_key(value, k)) {
+                auto range = _positions.equal_range(k);
+                for (auto itr = range.first; itr != range.second; ++itr) {
+                    func(itr->second);
+                }
+            }
+        }
+
+        // the array has got @count items inserted at @index, it had @oldCount items
+        void u_inserted(size_t index, size_t count, size_t oldCount) {
+            ++_generation;
+            if (_stale || count == 0) {
+                return;
+            }
+            if (index < oldCount) {
+                u_shift([=](uint32_t& position) {
+                    if (position >= index) {
+                        position += static_cast<uint32_t>(count);
+                    }
+                    return true;
+                });
+            }
+            for (size_t i = index; i < index + count; ++i) {
+                _pending.push_back(static_cast<uint32_t>(i));
+            }
+        }
+
+        // the array has got the [first, last) items erased
+        void u_erased(size_t first, size_t last, size_t oldCount) {
+            ++_generation;
+            if (_stale || first == last) {
+                return;
+            }
+            if (first == 0 && last == oldCount) {
+                _positions.clear();
+                _pending.clear();
+                return;
+            }
+            u_shift([=](uint32_t& position) {
+                if (position >= last) {
+                    position -= static_cast<uint32_t>(last - first);
+                    return true;
+                }
+                return position < first;
+            });
+        }
+
+        // the item at @index has been replaced or may get modified. Its old value stays until the update
+        void u_replaced(size_t index) {
+            ++_generation;
+            if (!_stale) {
+                _pending.push_back(static_cast<uint32_t>(index));
+            }
+        }
+
+        // the items have been moved around
+        void u_reset() {
+            ++_generation;
+            if (!_stale) {
+                _stale = true;
+                _positions.clear();
+                _pending.clear();
+            }
+        }
+
+        // takes the values read for the @positions: the pending ones (with no repetitions) or, if the index is stale,
+        // all of them. The values which can't be indexed (None for the items without the path) are skipped
+        void u_update(const std::vector<uint32_t>& positions, const std::vector<item>& values) {
+            ++_generation;
+            if (_stale) {
+                _positions.clear();
+                _stale = false;
+            }
+            else if (!_pending.empty()) {
+                std::vector<uint32_t> replaced(_pending);
+                std::sort(replaced.begin(), replaced.end());
+                u_shift([&](uint32_t& position) { return !std::binary_search(replaced.begin(), replaced.end(), position); });
+            }
+            _pending.clear();
+
+            key k;
+            for (size_t i = 0; i < positions.size(); ++i) {
+                if (make_key(values[i], k)) {
+                    _positions.emplace(std::move(k), positions[i]);
+                }
+            }
+        }
+    };
+
+    // the indexes of an array, by their paths
+    typedef std::vector<array_field_index> array_field_indexes;
+}
@@ -44,7 +44,10 @@ BOOST_CLASS_EXPORT_GUID(collections::map, "kJMap");
 BOOST_CLASS_EXPORT_GUID(collections::form_map, "kJFormMap");
 BOOST_CLASS_EXPORT_GUID(collections::integer_map, "kJIntegerMap");
 
-BOOST_CLASS_VERSION(collections::form_map, 1)
+BOOST_CLASS_VERSION(collections::array, 1)
+BOOST_CLASS_VERSION(collections::map, 1)
+BOOST_CLASS_VERSION(collections::form_map, 2)
+BOOST_CLASS_VERSION(collections::integer_map, 1)
 BOOST_CLASS_VERSION(collections::item, 3)
 
 BOOST_CLASS_IMPLEMENTATION(boost::blank, boost::serialization::primitive_type);
@@ -70,6 +73,8 @@ namespace collections {
     template<class Archive>
     void item::load(Archive & ar, const unsigned int version)
     {
+        auto& strings = hack::iarchive_with_blob::from_base_get<tes_context>(ar)._string_pool;
+
         switch (version)
         {
         default:
@@ -80,39 +85,212 @@ namespace collections {
             using variant_old = boost::variant<boost::blank, SInt32, Real, FormId, internal_object_ref, std::string>;
             variant_old var;
             ar >> var;
-            var.apply_visitor(converter_324_to_330<Archive>{ _var, ar });
+            variant converted;
+            var.apply_visitor(converter_324_to_330<Archive>{ converted, ar });
+            *this = from_variant(std::move(converted), strings);
         }
             break;
 
-        case 3:
-            ar & _var;
+        case 3: {
+            variant var;
+            ar & var;
+            *this = from_variant(std::move(var), strings);
+        }
             break;
         }
     }
 
     template<class Archive>
     void item::save(Archive & ar, const unsigned int version) const {
-        ar & _var;
+        const variant var = to_variant();
+        ar & var;
+    }
+
+    item::variant item::to_variant() const {
+        struct to_variant_visitor {
+            variant operator()(const util::cstring& str) const {
+                return std::string(str.begin(), str.end());
+            }
+            template<class T> variant operator()(const T& value) const {
+                return value;
+            }
+        };
+        return visit(to_variant_visitor{});
+    }
+
+    item item::from_variant(variant&& var, util::string_pool& strings) {
+        struct from_variant_visitor : boost::static_visitor<> {
+            item& itm;
+            util::string_pool& strings;
+            from_variant_visitor(item& i, util::string_pool& s) : itm(i), strings(s) {}
+
+            void operator()(boost::blank&) const {}
+            void operator()(SInt32& value) const { itm = value; }
+            void operator()(Real& value) const { itm = value; }
+            void operator()(form_ref& value) const { itm = value; }
+            void operator()(std::string& value) const {
+                if (value.size() > item::short_string_capacity) {
+                    itm = strings.intern(value.c_str(), value.size());
+                }
+                else {
+                    itm = value;
+                }
+            }
+            void operator()(internal_object_ref& value) const { itm = value.get(); }
+        };
+
+        item result;
+        var.apply_visitor(from_variant_visitor{ result, strings });
+        return result;
     }
 
     //////////////////////////////////////////////////////////////////////////
 
+    template<class Archive, class T>
+    static void save_raw_block(Archive & ar, const std::vector<T>& values) {
+        const uint32_t count = static_cast<uint32_t>(values.size());
+        ar & count;
+        if (count) {
+            ar.save_binary(values.data(), count * sizeof(T));
+        }
+    }
+
+    template<class Archive, class T>
+    static void load_raw_block(Archive & ar, std::vector<T>& values) {
+        uint32_t count = 0;
+        ar & count;
+        values.resize(count);
+        if (count) {
+            ar.load_binary(values.data(), count * sizeof(T));
+        }
+    }
+
+    // Version 1 starts with the packing kind. Packed integers and floats are written as raw blocks,
+    // packed forms go through form_ref serialization (it remaps plugin indexes), the rest are generic items
+    template<class Archive>
+    void array::save(Archive & ar, const unsigned int version) const {
+        ar & boost::serialization::base_object<object_base>(*this);
+
+        const int32_t kind = _packed.kind();
+        ar & kind;
+
+        switch (_packed.kind()) {
+        case item_type::integer:
+            save_raw_block(ar, *_packed.values<SInt32>());
+            break;
+        case item_type::real:
+            save_raw_block(ar, *_packed.values<item::Real>());
+            break;
+        case item_type::form:
+            ar & *_packed.values<form_ref>();
+            break;
+        default:
+            ar & _array;
+            break;
+        }
+    }
+
+    template<class Archive>
+    void array::load(Archive & ar, const unsigned int version) {
+        ar & boost::serialization::base_object<object_base>(*this);
+
+        int32_t kind = item_type::none;
+        if (version >= 1) {
+            ar & kind;
+        }
+
+        switch (kind) {
+        case item_type::integer:
+            _packed.start(item_type::integer);
+            load_raw_block(ar, _packed.u_ints());
+            break;
+        case item_type::real:
+            _packed.start(item_type::real);
+            load_raw_block(ar, _packed.u_reals());
+            break;
+        case item_type::form:
+            _packed.start(item_type::form);
+            ar & _packed.u_forms();
+            break;
+        default:
+            ar & _array;
+            u_try_pack();
+            break;
+        }
+    }
+
+    struct map_archive_comp {
+        bool operator() (const std::string& lhs, const std::string& rhs) const {
+            return _stricmp(lhs.c_str(), rhs.c_str()) < 0;
+        }
+    };
+
+    // the archive layout of the map, the keys are not interned there.
+    // Version 0 stored the keys in a sorted map, version 1 stores them in the iteration order
+    using map_archive_container_v0 = std::map<std::string, item, map_archive_comp>;
+    using map_archive_container = std::vector<std::pair<std::string, item>>;
+
     template<class Archive>
-    void array::serialize(Archive & ar, const unsigned int version) {
+    void map::save(Archive & ar, const unsigned int version) const {
         ar & boost::serialization::base_object<object_base>(*this);
-        ar & _array;
+
+        map_archive_container archived;
+        archived.reserve(cnt.size());
+        for (auto& pair : cnt) {
+            archived.emplace_back(std::string(pair.first.c_str(), pair.first.size()), pair.second);
+        }
+        ar & archived;
     }
 
     template<class Archive>
-    void map::serialize(Archive & ar, const unsigned int version) {
+    void map::load(Archive & ar, const unsigned int version) {
         ar & boost::serialization::base_object<object_base>(*this);
-        ar & cnt;
+
+        auto& strings = hack::iarchive_with_blob::from_base_get<tes_context>(ar)._string_pool;
+        auto fill = [&](auto& archived) {
+            cnt.reserve(archived.size());
+            for (auto& pair : archived) {
+                cnt.emplace(strings.intern(pair.first.c_str(), pair.first.size()), std::move(pair.second));
+            }
+        };
+
+        switch (version) {
+        default:
+            BOOST_ASSERT_MSG(false, "invalid map version");
+            break;
+        case 0: {
+            map_archive_container_v0 archived;
+            ar & archived;
+            fill(archived);
+        }
+            break;
+        case 1: {
+            map_archive_container archived;
+            ar & archived;
+            fill(archived);
+        }
+            break;
+        }
     }
 
+    item& map::u_get_or_create(const char* key) {
+        jc_assert(key);
+        auto result = cnt.find_or_emplace(key, [this, key]() {
+            return HACK_get_tcontext(*this)._string_pool.intern(key);
+        });
+        if (result.second) {
+            _keys_changed();
+        }
+        return result.first->second;
+    }
+
+    // Version 1 stored the pairs in a std::map sorted by FormId, version 2 stores them in the iteration order
     template<class Archive>
     void form_map::save(Archive & ar, const unsigned int version) const {
         ar & boost::serialization::base_object<object_base>(*this);
-        ar & cnt;
+
+        std::vector<value_type> archived(cnt.begin(), cnt.end());
+        ar & archived;
     }
 
     template<class Archive>
@@ -127,38 +305,80 @@ namespace collections {
             std::map<FormId, item> oldMap;
             ar >> oldMap;
             auto& fwatcher = hack::iarchive_with_blob::from_base_get<tes_context>(ar)._form_watcher;
+            cnt.reserve(oldMap.size());
             for (auto& pair : oldMap) {
                 form_ref key{ pair.first, fwatcher, form_ref::load_old_id };
                 if (key) {
-                    cnt.emplace(value_type{ std::move(key), std::move(pair.second) });
+                    cnt.emplace(std::move(key), std::move(pair.second));
                 }
             }
         }
             break;
-        case 1:
-            ar & cnt;
+        case 1: {
+            std::map<form_ref, item, form_ref::stable_less_comparer> archived;
+            ar & archived;
+            cnt.reserve(archived.size());
+            for (auto& pair : archived) {
+                cnt.emplace(pair.first, std::move(pair.second));
+            }
+        }
+            break;
+        case 2: {
+            std::vector<value_type> archived;
+            ar & archived;
+            cnt.reserve(archived.size());
+            for (auto& pair : archived) {
+                cnt.emplace(std::move(pair.first), std::move(pair.second));
+            }
+        }
             break;
         }
     }
 
+    // Version 0 stored the pairs in a std::map, version 1 stores the sorted pairs as is
     template<class Archive>
-    void integer_map::serialize(Archive & ar, const unsigned int version) {
+    void integer_map::save(Archive & ar, const unsigned int version) const {
         ar & boost::serialization::base_object<object_base>(*this);
-        ar & cnt;
+
+        std::vector<value_type> archived(cnt.begin(), cnt.end());
+        ar & archived;
+    }
+
+    template<class Archive>
+    void integer_map::load(Archive & ar, const unsigned int version) {
+        ar & boost::serialization::base_object<object_base>(*this);
+
+        switch (version) {
+        default:
+            BOOST_ASSERT_MSG(false, "invalid integer_map version");
+            break;
+        case 0: {
+            std::map<int32_t, item> archived;
+            ar & archived;
+            cnt.reserve(archived.size());
+            cnt.insert(archived.begin(), archived.end());
+        }
+            break;
+        case 1: {
+            std::vector<value_type> archived;
+            ar & archived;
+            cnt.reserve(archived.size());
+            cnt.insert(archived.begin(), archived.end());
+        }
+            break;
+        }
     }
 
     //////////////////////////////////////////////////////////////////////////
 
     void form_map::u_onLoaded() {
-
-        util::tree_erase_if(cnt, [](const value_type& pair){
-            return pair.first.is_expired();
-        });
+        u_purge_expired();
     }
 
     //////////////////////////////////////////////////////////////////////////
 
     void array::u_nullifyObjects() {
+        _reset_indexes();
         for (auto& item : _array) {
             item.u_nullifyObject();
         }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <string>
 #include <assert.h>
@@ -13,8 +14,14 @@
 #include "skse/skse.h"
 
 #include "object/object_base.h"
+#include "object/object_context.h"
+
+#include "util/ordered_hash_map.h"
+#include "util/adaptive_int_map.h"
 
 #include "collections/item.h"
+#include "collections/packed_items.h"
+#include "collections/array_index.h"
 
 namespace collections {
 
@@ -41,8 +48,25 @@ namespace collections {
         typedef typename object_stack_ref_template<T> ref;
         typedef typename object_stack_ref_template<const T> cref;
 
+        // the objects live in the pools of their context, see object_pools
+        static void* operator new(size_t size) {
+            return object_pools::allocate_loaded((CollectionType)T::TypeId, size);
+        }
+        static void* operator new(size_t size, object_context& context) {
+            return context.pools.allocate((CollectionType)T::TypeId, size);
+        }
+        static void operator delete(void *p) {
+            object_pools::deallocate(p);
+        }
+        static void operator delete(void *p, size_t) {
+            object_pools::deallocate(p);
+        }
+        static void operator delete(void *p, object_context&) {
+            object_pools::deallocate(p);
+        }
+
         static T& make(object_context& context /*= tes_context::instance()*/) {
-            auto& obj = *new T();
+            auto& obj = *new (context) T();
             obj.set_context(context);
             obj._registerSelf();
             return obj;
@@ -50,7 +74,7 @@ namespace collections {
 
         template<class Init>
         static T& _makeWithInitializer(Init& init, object_context& context /*= tes_context::instance()*/) {
-            auto& obj = *new T();
+            auto& obj = *new (context) T();
             obj.set_context(context);
             init(obj);
             obj._registerSelf();
@@ -110,6 +134,12 @@ namespace collections {
     class map;
     class object_base;
 
+    // Homogeneous integer, float or form contents are kept packed (see packed_items).
+    // The first write of a value of another type promotes the contents to generic items.
+    // The mutable access to the items themselves (u_container, u_get, operator [], iterators) promotes the contents too,
+    // so the hot paths should use the functions which understand both forms (u_item_at, u_modify, u_replace).
+    // The const access never changes the array: the readers share the lock
+    // The array keeps its field indexes (see array_field_index) up to date with its changes
     class array : public collection_base< array >
     {
         array(const array&);
@@ -130,19 +160,115 @@ namespace collections {
         typedef container_type::iterator iterator;
         typedef container_type::reverse_iterator reverse_iterator;
 
+    private:
+
         container_type _array;
+        packed_items _packed;
+
+        // null until the first index gets created. The indexes are not saved
+        std::unique_ptr<array_field_indexes> _indexes;
+
+        void _promote() {
+            _packed.unpack_into(_array);
+        }
+
+        template<class F>
+        void _update_indexes(F&& func) {
+            if (_indexes) {
+                for (auto& index : *_indexes) {
+                    func(index);
+                }
+            }
+        }
+
+        void _reset_indexes() {
+            _update_indexes([](array_field_index& index) { index.u_reset(); });
+        }
+
+        // the array must be empty, the capacity reserved for the items is passed over to the packed values
+        void _start_packing(item_type kind) {
+            const size_t reserved = _array.capacity();
+            container_type().swap(_array);
+            _packed.clear();
+            _packed.start(kind);
+            _packed.reserve(reserved);
+        }
+
+        // true if the item has to be stored packed: starts packing an empty array or promotes the packed one
+        bool _store_packed(const item& itm) {
+            if (_packed.accepts(itm)) {
+                return true;
+            }
+            if (u_count() == 0 && packed_items::is_packable(itm.type())) {
+                _start_packing(itm.type());
+                return true;
+            }
+            _promote();
+            return false;
+        }
+
+    public:
+
+        // item_type::none if the contents are not packed
+        item_type u_packing() const { return _packed.kind(); }
+        const packed_items& u_packed() const { return _packed; }
 
+        // packs the items if they all are of the same integer, float or form type
+        bool u_try_pack() { return _packed.try_pack(_array); }
+
+        // the generic items, the packed contents get promoted. The items may get changed in any way, so the indexes become stale
         container_type& u_container() {
+            _promote();
+            _reset_indexes();
             return _array;
         }
 
+        // the generic items, the contents must not be packed (see u_packing)
         const container_type& u_container() const {
+            jc_assert(!_packed.is_packed());
             return _array;
         }
 
+        // the index by the values at @path, null if there is none
+        const array_field_index* u_field_index(const char* path) const {
+            if (_indexes) {
+                for (auto& index : *_indexes) {
+                    if (index.path() == path) {
+                        return &index;
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        array_field_index* u_field_index(const char* path) {
+            return const_cast<array_field_index*>( const_cast<const array*>(this)->u_field_index(path) );
+        }
+
+        // the existing index or the new, stale one
+        array_field_index& u_create_field_index(const char* path) {
+            if (auto index = u_field_index(path)) {
+                return *index;
+            }
+            if (!_indexes) {
+                _indexes.reset(new array_field_indexes());
+            }
+            _indexes->emplace_back(path);
+            return _indexes->back();
+        }
+
         container_type container_copy() const {
             object_lock g(this);
-            return _array;
+            if (!_packed.is_packed()) {
+                return _array;
+            }
+
+            container_type copy;
+            copy.reserve(_packed.size());
+            for (size_t i = 0, count = _packed.size(); i < count; ++i) {
+                copy.push_back(_packed.at(i));
+            }
+            return copy;
         }
 
         template<class T> void push(T&& item) {
@@ -150,20 +276,187 @@ namespace collections {
             u_push(std::forward<T>(item));
         }
 
-        template<class T> void u_push(T&& item) {
-            _array.emplace_back(std::forward<T>(item));
+        template<class T> void u_push(T&& value) {
+            u_insert(u_count(), item(std::forward<T>(value)));
+        }
+
+        void u_insert(size_t index, item&& itm) {
+            const size_t count = u_count();
+            _update_indexes([=](array_field_index& fieldIndex) { fieldIndex.u_inserted(index, 1, count); });
+            if (_store_packed(itm)) {
+                _packed.insert(index, itm);
+            }
+            else {
+                _array.insert(_array.begin() + index, std::move(itm));
+            }
+        }
+
+        // inserts [first, last) range of the @source items at @index. The @source must not be this array
+        void u_insert(size_t index, const array& source, size_t first, size_t last) {
+            const size_t count = u_count();
+            _update_indexes([=](array_field_index& fieldIndex) { fieldIndex.u_inserted(index, last - first, count); });
+            if (source._packed.is_packed()) {
+                if (u_count() == 0) {
+                    _start_packing(source._packed.kind());
+                }
+                if (_packed.kind() == source._packed.kind()) {
+                    _packed.append(source._packed, first, last, index);
+                    return;
+                }
+                _promote();
+                for (size_t i = first; i < last; ++i) {
+                    _array.insert(_array.begin() + index + (i - first), source._packed.at(i));
+                }
+            }
+            else {
+                _promote();
+                _array.insert(_array.begin() + index, source._array.begin() + first, source._array.begin() + last);
+                if (index == 0 && _array.size() == last - first) {
+                    u_try_pack();
+                }
+            }
+        }
+
+        // replaces the item at @index, the index must be valid
+        void u_replace(size_t index, item&& itm) {
+            _update_indexes([=](array_field_index& fieldIndex) { fieldIndex.u_replaced(index); });
+            if (_packed.accepts(itm)) {
+                _packed.set(index, itm);
+            }
+            else {
+                _promote();
+                _array[index] = std::move(itm);
+            }
+        }
+
+        // the copy of the item at @index, the index must be valid. Doesn't promote the contents
+        item u_item_at(size_t index) const {
+            return _packed.is_packed() ? _packed.at(index) : _array[index];
+        }
+
+        item_type u_type_at(size_t index) const {
+            return _packed.is_packed() ? _packed.kind() : _array[index].type();
+        }
+
+        void u_erase(size_t first, size_t last) {
+            const size_t count = u_count();
+            _update_indexes([=](array_field_index& fieldIndex) { fieldIndex.u_erased(first, last, count); });
+            if (_packed.is_packed()) {
+                _packed.erase(first, last);
+            }
+            else {
+                _array.erase(_array.begin() + first, _array.begin() + last);
+            }
+        }
+
+        void u_swap_items(size_t first, size_t second) {
+            _reset_indexes();
+            if (_packed.is_packed()) {
+                _packed.visit([first, second](auto& v) { std::swap(v[first], v[second]); });
+            }
+            else {
+                std::swap(_array[first], _array[second]);
+            }
+        }
+
+        // the new items are None, so growing promotes the contents
+        void u_resize(size_t count) {
+            const size_t oldCount = u_count();
+            if (count < oldCount) {
+                _update_indexes([=](array_field_index& index) { index.u_erased(count, oldCount, oldCount); });
+            }
+            if (_packed.is_packed() && count <= _packed.size()) {
+                _packed.shrink(count);
+            }
+            else {
+                _promote();
+                _array.resize(count);
+            }
+        }
+
+        void u_reserve(size_t count) {
+            if (_packed.is_packed()) {
+                _packed.reserve(count);
+            }
+            else {
+                _array.reserve(count);
+            }
+        }
+
+        // makes the contents a copy of the @source contents
+        void u_assign(const array& source) {
+            _reset_indexes();
+            _array = source._array;
+            _packed = source._packed;
+        }
+
+        // the index of the first item equal to @itm within [first, count) range or -1
+        int32_t u_find(const item& itm, size_t first) const {
+            if (_packed.is_packed()) {
+                return _packed.find(itm, first, _packed.size());
+            }
+            auto itr = std::find(_array.begin() + first, _array.end(), itm);
+            return itr != _array.end() ? static_cast<int32_t>(itr - _array.begin()) : -1;
+        }
+
+        // the index of the last item equal to @itm within [0, last] range or -1
+        int32_t u_rfind(const item& itm, size_t last) const {
+            if (_packed.is_packed()) {
+                return _packed.rfind(itm, 0, last + 1);
+            }
+            for (size_t i = last + 1; i-- > 0;) {
+                if (_array[i] == itm) {
+                    return static_cast<int32_t>(i);
+                }
+            }
+            return -1;
+        }
+
+        size_t u_count_equal(const item& itm) const {
+            if (_packed.is_packed()) {
+                return _packed.count(itm);
+            }
+            return static_cast<size_t>(std::count(_array.begin(), _array.end(), itm));
+        }
+
+        // erases all the items equal to @itm, returns the number of erased items
+        size_t u_erase_equal(const item& itm) {
+            _reset_indexes();
+            if (_packed.is_packed()) {
+                return _packed.erase_equal(itm);
+            }
+            auto newEnd = std::remove(_array.begin(), _array.end(), itm);
+            const size_t erased = _array.end() - newEnd;
+            _array.erase(newEnd, _array.end());
+            return erased;
+        }
+
+        // sort, unique and reverse work on the packed values directly
+        template<class F>
+        void u_apply(F&& func) {
+            _reset_indexes();
+            if (_packed.is_packed()) {
+                _packed.visit(func);
+            }
+            else {
+                func(_array);
+            }
         }
 
         void u_clear() override {
+            const size_t count = u_count();
+            _update_indexes([=](array_field_index& index) { index.u_erased(0, count, count); });
             _array.clear();
+            _packed.clear();
         }
 
         SInt32 u_count() const override {
-            return _array.size();
+            return static_cast<SInt32>(_packed.is_packed() ? _packed.size() : _array.size());
         }
 
         void u_nullifyObjects() override;
 
+        // packed contents never reference objects
         void u_visit_referenced_objects(const std::function<void(object_base&)>& visitor) override {
             for (auto& item : _array) {
                 if (auto obj = item.object()) {
@@ -172,36 +465,85 @@ namespace collections {
             }
         }
 
+        size_t u_visit_referenced_objects_part(size_t from, size_t count, const std::function<void(object_base&)>& visitor) override {
+            const size_t size = _array.size();
+            for (size_t i = from, last = from + (std::min)(count, size); i < last && i < size; ++i) {
+                if (auto obj = _array[i].object()) {
+                    visitor(*obj);
+                }
+            }
+            return size;
+        }
+
         //////////////////////////////////////////////////////////////////////////
 
         boost::optional<int32_t> u_convertIndex(int32_t pyIndex) const {
-            int32_t count = (int32_t)_array.size();
+            int32_t count = u_count();
             int32_t index = (pyIndex >= 0 ? pyIndex : (count + pyIndex));
             return{ index >= 0 && index < count, index };
         }
 
-        const item* u_get(int32_t index) const {
+        // the item at @index or null. Doesn't change the array: a packed value gets copied into the @scratch
+        const item* u_get(int32_t index, item& scratch) const {
             auto idx = u_convertIndex(index);
-            return idx ? &_array[*idx] : nullptr;
+            if (!idx) {
+                return nullptr;
+            }
+            if (_packed.is_packed()) {
+                scratch = _packed.at(*idx);
+                return &scratch;
+            }
+            return &_array[*idx];
         }
 
+        // promotes the contents, the item may get changed through the pointer
         item* u_get(int32_t index) {
-            return const_cast<item*>( const_cast<const array*>(this)->u_get(index) );
+            auto idx = u_convertIndex(index);
+            if (!idx) {
+                return nullptr;
+            }
+            _promote();
+            _update_indexes([=](array_field_index& fieldIndex) { fieldIndex.u_replaced(*idx); });
+            return &_array[*idx];
+        }
+
+        // calls @func with the item at @index, which the function may change. False if there is no such item.
+        // A packed value gets copied and stored back if changed, the contents stay packed if the new value fits them
+        template<class F>
+        bool u_modify(int32_t index, F&& func) {
+            auto idx = u_convertIndex(index);
+            if (!idx) {
+                return false;
+            }
+            if (_packed.is_packed()) {
+                item value = _packed.at(*idx);
+                func(value);
+                if (!(value == _packed.at(*idx))) {
+                    u_replace(*idx, std::move(value));
+                }
+                return true;
+            }
+            _update_indexes([=](array_field_index& fieldIndex) { fieldIndex.u_replaced(*idx); });
+            func(_array[*idx]);
+            return true;
         }
 
         bool u_erase(int32_t index) {
             auto idx = u_convertIndex(index);
             if (idx) {
-                _array.erase(_array.begin() + *idx);
+                u_erase(*idx, *idx + 1);
                 return true;
             }
             return false;
         }
 
+        // promotes the contents
         template<class T>
         item* u_set(int32_t index, T&& itm) {
             auto idx = u_convertIndex(index);
             if (idx) {
+                _promote();
+                _update_indexes([=](array_field_index& fieldIndex) { fieldIndex.u_replaced(*idx); });
                 return &(_array[*idx] = std::forward<T>(itm));
             }
             return nullptr;
@@ -210,7 +552,10 @@ namespace collections {
         template<class T>
         void set(int32_t index, T&& itm) {
             object_lock g(this);
-            u_set(index, std::forward<T>(itm));
+            auto idx = u_convertIndex(index);
+            if (idx) {
+                u_replace(*idx, item(std::forward<T>(itm)));
+            }
         }
 
         template<class T>
@@ -218,29 +563,38 @@ namespace collections {
             return t ? boost::optional<T>(*t) : boost::none;
         }
 
-        item& operator [] (int32_t index) { return const_cast<item&>(const_cast<const array*>(this)->operator[](index)); }
-        const item& operator [] (int32_t index) const {
+        // promotes the contents
+        item& operator [] (int32_t index) { return *u_get(index); }
+        // the copy of the item, doesn't promote the contents
+        item operator [] (int32_t index) const {
             auto idx = u_convertIndex(index);
             assert(idx);
-            return _array[*idx];
+            return u_item_at(*idx);
         }
 
         boost::optional<item> get_item(int32_t index) const {
-            object_lock lock(this);
-            return _opt_from_pointer(u_get(index));
+            object_read_lock g(this);
+            auto idx = u_convertIndex(index);
+            return idx ? u_item_at(*idx) : boost::optional<item>();
         }
 
-        iterator begin() { return _array.begin();}
-        iterator end() { return _array.end(); }
+        // the iterators promote the contents
+        iterator begin() { return u_container().begin();}
+        iterator end() { return u_container().end(); }
 
-        reverse_iterator rbegin() { return _array.rbegin();}
-        reverse_iterator rend() { return _array.rend(); }
+        reverse_iterator rbegin() { return u_container().rbegin();}
+        reverse_iterator rend() { return u_container().rend(); }
 
 
         //////////////////////////////////////////////////////////////////////////
 
+        friend class boost::serialization::access;
+        BOOST_SERIALIZATION_SPLIT_MEMBER();
+
+        template<class Archive>
+        void save(Archive & ar, const unsigned int version) const;
         template<class Archive>
-        void serialize(Archive & ar, const unsigned int version);
+        void load(Archive & ar, const unsigned int version);
     };
 
     template<class RealType, class ContainerType>
@@ -254,40 +608,54 @@ namespace collections {
     protected:
         ContainerType cnt;
 
+        // changes whenever the set of keys may have changed, the iteration cursors rely on it
+        uint32_t _version = 0;
+
+        void _keys_changed() { ++_version; }
+
         template<class ContainerType>
         static util::choose_iterator<ContainerType> _find(ContainerType& c, const key_type& k) { return c.find(k); }
 
     public:
 
+        uint32_t u_version() const { return _version; }
+
         const container_type& u_container() const {
             return cnt;
         }
 
+        // the caller may add or remove the pairs
         container_type& u_container() {
+            _keys_changed();
             return cnt;
         }
 
         container_type container_copy() const {
-            object_lock g(this);
+            object_read_lock g(this);
             return cnt;
         }
 
         template<class Key>
         item findOrDef(const Key& key) const {
-            object_lock g(this);
+            object_read_lock g(this);
             auto result = u_get(key);
             return result ? *result : item();
         }
 
         template<class Key>
         boost::optional<item> get_item(const Key& key) const {
-            object_lock g(this);
+            object_read_lock g(this);
             auto result = u_get(key);
             return result ? *result : boost::optional<item>();
         }
 
         item& u_get_or_create(const key_type& key) {
-            return cnt[key];
+            const size_t count = cnt.size();
+            item& itm = cnt[key];
+            if (cnt.size() != count) {
+                _keys_changed();
+            }
+            return itm;
         }
 
         template<class Key>
@@ -313,15 +681,21 @@ namespace collections {
         template<class Key>
         bool u_erase(const Key& key) {
             typename container_type::iterator itr = RealType::_find(cnt, key);
-            return itr != cnt.end() ? (cnt.erase(itr), true) : false;
+            if (itr == cnt.end()) {
+                return false;
+            }
+            cnt.erase(itr);
+            _keys_changed();
+            return true;
         }
 
         void u_clear() override {
             cnt.clear();
+            _keys_changed();
         }
 
         template<class T, class Key> item* u_set(const Key& key, T&& value) {
-            return &(cnt[key] = std::forward<T>(value));
+            return &(static_cast<RealType*>(this)->u_get_or_create(key) = std::forward<T>(value));
         }
 
         template<class T, class Key> void set(const Key& key, T&& value) {
@@ -346,65 +720,169 @@ namespace collections {
         }
         
         void u_visit_referenced_objects(const std::function<void(object_base&)>& visitor) override {
-            for (auto& pair : u_container()) {
+            for (auto& pair : cnt) {
                 if (auto obj = pair.second.object()) {
                     visitor(*obj);
                 }
             }
         }
 
+        // the positions are the storage positions of the container, which don't move while the keys don't change
+        size_t u_visit_referenced_objects_part(size_t from, size_t count, const std::function<void(object_base&)>& visitor) override {
+            const size_t size = cnt.storage_size();
+            cnt.for_each_stored(from, from + (std::min)(count, size), [&visitor](const value_type& pair) {
+                if (auto obj = pair.second.object()) {
+                    visitor(*obj);
+                }
+            });
+            return size;
+        }
+
         void u_nullifyObjects() override {
-            for (auto& pair : u_container()) {
+            for (auto& pair : cnt) {
                 pair.second.u_nullifyObject();
             }
         }
     };
 
-    struct map_case_insensitive_comp {
-        bool operator() (const std::string& lhs, const std::string& rhs) const {
-            return _stricmp(lhs.c_str(), rhs.c_str()) < 0;
+    // Case-insensitive key hashing and equality. The hashes of the interned keys are precomputed
+    struct map_key_traits {
+        static uint32_t hash(const util::shared_string& key) { return key.ihash(); }
+        static uint32_t hash(const char* key) { return util::case_folded_hash(key, strlen(key)); }
+
+        static bool equal(const util::shared_string& stored, const util::shared_string& key) {
+            return stored.iequals(key);
+        }
+        static bool equal(const util::shared_string& stored, const char* key) {
+            return _stricmp(stored.c_str(), key) == 0;
         }
     };
 
-
-    class map : public basic_map_collection< map, std::map<std::string, item, map_case_insensitive_comp > >
+    // The keys are interned in the context's string pool.
+    // The pairs are iterated in the order the keys were inserted
+    class map : public basic_map_collection< map, util::ordered_hash_map<util::shared_string, item, map_key_traits > >
     {
+        using base = basic_map_collection< map, util::ordered_hash_map<util::shared_string, item, map_key_traits > >;
+
     public:
         enum  {
             TypeId = CollectionType::Map,
         };
 
+        // the keys are looked up with plain strings
+        using key_type = std::string;
+
+        using base::_find;
+        using base::u_get_or_create;
+
+        template<class ContainerType>
+        static util::choose_iterator<ContainerType> _find(ContainerType& c, const char* k) { return c.find(k); }
+
+        template<class ContainerType>
+        static util::choose_iterator<ContainerType> _find(ContainerType& c, const std::string& k) { return c.find(k.c_str()); }
+
+        item& u_get_or_create(const char* key);
+        item& u_get_or_create(const std::string& key) { return u_get_or_create(key.c_str()); }
+
         //////////////////////////////////////////////////////////////////////////
 
+        friend class boost::serialization::access;
+        BOOST_SERIALIZATION_SPLIT_MEMBER();
+
         template<class Archive>
-        void serialize(Archive & ar, const unsigned int version);
+        void save(Archive & ar, const unsigned int version) const;
+        template<class Archive>
+        void load(Archive & ar, const unsigned int version);
+    };
+
+    // The keys are hashed by raw FormId, the hash is stored in the table slot next to the entry index,
+    // so the form_entry gets dereferenced only when the FormIds match.
+    // A key matches if both the FormId and the expired state are equal - same as with former stable_less_comparer
+    struct form_map_key_traits {
+        template<class FormRef>
+        static uint32_t hash(const FormRef& key) {
+            return util::to_integral(key.get_raw());
+        }
+
+        template<class FormRef>
+        static bool equal(const form_ref& stored, const FormRef& key) {
+            return stored.get_raw() == key.get_raw() && stored.is_expired() == key.is_expired();
+        }
     };
 
-    class form_map : public basic_map_collection< form_map, std::map<form_ref, item, form_ref::stable_less_comparer> >
+    class form_map : public basic_map_collection< form_map, util::ordered_hash_map<form_ref, item, form_map_key_traits> >
     {
     private:
-        using base = basic_map_collection< form_map, std::map<form_ref, item, form_ref::stable_less_comparer> >;
+        using base = basic_map_collection< form_map, util::ordered_hash_map<form_ref, item, form_map_key_traits> >;
+
+        // looks up the key of an expired form with given id
+        struct expired_key {
+            FormId id;
+            FormId get_raw() const { return id; }
+            bool is_expired() const { return true; }
+        };
+
+        // the size at which the expired entries get swept out
+        size_t _purge_threshold = 0;
+
+        // Expired entries are purged lazily:
+        // - a new form which reuses the FormId of an expired one takes its entry over
+        // - the expired entries are swept out each time the map doubles its size
+        template<class Key>
+        item& _get_or_create(const Key& key) {
+            auto itr = cnt.find(key);
+            if (itr != cnt.end()) {
+                return itr->second;
+            }
+
+            if (key.is_not_expired()) {
+                itr = cnt.find(expired_key{ key.get_raw() });
+                if (itr != cnt.end()) {
+                    itr->first = _make_key(key);
+                    itr->second = item();
+                    _keys_changed();
+                    return itr->second;
+                }
+            }
+
+            if (cnt.size() >= _purge_threshold) {
+                u_purge_expired();
+                _purge_threshold = (std::max)(cnt.size() * 2, size_t(16));
+            }
+
+            _keys_changed();
+            return cnt.find_or_emplace(key, [this, &key]() { return _make_key(key); }).first->second;
+        }
+
+        static form_ref _make_key(const form_ref& key) { return key; }
+        static form_ref _make_key(const form_ref_lightweight& key) { return key.to_form_ref(); }
 
     public:
 
         // form_ref_lightweight support
 
         using base::_find;
-        using base::u_get_or_create;
 
         template<class ContainerType>
         static util::choose_iterator<ContainerType> _find(ContainerType& c, const form_ref_lightweight& k) {
-            auto comparer = c.key_comp();
-            auto itr = std::lower_bound(c.begin(), c.end(), k,
-                [comparer](const form_map::value_type& pair, const form_ref_lightweight& k) {
-                    return comparer(pair.first, k);
-                }
-            );
-            return itr != c.end() && itr->first == k ? itr : c.end();
+            return c.find(k);
+        }
+
+        item& u_get_or_create(const form_ref& key) {
+            return _get_or_create(key);
         }
 
         item& u_get_or_create(const form_ref_lightweight& key) {
-            return cnt[key.to_form_ref()];
+            return _get_or_create(key);
+        }
+
+        // erases the pairs whose keys have expired, returns the number of erased pairs
+        size_t u_purge_expired() {
+            const size_t erased = cnt.erase_if([](const value_type& pair) { return pair.first.is_expired(); });
+            if (erased != 0) {
+                _keys_changed();
+            }
+            return erased;
         }
 
     public:
@@ -425,14 +903,20 @@ namespace collections {
         void save(Archive & ar, const unsigned int version) const;
     };
 
-    class integer_map : public basic_map_collection < integer_map, std::map<int32_t, item> >
+    // Flat storage sorted by key, with O(1) lookup while the keys are dense
+    class integer_map : public basic_map_collection < integer_map, util::adaptive_int_map<item> >
     {
     public:
         enum  {
             TypeId = CollectionType::IntegerMap,
         };
 
+        friend class boost::serialization::access;
+        BOOST_SERIALIZATION_SPLIT_MEMBER();
+
         template<class Archive>
-        void serialize(Archive & ar, const unsigned int version);
+        void save(Archive & ar, const unsigned int version) const;
+        template<class Archive>
+        void load(Archive & ar, const unsigned int version);
     };
 }
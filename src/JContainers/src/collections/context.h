@@ -1,14 +1,17 @@
 #pragma once
 
+#include <cstring>
 #include <memory>
 
 #include "meta.h"
 #include "util/spinlock.h"
+#include "util/shared_string.h"
 #include "object/object_base.h"
 #include "object/object_context.h"
 
 #include "forms/form_observer.h"
 #include "collections/collections.h"
+#include "collections/map_cursors.h"
 
 namespace collections
 {
@@ -68,6 +71,28 @@ namespace collections
 
         forms::form_observer& _form_watcher;
 
+        // interns map keys and long string values
+        util::string_pool _string_pool;
+
+        // the item holding the value a script passes. The long strings get interned,
+        // so that the equal values share the memory
+        template<class T>
+        item make_item(T&& value) {
+            item itm;
+            itm = std::forward<T>(value);
+            return itm;
+        }
+
+        item make_item(const char* str) {
+            const size_t length = str ? strlen(str) : 0;
+            return length > item::short_string_capacity
+                ? item(_string_pool.intern(str, length))
+                : item(str);
+        }
+
+        // the script-level map iteration cursors
+        map_cursors _map_cursors;
+
         //////
     public:
 
@@ -93,6 +118,7 @@ namespace collections
         void u_clearState() {
             _root_object_id.store(Handle::Null, std::memory_order_relaxed);
             _cached_root = nullptr;
+            _map_cursors.u_clear();
             //_form_watcher.u_clearState();
 
             base::u_clearState();
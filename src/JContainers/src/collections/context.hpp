@@ -153,6 +153,10 @@ namespace collections {
 
     void tes_context::u_print_stats() const {
         base::u_print_stats();
+
+        auto strings = _string_pool.u_statistics();
+        JC_log("Interned strings: %zu, %zu bytes. Bytes saved by interning: %zu",
+            strings.strings, strings.bytes, strings.bytes_saved);
     }
 
     void tes_context::read_from_string(const std::string & data) {
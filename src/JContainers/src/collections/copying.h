@@ -27,6 +27,15 @@ namespace collections {
                 },
                     *_context);
             }
+
+            // keeps packed contents packed
+            object_base& operator () (const array& origin) const {
+                return array::objectWithInitializer([&](array& self) {
+                    object_lock lock(origin);
+                    self.u_assign(origin);
+                },
+                    *_context);
+            }
         };
 
     public:
@@ -75,6 +84,9 @@ namespace collections {
             copying *const self;
             void operator () (array& ar) {
                 object_lock lock(ar);
+                if (ar.u_packing() != item_type::none) {
+                    return; // packed values are never objects
+                }
                 for (auto& itm : ar.u_container()) {
                     copy_child(itm);
                 }
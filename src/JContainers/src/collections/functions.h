@@ -1,9 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <vector>
 #include <boost/optional.hpp>
 
 #include "collections/collections.h"
+#include "collections/access.h"
 
 namespace collections {
 
@@ -33,7 +36,7 @@ namespace collections {
         }
 
         template<class Index, size_t N>
-        static boost::optional<std::array<uint32_t, N> > convertReadIndex(array *ar, const Index(&pyIndexes)[N]) {
+        static boost::optional<std::array<uint32_t, N> > convertReadIndex(const array *ar, const Index(&pyIndexes)[N]) {
             auto count = ar->u_count();
 
             if (count == 0) {
@@ -52,8 +55,37 @@ namespace collections {
             return indexes;
         }
 
+        // The operation runs under the shared lock, so it must only read the items at the existing indexes
+        // and must not promote the packed contents (u_item_at, u_type_at, u_find are fine, u_container is not)
         template<class Op>
-        static void doReadOp(array * obj, index pyIndex, Op& operation) {
+        static void doReadOp(const array * obj, index pyIndex, Op& operation) {
+            if (!obj) {
+                return;
+            }
+
+            object_read_lock g(obj);
+            auto idx = convertReadIndex(obj, pyIndex);
+            if (idx) {
+                operation(*idx);
+            }
+        }
+
+        template<class Op, class Index, size_t N>
+        static void doReadOp(const array * obj, const Index(&pyIndex)[N], Op& operation) {
+            if (!obj) {
+                return;
+            }
+
+            object_read_lock g(obj);
+            auto idx = convertReadIndex(obj, pyIndex);
+            if (idx) {
+                operation(*idx);
+            }
+        }
+
+        // modifies the items at the existing indexes
+        template<class Op>
+        static void doUpdateOp(array * obj, index pyIndex, Op& operation) {
             if (!obj) {
                 return;
             }
@@ -66,7 +98,7 @@ namespace collections {
         }
 
         template<class Op, class Index, size_t N>
-        static void doReadOp(array * obj, const Index(&pyIndex)[N], Op& operation) {
+        static void doUpdateOp(array * obj, const Index(&pyIndex)[N], Op& operation) {
             if (!obj) {
                 return;
             }
@@ -90,6 +122,171 @@ namespace collections {
                 operation(*idx);
             }
         }
+
+        enum { index_refresh_attempts = 3 };
+
+        // Reads the values the index at @path waits for: the values of the pending items or, if the index is stale,
+        // of all the items. The items get locked one by one while the array is unlocked (see object_lock_chain),
+        // then the index takes the values unless the array has changed meanwhile.
+        // False if there is no such index or if the array keeps changing
+        static bool refresh_index(tes_context& context, array& obj, const char *path) {
+            for (int attempt = 0; attempt < index_refresh_attempts; ++attempt) {
+                std::vector<uint32_t> positions;
+                std::vector<object_stack_ref> items;
+                uint32_t generation = 0;
+                {
+                    object_read_lock g(&obj);
+                    const array_field_index *index = obj.u_field_index(path);
+                    if (!index) {
+                        return false;
+                    }
+                    if (index->u_is_current()) {
+                        return true;
+                    }
+                    generation = index->u_generation();
+                    if (index->u_is_stale()) {
+                        positions.resize(obj.u_count());
+                        for (uint32_t i = 0; i < positions.size(); ++i) {
+                            positions[i] = i;
+                        }
+                    }
+                    else {
+                        positions = index->u_pending();
+                        std::sort(positions.begin(), positions.end());
+                        positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+                    }
+                    items.reserve(positions.size());
+                    for (uint32_t position : positions) {
+                        items.emplace_back(obj.u_item_at(position).object());
+                    }
+                }
+
+                std::vector<item> values(positions.size());
+                for (size_t i = 0; i < items.size(); ++i) {
+                    if (items[i]) {
+                        path_resolving::resolve(context, items[i].get(), path, [&](item *itm) {
+                            if (itm) {
+                                values[i] = *itm;
+                            }
+                        });
+                    }
+                }
+
+                object_lock g(&obj);
+                array_field_index *index = obj.u_field_index(path);
+                if (!index) {
+                    return false;
+                }
+                if (index->u_generation() == generation) {
+                    index->u_update(positions, values);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // creates the index of the array items by their values at @path (see array_field_index) or rebuilds the existing one
+        static void create_index(tes_context& context, array& obj, const char *path) {
+            {
+                object_lock g(&obj);
+                obj.u_create_field_index(path).u_reset();
+            }
+            refresh_index(context, obj, path);
+        }
+
+        // The position of the first item whose value at @path equals the @value, or -1. The index at @path gives
+        // the candidates, without the index (or if the array keeps changing) all the items are the candidates.
+        // The candidates get checked, as the index doesn't know about the changes of the items themselves.
+        // For the same reason a miss of the index is not trusted: all the other items get checked then.
+        // The items found to have changed get refreshed in the index by the next lookup.
+        // An item which got the @value after the indexing may be skipped for a later one the index knows
+        static int32_t find_by_index(tes_context& context, array& obj, const char *path, const item& value) {
+            std::vector<std::pair<uint32_t, object_stack_ref>> candidates;
+            bool indexed = false;
+
+            for (int attempt = 0; !indexed && attempt < index_refresh_attempts && refresh_index(context, obj, path); ++attempt) {
+                object_read_lock g(&obj);
+                const array_field_index *index = obj.u_field_index(path);
+                if (index && index->u_is_current()) {
+                    index->u_find(value, [&](uint32_t position) {
+                        candidates.emplace_back(position, obj.u_item_at(position).object());
+                    });
+                    indexed = true;
+                }
+            }
+
+            auto collect_all = [&obj](std::vector<std::pair<uint32_t, object_stack_ref>>& items, const auto& skipped) {
+                object_read_lock g(&obj);
+                for (uint32_t i = 0, count = obj.u_count(); i < count; ++i) {
+                    auto itemObj = obj.u_item_at(i).object();
+                    if (itemObj && !std::binary_search(skipped.begin(), skipped.end(), i)) {
+                        items.emplace_back(i, itemObj);
+                    }
+                }
+            };
+
+            if (!indexed) {
+                collect_all(candidates, std::vector<uint32_t>());
+            }
+
+            std::sort(candidates.begin(), candidates.end(),
+                [](const auto& left, const auto& right) { return left.first < right.first; });
+
+            auto matches = [&](object_base *itemObj) {
+                bool equal = false;
+                path_resolving::resolve(context, itemObj, path, [&](item *itm) {
+                    equal = itm && itm->isEqual(value);
+                });
+                return equal;
+            };
+
+            // the items whose values differ from the ones the index has
+            std::vector<std::pair<uint32_t, object_base*>> changed;
+            int32_t found = -1;
+
+            for (auto& candidate : candidates) {
+                if (matches(candidate.second.get())) {
+                    found = static_cast<int32_t>(candidate.first);
+                    break;
+                }
+                changed.emplace_back(candidate.first, candidate.second.get());
+            }
+
+            if (!indexed) {
+                return found;
+            }
+
+            if (found == -1) {
+                std::vector<uint32_t> checked;
+                checked.reserve(candidates.size());
+                for (auto& candidate : candidates) {
+                    checked.push_back(candidate.first);
+                }
+
+                std::vector<std::pair<uint32_t, object_stack_ref>> rest;
+                collect_all(rest, checked);
+                for (auto& other : rest) {
+                    if (matches(other.second.get())) {
+                        found = static_cast<int32_t>(other.first);
+                        changed.emplace_back(other.first, other.second.get());
+                        break;
+                    }
+                }
+            }
+
+            if (!changed.empty()) {
+                object_lock g(&obj);
+                if (array_field_index *index = obj.u_field_index(path)) {
+                    for (auto& entry : changed) {
+                        // unless the array has changed meanwhile
+                        if (entry.first < obj.u_count() && obj.u_item_at(entry.first).object() == entry.second) {
+                            index->u_replaced(entry.first);
+                        }
+                    }
+                }
+            }
+            return found;
+        }
     };
 
     //template<class T>
@@ -109,10 +306,11 @@ namespace collections {
         using key_checker = map_key_checker/*<T>*/;
         ///typedef typename T::key_type key_type;
 
+        // The read operations run under the shared lock, so they must not modify the item
         template<class Op, class R,/* class RAlter, */class key_type>
         static R doReadOpR(T * obj, const key_type& key, R default, Op& operation) {
             if (obj && key_checker::check(key)) {
-                object_lock g(obj);
+                object_read_lock g(obj);
                 item *itm = obj->u_get(key);
                 return itm ? operation(*itm) : default;
             }
@@ -124,7 +322,7 @@ namespace collections {
         template<class Op, class key_type>
         static void doReadOp(T * obj, const key_type& key, Op& operation) {
             if (obj && key_checker::check(key)) {
-                object_lock g(obj);
+                object_read_lock g(obj);
                 item *itm = obj->u_get(key);
                 if (itm) {
                     operation(*itm);
@@ -145,7 +343,7 @@ namespace collections {
         template<class KeyFunc, class KeyTypeIn>
         static void nextKey(const T *obj, const KeyTypeIn& lastKey, KeyFunc keyFunc) {
             if (obj) {
-                object_lock g(obj);
+                object_read_lock g(obj);
                 auto& container = obj->u_container();
                 if (key_checker::check(lastKey)) {
                     auto itr = container.find(lastKey);
@@ -172,7 +370,7 @@ namespace collections {
             const KeyTypeIn& endKey, const KeyComparer key_equality = equal_to{})
         {
             if (obj) {
-                object_lock g(obj);
+                object_read_lock g(obj);
                 auto& container = obj->u_container();
 
                 if (container.empty()) {
@@ -209,22 +407,82 @@ namespace collections {
             return endKey;
         }
 
+        // Assigns @values[i] to @keys[i] for each pair, under a single lock. The invalid keys are skipped
+        template<class KeyTypeIn>
+        static void setMany(T *obj, const std::vector<KeyTypeIn>& keys, std::vector<item>&& values) {
+            if (!obj) {
+                return;
+            }
+
+            const size_t count = (std::min)(keys.size(), values.size());
+            object_lock g(obj);
+            obj->u_container().reserve(obj->u_container().size() + count);
+            for (size_t i = 0; i < count; ++i) {
+                if (key_checker::check(keys[i])) {
+                    obj->u_get_or_create(keys[i]) = std::move(values[i]);
+                }
+            }
+        }
+
+        // Copies the values associated with the @keys into @values, under a single lock.
+        // The missing keys produce empty optionals
+        template<class KeyTypeIn>
+        static void getMany(const T *obj, const std::vector<KeyTypeIn>& keys, std::vector<boost::optional<item>>& values) {
+            values.clear();
+            values.resize(keys.size());
+            if (!obj) {
+                return;
+            }
+
+            object_read_lock g(obj);
+            for (size_t i = 0; i < keys.size(); ++i) {
+                if (key_checker::check(keys[i])) {
+                    if (const item* itm = obj->u_get(keys[i])) {
+                        values[i] = *itm;
+                    }
+                }
+            }
+        }
+
+        // The pairs are stored in flat vectors, so the n-th one is accessed directly: O(1),
+        // but O(log n) for the hashed maps while the removed pairs leave holes in the vector
         template<class KeyFunc>
         static void getNthKey(const T *obj, int32_t keyIdx, KeyFunc keyFunc) {
             if (obj) {
-                object_lock g(obj);
+                object_read_lock g(obj);
                 auto idx = array_functions::convertReadIndex(obj, keyIdx);
-                if (idx) {
-                    int32_t count = obj->u_count();
-                    if (*idx < count / 2) {
-                        auto itr = obj->u_container().begin();
-                        for (int32_t i = 0, dest = *idx; i != dest; ++i, ++itr) {}
-                        keyFunc(itr->first);
-                    }
-                    else {
-                        auto itr = obj->u_container().rbegin();
-                        for (int32_t i = (count - 1), dest = *idx; i != dest; --i, ++itr) {}
-                        keyFunc(itr->first);
+                if (idx && *idx >= 0) {
+                    keyFunc(obj->u_container().nth(*idx).first);
+                }
+            }
+        }
+
+        // the position of the @key in the iteration order or -1.
+        // O(1) for the dense integer maps and for the hashed maps without removals,
+        // O(log n) for the sparse integer maps and for the hashed maps after removals
+        template<class KeyTypeIn>
+        static int32_t indexOfKey(const T *obj, const KeyTypeIn& key) {
+            if (obj && key_checker::check(key)) {
+                object_read_lock g(obj);
+                const auto& container = obj->u_container();
+                const size_t idx = container.index_of(key);
+                return idx != container.npos ? static_cast<int32_t>(idx) : -1;
+            }
+            return -1;
+        }
+
+        // calls @keyFunc with each of the @count keys starting from the position @start.
+        // The range gets clipped to the existing keys
+        template<class KeyFunc>
+        static void keysInRange(const T *obj, int32_t start, int32_t count, KeyFunc keyFunc) {
+            if (obj && count > 0) {
+                object_read_lock g(obj);
+                auto idx = array_functions::convertReadIndex(obj, start);
+                if (idx && *idx >= 0) {
+                    const auto& container = obj->u_container();
+                    const size_t last = (std::min)(container.size(), size_t(*idx) + size_t(count));
+                    for (size_t i = *idx; i < last; ++i) {
+                        keyFunc(container.nth(i).first);
                     }
                 }
             }
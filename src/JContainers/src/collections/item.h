@@ -1,7 +1,9 @@
 #pragma once
 
 #include <boost/variant.hpp>
+#include <boost/optional.hpp>
 #include <string>
+#include <cstring>
 #include <xutility>
 #include <boost/serialization/access.hpp>
 
@@ -10,6 +12,9 @@
 #include "skse/skse.h"
 #include "skse/string.h"
 
+#include "util/cstring.h"
+#include "util/shared_string.h"
+
 #include "forms/form_id.h"
 #include "forms/form_observer.h"
 #include "collections/collections.h"
@@ -29,14 +34,54 @@ namespace collections {
 
     using ::forms::FormId;
 
+    // The pointer-like result of the item::get for the values the item doesn't store as they are
+    // (strings and forms): holds a copy of the value
+    template<class T>
+    class value_ptr {
+        boost::optional<T> _value;
+
+    public:
+        value_ptr() = default;
+        value_ptr(std::nullptr_t) {}
+        explicit value_ptr(T&& value) : _value(std::move(value)) {}
+
+        const T& operator * () const { return *_value; }
+        const T* operator -> () const { return _value.get_ptr(); }
+
+        explicit operator bool () const { return _value.is_initialized(); }
+        bool operator ! () const { return !_value; }
+    };
+
+    // 16 byte tagged union. Integers, floats, object references and strings of up to 14 characters
+    // are stored in-place. Longer strings are kept in shared, immutable blocks (copying an item
+    // shares the block). A form is kept by the pointer to its entry (see form_ref::retain_entry),
+    // since form_ref itself is 16 bytes wide
     class item {
     public:
         typedef boost::blank blank;
         typedef Float32 Real;
+
+        // the layout of the item in the archives (and in JContainers versions prior 4.1)
         typedef boost::variant<boost::blank, SInt32, Real, form_ref, internal_object_ref, std::string> variant;
 
+        enum : size_t {
+            short_string_capacity = 14, // characters, the terminating zero is not counted
+        };
+
     private:
-        variant _var;
+
+        enum class tag : uint8_t {
+            blank,
+            integer,
+            real,
+            form,
+            object,
+            short_string,
+            long_string,
+        };
+
+        alignas(8) char _data[short_string_capacity + 1];
+        tag _tag = tag::blank;
 
     private:
 
@@ -52,12 +97,8 @@ namespace collections {
         static_assert(type2index<Real>::index > type2index<SInt32>::index, "Item::type2index works incorrectly");
 
     private:
-        static_assert(std::is_same<
-            boost::variant<boost::blank, SInt32, Real, form_ref, internal_object_ref, std::string>,
-            variant
-        >::value, "update _user2variant code below");
 
-        // maps input user type to variant type:
+        // maps input user type to the type the item stores:
         template<class T> struct _user2variant { using variant_type = T; };
         template<class V> struct _variant_type { using variant_type = V; };
 
@@ -70,6 +111,7 @@ namespace collections {
 
         template<> struct _user2variant<skse::string_ref> : _variant_type<std::string>{};
         template<> struct _user2variant<char*> : _variant_type<std::string>{};
+        template<> struct _user2variant<const char*> : _variant_type<std::string>{};
         template<size_t N> struct _user2variant<char[N]> : _variant_type<std::string>{};
         template<> struct _user2variant<char[]> : _variant_type<std::string>{};
 
@@ -81,53 +123,274 @@ namespace collections {
         using user2variant_t = typename _user2variant<
             std::remove_const_t< std::remove_reference_t<T> > >::variant_type;
 
+    private:
+
+        template<class T> T& _as() { return *reinterpret_cast<T*>(_data); }
+        template<class T> const T& _as() const { return *reinterpret_cast<const T*>(_data); }
+
+        forms::form_entry* _form_entry() const { return _as<forms::form_entry*>(); }
+
+        form_ref _form() const { return form_ref::of_entry(_form_entry()); }
+
+        bool _is_string() const {
+            return _tag == tag::short_string || _tag == tag::long_string;
+        }
+
+        util::cstring _string_range() const {
+            if (_tag == tag::short_string) {
+                return boost::make_iterator_range_n(_data, strlen(_data));
+            }
+            const auto& str = _as<util::shared_string>();
+            return boost::make_iterator_range_n(str.c_str(), str.size());
+        }
+
+        void _destroy() {
+            switch (_tag) {
+            case tag::form:
+                form_ref::release_entry(_form_entry());
+                break;
+            case tag::object:
+                _as<internal_object_ref>().~internal_object_ref();
+                break;
+            case tag::long_string:
+                _as<util::shared_string>().~shared_string();
+                break;
+            default:
+                break;
+            }
+            _tag = tag::blank;
+        }
+
+        void _copy_from(const item& other) {
+            switch (other._tag) {
+            case tag::form:
+                form_ref::add_entry_ref(other._form_entry());
+                _as<forms::form_entry*>() = other._form_entry();
+                break;
+            case tag::object:
+                new (_data) internal_object_ref(other._as<internal_object_ref>());
+                break;
+            case tag::long_string:
+                new (_data) util::shared_string(other._as<util::shared_string>());
+                break;
+            default:
+                memcpy(_data, other._data, sizeof(_data));
+                break;
+            }
+            _tag = other._tag;
+        }
+
+        // takes the ownership of the @other's value. the items are bitwise movable
+        void _move_from(item& other) {
+            memcpy(this, &other, sizeof(item));
+            other._tag = tag::blank;
+        }
+
+        void _set_string(const char* str, size_t length) {
+            item tmp;
+            if (length <= short_string_capacity && !memchr(str, '\0', length)) {
+                memcpy(tmp._data, str, length);
+                tmp._data[length] = '\0';
+                tmp._tag = tag::short_string;
+            }
+            else {
+                new (tmp._data) util::shared_string(str, length);
+                tmp._tag = tag::long_string;
+            }
+            swap(tmp);
+        }
+
+        void _set_string(const util::shared_string& str) {
+            if (str.size() <= short_string_capacity) {
+                _set_string(str.c_str(), str.size());
+            }
+            else {
+                item tmp;
+                new (tmp._data) util::shared_string(str);
+                tmp._tag = tag::long_string;
+                swap(tmp);
+            }
+        }
+
+        void _set_int(SInt32 val) {
+            _destroy();
+            _as<SInt32>() = val;
+            _tag = tag::integer;
+        }
+
+        void _set_real(Real val) {
+            _destroy();
+            _as<Real>() = val;
+            _tag = tag::real;
+        }
+
+        void _set_form(const form_ref& val) {
+            item tmp;
+            tmp._as<forms::form_entry*>() = val.retain_entry();
+            tmp._tag = tag::form;
+            swap(tmp);
+        }
+
+        void _set_object(object_base* val) {
+            item tmp;
+            new (tmp._data) internal_object_ref(val);
+            tmp._tag = tag::object;
+            swap(tmp);
+        }
+
+        static const char* _c_str(const char* str) { return str; }
+        static const char* _c_str(const std::string& str) { return str.c_str(); }
+        static const char* _c_str(const skse::string_ref& str) { return str.c_str(); }
+
+        template<class T>
+        bool _equals(const T& v, std::true_type /*is string*/) const {
+            const char* str = _c_str(v);
+            return str && _is_string() && strcmp(strValue(), str) == 0;
+        }
+
+        template<class T>
+        bool _equals(const T& v, std::false_type) const {
+            auto thisV = get<T>();
+            return thisV && *thisV == v;
+        }
+
     public:
 
         void u_nullifyObject() {
-            if (auto ref = boost::get<internal_object_ref>(&_var)) {
-                ref->jc_nullify();
+            if (_tag == tag::object) {
+                _as<internal_object_ref>().jc_nullify();
             }
         }
 
         item() = default;
-        item(const item& other) = default;
-        item& operator = (const item& other) = default;
 
-        item(item&& other) : _var(std::move(other._var)) {}
+        item(const item& other) {
+            _copy_from(other);
+        }
+
+        item& operator = (const item& other) {
+            if (this != &other) {
+                item(other).swap(*this);
+            }
+            return *this;
+        }
+
+        item(item&& other) noexcept {
+            _move_from(other);
+        }
 
-        item& operator = (item&& other) {
+        item& operator = (item&& other) noexcept {
             if (this != &other) {
-                _var = std::move(other._var);
+                _destroy();
+                _move_from(other);
             }
             return *this;
         }
 
-        const variant& var() const {
-            return _var;
+        ~item() {
+            _destroy();
+        }
+
+        void swap(item& other) noexcept {
+            char tmp[sizeof(item)];
+            memcpy(tmp, this, sizeof(item));
+            memcpy(this, &other, sizeof(item));
+            memcpy(&other, tmp, sizeof(item));
         }
 
-        variant& var() {
-            return _var;
+        // Calls @visitor with the value of the item. Strings are passed as util::cstring,
+        // the null value is passed as item::blank
+        template<class Visitor>
+        auto visit(Visitor&& visitor) const -> decltype(visitor(blank())) {
+            switch (_tag) {
+            case tag::integer:
+                return visitor(_as<SInt32>());
+            case tag::real:
+                return visitor(_as<Real>());
+            case tag::form:
+                return visitor(static_cast<const form_ref&>(_form()));
+            case tag::object:
+                return visitor(_as<internal_object_ref>());
+            case tag::short_string:
+            case tag::long_string:
+                return visitor(_string_range());
+            default:
+                return visitor(blank());
+            }
         }
 
         template<class T> bool is_type() const {
-            return boost::get<T>(&_var) != nullptr;
+            return type() == type2index<user2variant_t<T>>::index;
         }
 
         item_type type() const {
-            return item_type(_var.which() + item_type::none);
+            switch (_tag) {
+            case tag::integer:      return item_type::integer;
+            case tag::real:         return item_type::real;
+            case tag::form:         return item_type::form;
+            case tag::object:       return item_type::object;
+            case tag::short_string:
+            case tag::long_string:  return item_type::string;
+            default:                return item_type::none;
+            }
+        }
+
+    private:
+        // the pointer to the value: strings and forms aren't stored as they are, a copy gets pointed to
+        template<class T> struct _pointer {
+            using type = T*;
+            using const_type = const T*;
+            static type unconst(const_type ptr) { return const_cast<type>(ptr); }
+        };
+        template<class T> struct _copy_pointer {
+            using type = value_ptr<T>;
+            using const_type = value_ptr<T>;
+            static type unconst(const_type&& ptr) { return std::move(ptr); }
+        };
+        template<> struct _pointer<std::string> : _copy_pointer<std::string>{};
+        template<> struct _pointer<form_ref> : _copy_pointer<form_ref>{};
+
+    public:
+        // the in-place values can be modified through the pointer, the copied ones can't
+        template<class T> typename _pointer<user2variant_t<T>>::type get() {
+            using pointer = _pointer<user2variant_t<T>>;
+            return pointer::unconst(static_cast<const item&>(*this)._get_ptr<user2variant_t<T>>());
+        }
+
+        template<class T> typename _pointer<user2variant_t<T>>::const_type get() const {
+            return _get_ptr<user2variant_t<T>>();
+        }
+
+    private:
+        template<class T> typename _pointer<T>::const_type _get_ptr() const {
+            return is_type<T>() ? &_as<T>() : nullptr;
+        }
+
+        template<> value_ptr<std::string> _get_ptr<std::string>() const {
+            if (!_is_string()) {
+                return nullptr;
+            }
+            auto range = _string_range();
+            return value_ptr<std::string>{ std::string(range.begin(), range.end()) };
         }
 
-        template<class T> user2variant_t<T>* get() {
-            return boost::get<user2variant_t<T>>(&_var);
+        template<> value_ptr<form_ref> _get_ptr<form_ref>() const {
+            return _tag == tag::form ? value_ptr<form_ref>{ _form() } : nullptr;
         }
 
-        template<class T> const user2variant_t<T>* get() const {
-            return boost::get<user2variant_t<T>>(&_var);
+        template<> const boost::blank* _get_ptr<boost::blank>() const {
+            static const boost::blank b;
+            return _tag == tag::blank ? &b : nullptr;
         }
 
+    public:
+
         //////////////////////////////////////////////////////////////////////////
 
+        // converts to/from the archive representation, the long strings get interned in @strings
+        variant to_variant() const;
+        static item from_variant(variant&& var, util::string_pool& strings);
+
         friend class boost::serialization::access;
         BOOST_SERIALIZATION_SPLIT_MEMBER();
 
@@ -139,18 +402,18 @@ namespace collections {
         //////////////////////////////////////////////////////////////////////////
 
 
-        explicit item(Real val) : _var(val) {}
-        explicit item(double val) : _var((Real)val) {}
-        explicit item(SInt32 val) : _var(val) {}
-        explicit item(int val) : _var((SInt32)val) {}
-        explicit item(bool val) : _var((SInt32)val) {}
-        explicit item(const form_ref& id) : _var(id) {}
-        explicit item(form_ref&& id) : _var(std::move(id)) {}
+        explicit item(Real val) { _set_real(val); }
+        explicit item(double val) { _set_real((Real)val); }
+        explicit item(SInt32 val) { _set_int(val); }
+        explicit item(int val) { _set_int((SInt32)val); }
+        explicit item(bool val) { _set_int((SInt32)val); }
+        explicit item(const form_ref& id) { _set_form(id); }
+        explicit item(form_ref&& id) { _set_form(id); }
 
-        explicit item(object_base& o) : _var(o) {}
+        explicit item(object_base& o) { _set_object(&o); }
 
-        explicit item(const std::string& val) : _var(val) {}
-        explicit item(std::string&& val) : _var(std::move(val)) {}
+        explicit item(const std::string& val) { _set_string(val.c_str(), val.size()); }
+        explicit item(const util::shared_string& val) { _set_string(val); }
 
         // the Item is none if the pointers below are zero:
         explicit item(const char * val) {
@@ -166,120 +429,126 @@ namespace collections {
             *this = val.get();
         }
 
-        item& operator = (unsigned int val) { _var = (SInt32)val; return *this; }
-        item& operator = (int val) { _var = (SInt32)val; return *this; }
-        item& operator = (bool val) { _var = (SInt32)val; return *this; }
-        item& operator = (SInt32 val) { _var = val; return *this; }
-        item& operator = (Real val) { _var = val; return *this; }
-        item& operator = (double val) { _var = (Real)val; return *this; }
-        item& operator = (const std::string& val) { _var = val; return *this; }
-        item& operator = (std::string&& val) { _var = std::move(val); return *this; }
+        item& operator = (unsigned int val) { _set_int((SInt32)val); return *this; }
+        item& operator = (int val) { _set_int((SInt32)val); return *this; }
+        item& operator = (bool val) { _set_int((SInt32)val); return *this; }
+        item& operator = (SInt32 val) { _set_int(val); return *this; }
+        item& operator = (Real val) { _set_real(val); return *this; }
+        item& operator = (double val) { _set_real((Real)val); return *this; }
+        item& operator = (const std::string& val) { _set_string(val.c_str(), val.size()); return *this; }
+        item& operator = (const util::shared_string& val) { _set_string(val); return *this; }
         item& operator = (const skse::string_ref& val) { return *this = val.c_str(); }
-        item& operator = (boost::blank) { _var = boost::blank(); return *this; }
-        item& operator = (boost::none_t) { _var = boost::blank(); return *this; }
-        item& operator = (object_base& v) { _var = &v; return *this; }
-
-        template<class T>
-        item& _assignPtr(T *ptr) {
-            if (ptr) {
-                _var = ptr;
-            }
-            else {
-                _var = blank();
-            }
-            return *this;
-        }
+        item& operator = (boost::blank) { _destroy(); return *this; }
+        item& operator = (boost::none_t) { _destroy(); return *this; }
+        item& operator = (object_base& v) { _set_object(&v); return *this; }
 
         item& operator = (const form_ref& val) {
-            _var = val;
+            _set_form(val);
             return *this;
         }
 
         item& operator = (const char *val) {
-            return _assignPtr(val);
+            if (val) {
+                _set_string(val, strlen(val));
+            }
+            else {
+                _destroy();
+            }
+            return *this;
         }
 
         item& operator = (object_base *val) {
-            return _assignPtr(val);
+            if (val) {
+                _set_object(val);
+            }
+            else {
+                _destroy();
+            }
+            return *this;
         }
 
         object_base *object() const {
-            if (auto ref = boost::get<internal_object_ref>(&_var)) {
-                return ref->get();
-            }
-            return nullptr;
+            return _tag == tag::object ? _as<internal_object_ref>().get() : nullptr;
         }
 
         Real fltValue() const {
-            if (auto val = boost::get<item::Real>(&_var)) {
-                return *val;
+            if (_tag == tag::real) {
+                return _as<Real>();
             }
-            else if (auto val = boost::get<SInt32>(&_var)) {
-                return *val;
+            else if (_tag == tag::integer) {
+                return (Real)_as<SInt32>();
             }
             return 0.f;
         }
 
         SInt32 intValue() const {
-            if (auto val = boost::get<SInt32>(&_var)) {
-                return *val;
+            if (_tag == tag::integer) {
+                return _as<SInt32>();
             }
-            else if (auto val = boost::get<item::Real>(&_var)) {
-                return *val;
+            else if (_tag == tag::real) {
+                return (SInt32)_as<Real>();
             }
             // ability to read forms as integer values. likely not needed anymore
-            /*else if (auto val = boost::get<form_ref>(&_var)) {
+            /*else if (auto val = get<form_ref>()) {
                 return static_cast<SInt32>(val->get_raw());
             }*/
             return 0;
         }
 
         const char * strValue() const {
-            if (auto val = boost::get<std::string>(&_var)) {
-                return val->c_str();
+            if (_tag == tag::short_string) {
+                return _data;
+            }
+            else if (_tag == tag::long_string) {
+                return _as<util::shared_string>().c_str();
             }
             return nullptr;
         }
 
+        size_t strLength() const {
+            return _is_string() ? _string_range().size() : 0;
+        }
+
         TESForm * form() const {
             return skse::lookup_form(formId());
         }
 
         FormId formId() const {
-            if (auto val = boost::get<form_ref>(&_var)) {
-                return val->get();
+            if (_tag == tag::form) {
+                return form_ref::entry_id(_form_entry());
             }
             return FormId::Zero;
         }
 
-        class are_strict_equals : public boost::static_visitor<bool> {
-        public:
-
-            template <typename T, typename U>
-            bool operator()(const T &, const U &) const {
+        bool isEqual(const item& other) const {
+            const auto l = type();
+            if (l != other.type()) {
                 return false; // cannot compare different types
             }
 
-            template <typename T>
-            bool operator()(const T & lhs, const T & rhs) const {
-                return lhs == rhs;
-            }
-
-            template <> bool operator()(const std::string & lhs, const std::string & rhs) const {
-                return _stricmp(lhs.c_str(), rhs.c_str()) == 0;
+            switch (_tag) {
+            case tag::integer:
+                return _as<SInt32>() == other._as<SInt32>();
+            case tag::real:
+                return _as<Real>() == other._as<Real>();
+            case tag::form:
+                return formId() == other.formId();
+            case tag::object:
+                return _as<internal_object_ref>() == other._as<internal_object_ref>();
+            case tag::short_string:
+            case tag::long_string:
+                return _stricmp(strValue(), other.strValue()) == 0;
+            default:
+                return true;
             }
-        };
-
-        bool isEqual(const item& other) const {
-            return boost::apply_visitor(are_strict_equals(), _var, other._var);
         }
 
         bool isNull() const {
-            return is_type<boost::blank>();
+            return _tag == tag::blank;
         }
 
         bool isNumber() const {
-            return is_type<SInt32>() || is_type<Real>();
+            return _tag == tag::integer || _tag == tag::real;
         }
 
         template<class T> T readAs() const;
@@ -290,10 +559,10 @@ namespace collections {
 
         bool operator == (const object_base &obj) const { return *this == &obj; }
 
+        // strings are compared case-sensitively here, as std::string did
         template<class T>
         bool operator == (const T& v) const {
-            auto thisV = get<T>();
-            return thisV && *thisV == v;
+            return _equals(v, std::is_same<user2variant_t<T>, std::string>{});
         }
 
         template<class T>
@@ -303,30 +572,30 @@ namespace collections {
 
         bool operator < (const item& other) const {
             const auto l = type(), r = other.type();
-            return l == r ? boost::apply_visitor(lesser_comparison(), _var, other._var) : (l < r);
-        }
-    private:
-        class lesser_comparison : public boost::static_visitor < bool > {
-        public:
-
-            template <typename T, typename U>
-            bool operator()(const T &, const U &) const {
-                return type2index<T>::index < type2index<U>::index;
+            if (l != r) {
+                return l < r;
             }
 
-            template <typename T>
-            bool operator()(const T & lhs, const T & rhs) const {
-                return lhs < rhs;
+            switch (_tag) {
+            case tag::integer:
+                return _as<SInt32>() < other._as<SInt32>();
+            case tag::real:
+                return _as<Real>() < other._as<Real>();
+            case tag::form:
+                return formId() < other.formId();
+            case tag::object:
+                return _as<internal_object_ref>() < other._as<internal_object_ref>();
+            case tag::short_string:
+            case tag::long_string:
+                return _stricmp(strValue(), other.strValue()) < 0;
+            default:
+                return false;
             }
-
-            bool operator()(const std::string & lhs, const std::string & rhs) const {
-                return _stricmp(lhs.c_str(), rhs.c_str()) < 0;
-            }
-
-        };
-
+        }
     };
 
+    static_assert(sizeof(item) == 16, "item is expected to be 16 bytes wide");
+
     template<> inline item::Real item::readAs<item::Real>() const {
         return fltValue();
     }
@@ -340,8 +609,11 @@ namespace collections {
     }
 
     template<> inline std::string item::readAs<std::string>() const {
-        auto str = boost::get<std::string>(&_var);
-        return str ? *str : std::string();
+        if (_is_string()) {
+            auto range = _string_range();
+            return std::string(range.begin(), range.end());
+        }
+        return std::string();
     }
 
     template<> inline skse::string_ref item::readAs<skse::string_ref>() const {
@@ -367,16 +639,13 @@ namespace collections {
     }
 
     template<> inline form_ref item::readAs<form_ref>() const {
-        auto form_ptr = get<form_ref>();
-        return form_ptr ? *form_ptr : form_ref{};
+        return _tag == tag::form ? _form() : form_ref{};
     }
 
 }
 
 namespace std {
     template<> inline void swap(collections::item& l, collections::item& r) {
-        static_assert(sizeof(decltype(l)) == sizeof(decltype(l.var())),
-            "ensures that no additional fields were added");
-        l.var().swap(r.var());
+        l.swap(r);
     }
 }
@@ -300,7 +300,7 @@ namespace collections {
                 auto string = json_string_value(val);
 
                 if (!reference_serialization::is_special_string(string)) {
-                    item = string;
+                    item = make_string(string, json_string_length(val));
                 } else {
                     if (forms::is_form_string(string)) {
                         /*  having dilemma here:
@@ -337,6 +337,13 @@ namespace collections {
 
             return item;
         }
+
+        // the long strings are shared through the string pool, the short ones are stored in-place anyway
+        item make_string(const char *string, size_t length) {
+            return length > item::short_string_capacity
+                ? item(_context._string_pool.intern(string, length))
+                : item(string);
+        }
     };
 
 
@@ -422,15 +429,15 @@ namespace collections {
                 json_ref object;
 
                 void operator () (const array& cnt) {
-                    size_t index = 0;
-                    for (auto& itm : cnt.u_container()) {
-                        self->fill_key_info(itm, cnt, index++);
+                    for (int32_t index = 0, count = cnt.u_count(); index < count; ++index) {
+                        const item itm = cnt.u_item_at(index);
+                        self->fill_key_info(itm, cnt, index);
                         json_array_append_new(object, self->create_value(itm));
                     }
                 }
                 void operator () (const map& cnt) {
                     for (auto& pair : cnt.u_container()) {
-                        self->fill_key_info(pair.second, cnt, pair.first);
+                        self->fill_key_info(pair.second, cnt, std::string(pair.first.c_str(), pair.first.size()));
                         json_object_set_new(object, pair.first.c_str(), self->create_value(pair.second));
                     }
                 }
@@ -482,8 +489,8 @@ namespace collections {
                     return json_null();
                 }
 
-                json_ref operator()(const std::string & val) const {
-                    return json_stringn(val.c_str(), val.size());
+                json_ref operator()(const util::cstring & val) const {
+                    return json_stringn(val.begin(), val.size());
                 }
 
                 json_ref operator()(const boost::blank&) const {
@@ -501,7 +508,7 @@ namespace collections {
                 json_ref operator()(const form_ref& val) const {
                     auto formStr = forms::form_to_string(val.get());
                     if (formStr) {
-                        return (*this)(*formStr);
+                        return json_stringn(formStr->c_str(), formStr->size());
                     }
                     else {
                         return null();
@@ -515,7 +522,7 @@ namespace collections {
 
             } item_visitor = { *this };
 
-            json_ref val = item.var().apply_visitor(item_visitor);
+            json_ref val = item.visit(item_visitor);
             return val;
         }
 
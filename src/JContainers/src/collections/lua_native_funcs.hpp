@@ -74,8 +74,8 @@ namespace lua { namespace api {
         struct t : public boost::static_visitor < > {
             JCToLuaValue value;
 
-            void operator ()(const std::string& str) {
-                value.string = CString_copy(str.c_str(), str.size()).str;
+            void operator ()(const util::cstring& str) {
+                value.string = CString_copy(str.begin(), str.size()).str;
                 value.stringLength = str.size();
             }
 
@@ -100,7 +100,7 @@ namespace lua { namespace api {
         } converter;
 
         converter.value.type = itm.type();
-        itm.var().apply_visitor(converter);
+        itm.visit(converter);
         return converter.value;
     }
     
@@ -124,7 +124,7 @@ namespace lua { namespace api {
             itm = (object_base *)v->object;
             break;
         case item_type::string:
-            itm = v->string;
+            itm = context.make_item((const char*)v->string);
             break;
         case item_type::no_item:
         case item_type::none:
@@ -191,26 +191,40 @@ namespace lua { namespace api {
         return value;
     }
 
+    // fills the @results with the values at the @paths, the paths sharing a prefix get resolved together
+    cexport void JValue_solveMany(tes_context *context, object_base *obj, const cstring *paths, uint32_t count, JCToLuaValue *results) {
+        assert(context && "context is null");
+        for (uint32_t i = 0; i < count; ++i) {
+            results[i] = JCToLuaValue_None();
+        }
+        collections::path_resolving::resolve_many(*context, obj, paths, count, [results](size_t i, item *itm) {
+            results[i] = JCToLuaValue_fromItem(itm);
+        });
+    }
+
     cexport JCToLuaValue JArray_getValue(array* obj, index key) {
         JCToLuaValue v(JCToLuaValue_None());
         array_functions::doReadOp(obj, key, [=, &v](index idx) {
-            v = JCToLuaValue_fromItem(obj->u_container()[idx]);
+            v = JCToLuaValue_fromItem(obj->u_item_at(idx));
         });
         //std::cout << "value returned: " << JCValue_toString(v) << std::endl;
         return v;
     }
 
     cexport void JArray_setValue(array* obj, index key, const JCValue* val) {
-        array_functions::doReadOp(obj, key, [=](index idx) {
-            JCValue_fillItem(HACK_get_tcontext(*obj), val, obj->u_container()[idx]);
+        array_functions::doUpdateOp(obj, key, [=](index idx) {
+            item value;
+            JCValue_fillItem(HACK_get_tcontext(*obj), val, value);
+            obj->u_replace(idx, std::move(value));
         });
         //std::cout << "value assigned: " << JCValue_toString(val) << std::endl;
     }
 
     cexport void JArray_insert(array* obj, const JCValue* val, index key) {
         array_functions::doWriteOp(obj, key, [=](index idx) {
-            auto& cnt = obj->u_container();
-            JCValue_fillItem(HACK_get_tcontext(*obj), val, *cnt.insert(cnt.begin() + idx, item()));
+            item value;
+            JCValue_fillItem(HACK_get_tcontext(*obj), val, value);
+            obj->u_insert(idx, std::move(value));
         });
         //std::cout << "value assigned: " << JCValue_toString(val) << std::endl;
     }
@@ -218,7 +232,7 @@ namespace lua { namespace api {
     //////////////////////////////////////////////////////////////////////////
     cexport CString JMap_nextKey(const map *obj, cstring lastKey) {
         CString next = CString_None();
-        map_functions::nextKey(obj, lastKey, [&](const std::string& key) { next = CString_copy(key); });
+        map_functions::nextKey(obj, lastKey, [&](const util::shared_string& key) { next = CString_copy(key.c_str(), key.size()); });
         return next;
     }
 
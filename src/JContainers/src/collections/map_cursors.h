@@ -0,0 +1,335 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "util/spinlock.h"
+#include "object/object_base.h"
+#include "object/object_context.h"
+#include "collections/collections.h"
+
+namespace collections
+{
+    // Iteration cursors over JMap, JFormMap and JIntMap, held on behalf of the scripts.
+    //
+    // A cursor remembers the position of the current pair, its key and the map version at that moment.
+    // While the map version doesn't change the next pair is simply the one at the next position,
+    // so the whole iteration is O(n). Once the map gets modified, the cursor finds its key again
+    // and continues from the key's new position. If the key is gone, the iteration continues from the pair
+    // which followed it: the next greater key of JIntMap, the pair which took the key's position in JMap and JFormMap
+    // (exactly the next pair as long as the pairs before the cursor were not removed too).
+    //
+    // A cursor is released once the iteration reaches the end or the script calls iterEnd. The cursor in use
+    // is never taken away: the table grows instead, and once it's full the cursors of the destroyed maps get released.
+    // Only if there are still no free slots, the cursor which wasn't used for the longest time gets evicted
+    // (it takes max_slots cursors abandoned by the scripts).
+    // The cursor id carries the slot generation, so the id of a released cursor is never valid again.
+    class map_cursors {
+    public:
+        using cursor_id = SInt32;
+
+    private:
+
+        enum : uint32_t {
+            slot_bits = 16,
+            max_slots = 1 << slot_bits,
+            generation_limit = 1 << (31 - slot_bits), // keeps the ids positive
+        };
+
+        struct cursor {
+            Handle handle = Handle::Null;       // the map, null if the slot is free
+            object_base *object = nullptr;      // to tell the map from another one which got the handle later
+            uint32_t version = 0;
+            uint32_t index = 0;
+            item key;
+        };
+
+        struct slot {
+            cursor data;
+            uint16_t generation = 1;
+            uint32_t last_use = 0;
+        };
+
+        mutable util::spinlock _lock;
+        std::vector<slot> _slots;
+        std::vector<uint32_t> _free;
+        uint32_t _clock = 0;
+
+        static uint32_t slot_of(cursor_id id) { return static_cast<uint32_t>(id) & (max_slots - 1); }
+        static uint16_t generation_of(cursor_id id) { return static_cast<uint16_t>(static_cast<uint32_t>(id) >> slot_bits); }
+        static cursor_id id_of(const slot& s, uint32_t idx) {
+            return static_cast<cursor_id>((uint32_t(s.generation) << slot_bits) | idx);
+        }
+
+        // the slot of the cursor in use
+        slot* u_slot(cursor_id id) {
+            if (id <= 0 || slot_of(id) >= _slots.size()) {
+                return nullptr;
+            }
+            slot& s = _slots[slot_of(id)];
+            return (s.generation == generation_of(id) && s.data.handle != Handle::Null) ? &s : nullptr;
+        }
+
+        bool _read(cursor_id id, cursor& c) {
+            util::spinlock::guard g(_lock);
+            slot* s = u_slot(id);
+            if (!s) {
+                return false;
+            }
+            s->last_use = ++_clock;
+            c = s->data;
+            return true;
+        }
+
+        void _write(cursor_id id, cursor&& c) {
+            util::spinlock::guard g(_lock);
+            if (slot* s = u_slot(id)) {
+                s->last_use = ++_clock;
+                s->data = std::move(c);
+            }
+        }
+
+        bool u_has_free_slot() const {
+            return !_free.empty() || _slots.size() < max_slots;
+        }
+
+        cursor_id u_allocate(cursor&& c) {
+            uint32_t idx;
+            if (!_free.empty()) {
+                idx = _free.back();
+                _free.pop_back();
+            }
+            else {
+                idx = static_cast<uint32_t>(_slots.size());
+                _slots.emplace_back();
+            }
+            slot& s = _slots[idx];
+            s.data = std::move(c);
+            s.last_use = ++_clock;
+            return id_of(s, idx);
+        }
+
+        void u_release(uint32_t idx) {
+            slot& s = _slots[idx];
+            s.data = cursor();
+            if (++s.generation == generation_limit) {
+                s.generation = 1;
+            }
+            _free.push_back(idx);
+        }
+
+        cursor_id _allocate(object_context& context, cursor&& c) {
+            {
+                util::spinlock::guard g(_lock);
+                if (u_has_free_slot()) {
+                    return u_allocate(std::move(c));
+                }
+            }
+
+            _release_orphans(context);
+
+            bool evicted = false;
+            cursor_id id;
+            {
+                util::spinlock::guard g(_lock);
+                if (!u_has_free_slot()) {
+                    u_evict_least_recent();
+                    evicted = true;
+                }
+                id = u_allocate(std::move(c));
+            }
+            if (evicted) {
+                JC_log("map_cursors: all %u cursors are in use, the least recently used one got released. "
+                    "The scripts which stop iterating early should call iterEnd", (uint32_t)max_slots);
+            }
+            return id;
+        }
+
+        // releases the cursors of the destroyed maps. The maps are looked up outside of the table lock
+        void _release_orphans(object_context& context) {
+            struct owner {
+                cursor_id id;
+                Handle handle;
+                object_base *object;
+            };
+            std::vector<owner> owners;
+            {
+                util::spinlock::guard g(_lock);
+                owners.reserve(_slots.size());
+                for (uint32_t idx = 0; idx < _slots.size(); ++idx) {
+                    const slot& s = _slots[idx];
+                    if (s.data.handle != Handle::Null) {
+                        owners.push_back(owner{ id_of(s, idx), s.data.handle, s.data.object });
+                    }
+                }
+            }
+
+            for (const owner& o : owners) {
+                if (context.getObjectRef(o.handle).get() != o.object) {
+                    end(o.id);
+                }
+            }
+        }
+
+        void u_evict_least_recent() {
+            uint32_t oldest = 0;
+            for (uint32_t idx = 1; idx < _slots.size(); ++idx) {
+                if (_clock - _slots[idx].last_use > _clock - _slots[oldest].last_use) {
+                    oldest = idx;
+                }
+            }
+            u_release(oldest);
+        }
+
+        // the key lookups
+        static const char* lookup_key(const map&, const item& key) { return key.strValue(); }
+        static form_ref lookup_key(const form_map&, const item& key) { return key.readAs<form_ref>(); }
+        static int32_t lookup_key(const integer_map&, const item& key) { return key.intValue(); }
+
+        // the pairs which iteration skips: expired form keys, as the nextKey does
+        template<class T>
+        static bool is_skipped(const T&, const typename T::value_type&) { return false; }
+        static bool is_skipped(const form_map&, const form_map::value_type& pair) { return pair.first.is_expired(); }
+
+        template<class T>
+        object_stack_ref_template<T> _resolve(object_context& context, const cursor& c) const {
+            object_stack_ref ref = context.getObjectRef(c.handle);
+            if (!ref || ref.get() != c.object) {
+                return nullptr;
+            }
+            return ref->as<T>();
+        }
+
+        // the position of the pair which followed the removed key of the cursor
+        template<class T>
+        static size_t position_after_removed(const T&, const cursor& c) { return c.index; }
+        static size_t position_after_removed(const integer_map& obj, const cursor& c) {
+            const auto& cnt = obj.u_container();
+            return cnt.lower_bound(c.key.intValue()) - cnt.begin();
+        }
+
+        // brings the cursor up to date with the map. If the pair the cursor pointed to is gone,
+        // returns false and points the cursor to the position of the pair which followed it
+        template<class T>
+        static bool u_locate(const T& obj, cursor& c) {
+            const auto& cnt = obj.u_container();
+            if (c.version == obj.u_version() && c.index < cnt.size()) {
+                return true;
+            }
+
+            const size_t index = cnt.index_of(lookup_key(obj, c.key));
+            if (index == cnt.npos) {
+                c.index = static_cast<uint32_t>(position_after_removed(obj, c));
+                return false;
+            }
+            c.index = static_cast<uint32_t>(index);
+            c.version = obj.u_version();
+            return true;
+        }
+
+        // points the cursor to the first not skipped pair at @from position or after it
+        template<class T>
+        static bool u_seek(const T& obj, cursor& c, size_t from) {
+            const auto& cnt = obj.u_container();
+            for (size_t i = from; i < cnt.size(); ++i) {
+                const auto& pair = cnt.nth(i);
+                if (!is_skipped(obj, pair)) {
+                    c.index = static_cast<uint32_t>(i);
+                    c.version = obj.u_version();
+                    c.key = item(pair.first);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    public:
+
+        map_cursors() = default;
+        map_cursors(const map_cursors&) = delete;
+        map_cursors& operator = (const map_cursors&) = delete;
+
+        // creates the cursor pointing to the first pair, 0 if there are no pairs
+        template<class T>
+        cursor_id begin(object_context& context, T& obj) {
+            cursor c;
+            c.handle = obj.public_id();
+            c.object = &obj;
+            {
+                object_lock g(obj);
+                if (!u_seek(obj, c, 0)) {
+                    return 0;
+                }
+            }
+            return _allocate(context, std::move(c));
+        }
+
+        // moves the cursor to the next pair. Once there are no more pairs or the map is gone,
+        // releases the cursor and returns 0
+        template<class T>
+        cursor_id next(object_context& context, cursor_id id) {
+            cursor c;
+            if (!_read(id, c)) {
+                return 0;
+            }
+
+            bool moved = false;
+            if (auto obj = _resolve<T>(context, c)) {
+                object_lock g(obj.get());
+                const bool found = u_locate(*obj, c);
+                moved = u_seek(*obj, c, found ? c.index + 1 : c.index);
+            }
+
+            if (!moved) {
+                end(id);
+                return 0;
+            }
+            _write(id, std::move(c));
+            return id;
+        }
+
+        // calls @func with the pair the cursor points to, returns false if the cursor is not valid
+        // or its pair has been removed
+        template<class T, class F>
+        bool visit(object_context& context, cursor_id id, F&& func) {
+            cursor c;
+            if (!_read(id, c)) {
+                return false;
+            }
+
+            if (auto obj = _resolve<T>(context, c)) {
+                object_lock g(obj.get());
+                const T& cobj = *obj;
+                if (u_locate(cobj, c)) {
+                    func(cobj.u_container().nth(c.index));
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // releases the cursor
+        void end(cursor_id id) {
+            util::spinlock::guard g(_lock);
+            if (u_slot(id)) {
+                u_release(slot_of(id));
+            }
+        }
+
+        // the slots are kept, so the ids issued before stay invalid
+        void u_clear() {
+            util::spinlock::guard g(_lock);
+            for (uint32_t idx = 0; idx < _slots.size(); ++idx) {
+                if (_slots[idx].data.handle != Handle::Null) {
+                    u_release(idx);
+                }
+            }
+        }
+
+        // the number of cursors in use
+        size_t active_count() const {
+            util::spinlock::guard g(_lock);
+            return _slots.size() - _free.size();
+        }
+    };
+}
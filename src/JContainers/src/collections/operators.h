@@ -5,29 +5,47 @@
 #include <thread>
 #include "meta.h"
 #include "util/istring.h"
+#include "util/simd_reductions.h"
 
 namespace collections {
 
     namespace operators
     {
         using istring = util::istring;
-        typedef void (*operator_func)(const item& val, item& state);
+
+        // The values an operator accumulates while visiting the items
+        struct operator_state {
+            item value;                 // the result, the min/max operators keep the current extreme here
+            SInt32 count = 0;           // the number of the accumulated values
+            int64_t ints = 0;           // the sum or the product of the integers
+            double reals = 0;           // the sum or the product of the floats
+            bool has_reals = false;
+        };
+
+        // accumulates a single item
+        typedef void (*operator_func)(const item& val, operator_state& state);
+        // accumulates all the packed array values at once, must give the same result as @operator_func applied to every value
+        typedef void (*packed_func)(const packed_items& values, operator_state& state);
+        // turns the accumulated values into the result, optional
+        typedef void (*finish_func)(operator_state& state);
 
         struct coll_operator {
             operator_func func;
+            packed_func packed;
+            finish_func finish;
             const char *func_name;
             const char *description;
 
-            static coll_operator make(operator_func _func, const char *_func_name, const char *_description) {
-                coll_operator op = {_func, _func_name, _description};
+            static coll_operator make(operator_func _func, packed_func _packed, finish_func _finish, const char *_func_name, const char *_description) {
+                coll_operator op = {_func, _packed, _finish, _func_name, _description};
                 return op;
             }
         };
 
         typedef std::map<istring, coll_operator*> operator_map;
 
-#define COLLECTION_OPERATOR(func, descr) \
-    static ::meta<coll_operator> g_collection_operator_##func(coll_operator::make(func, #func, descr));
+#define COLLECTION_OPERATOR(func, packed, finish, descr) \
+    static ::meta<coll_operator> g_collection_operator_##func(coll_operator::make(func, packed, finish, #func, descr));
 
         template<class Key>
         static coll_operator* get_operator(const Key& key) {
@@ -51,60 +69,216 @@ namespace collections {
             return op_map;
         }
 
-        void maxNum(const item& val, item& state) {
+        namespace packed {
+
+            static_assert(sizeof(SInt32) == sizeof(int32_t), "the integer kernels expect 32-bit integers");
+
+            // the packed integers or floats, nullptr if the values are of another type or there are none
+            inline const int32_t* ints(const packed_items& values) {
+                auto v = values.values<SInt32>();
+                return v && !v->empty() ? reinterpret_cast<const int32_t*>(v->data()) : nullptr;
+            }
+
+            inline const float* reals(const packed_items& values) {
+                auto v = values.values<item::Real>();
+                return v && !v->empty() ? v->data() : nullptr;
+            }
+
+            // Feeds the first value and the extreme of the values into the item-by-item operator.
+            // This gives exactly the same result (and the same result type) as visiting every value
+            template<operator_func func, class T>
+            void fold_extreme(const T* v, size_t count, T extreme, operator_state& state) {
+                func(item(v[0]), state);
+                if (count > 1) {
+                    func(item(extreme), state);
+                }
+            }
+
+            template<operator_func func, bool of_ints, bool of_reals>
+            void max(const packed_items& values, operator_state& state) {
+                if (auto v = of_ints ? ints(values) : nullptr) {
+                    fold_extreme<func>(v, values.size(), util::simd::max(v, values.size()), state);
+                }
+                else if (auto v = of_reals ? reals(values) : nullptr) {
+                    fold_extreme<func>(v, values.size(), util::simd::max(v, values.size()), state);
+                }
+            }
+
+            template<operator_func func, bool of_ints, bool of_reals>
+            void min(const packed_items& values, operator_state& state) {
+                if (auto v = of_ints ? ints(values) : nullptr) {
+                    fold_extreme<func>(v, values.size(), util::simd::min(v, values.size()), state);
+                }
+                else if (auto v = of_reals ? reals(values) : nullptr) {
+                    fold_extreme<func>(v, values.size(), util::simd::min(v, values.size()), state);
+                }
+            }
+        }
+
+        void maxNum(const item& val, operator_state& state) {
             if (val.isNumber()) {
-                state = state.isNull() ? val : item(
-                    (std::max)(val.fltValue(), state.fltValue())
+                state.value = state.value.isNull() ? val : item(
+                    (std::max)(val.fltValue(), state.value.fltValue())
                     );
             }
         }
-        COLLECTION_OPERATOR(maxNum, "returns maximum number (int or float) in collection");
+        COLLECTION_OPERATOR(maxNum, (packed::max<maxNum, true, true>), nullptr, "returns maximum number (int or float) in collection");
 
-        void minNum(const item& val, item& state) {
+        void minNum(const item& val, operator_state& state) {
             if (val.isNumber()) {
-                state = state.isNull() ? val : item(
-                    (std::min)(val.fltValue(), state.fltValue())
+                state.value = state.value.isNull() ? val : item(
+                    (std::min)(val.fltValue(), state.value.fltValue())
                     );
             }
         }
-        COLLECTION_OPERATOR(minNum, "returns minimum number (int or float) in collection");
+        COLLECTION_OPERATOR(minNum, (packed::min<minNum, true, true>), nullptr, "returns minimum number (int or float) in collection");
 
-        void maxFlt(const item& val, item& state) {
+        void maxFlt(const item& val, operator_state& state) {
             if (val.is_type<item::Real>()) {
-                state = state.isNull() ? val : item(
-                    (std::max)(val.fltValue(), state.fltValue())
+                state.value = state.value.isNull() ? val : item(
+                    (std::max)(val.fltValue(), state.value.fltValue())
                     );
             }
         }
-        COLLECTION_OPERATOR(maxFlt, "returns maximum float number in collection");
+        COLLECTION_OPERATOR(maxFlt, (packed::max<maxFlt, false, true>), nullptr, "returns maximum float number in collection");
 
-        void minFlt(const item& val, item& state) {
+        void minFlt(const item& val, operator_state& state) {
             if (val.is_type<item::Real>()) {
-                state = state.isNull() ? val : item(
-                    (std::min)(val.fltValue(), state.fltValue())
+                state.value = state.value.isNull() ? val : item(
+                    (std::min)(val.fltValue(), state.value.fltValue())
                     );
             }
         }
-        COLLECTION_OPERATOR(minFlt, "returns minimum float number collection");
+        COLLECTION_OPERATOR(minFlt, (packed::min<minFlt, false, true>), nullptr, "returns minimum float number collection");
 
-        void maxInt(const item& val, item& state) {
+        void maxInt(const item& val, operator_state& state) {
             if (val.is_type<SInt32>()) {
-                state = state.isNull() ? val : item(
-                    (std::max)(val.intValue(), state.intValue())
+                state.value = state.value.isNull() ? val : item(
+                    (std::max)(val.intValue(), state.value.intValue())
                     );
             }
         }
-        COLLECTION_OPERATOR(maxInt, "returns maximum int number in collection");
+        COLLECTION_OPERATOR(maxInt, (packed::max<maxInt, true, false>), nullptr, "returns maximum int number in collection");
 
-        void minInt(const item& val, item& state) {
+        void minInt(const item& val, operator_state& state) {
             if (val.is_type<SInt32>()) {
-                state = state.isNull() ? val : item(
-                    (std::min)(val.intValue(), state.intValue())
+                state.value = state.value.isNull() ? val : item(
+                    (std::min)(val.intValue(), state.value.intValue())
                     );
             }
         }
-        COLLECTION_OPERATOR(minInt, "returns minimum int number in collection");
+        COLLECTION_OPERATOR(minInt, (packed::min<minInt, true, false>), nullptr, "returns minimum int number in collection");
+
+        // @sum and @avg share the accumulation: exact integer sum, double precision float sum
+
+        void sum(const item& val, operator_state& state) {
+            if (val.is_type<SInt32>()) {
+                state.ints += val.intValue();
+                ++state.count;
+            }
+            else if (val.is_type<item::Real>()) {
+                state.reals += val.fltValue();
+                state.has_reals = true;
+                ++state.count;
+            }
+        }
+
+        void sum_packed(const packed_items& values, operator_state& state) {
+            if (auto v = packed::ints(values)) {
+                state.ints += util::simd::sum(v, values.size());
+                state.count += static_cast<SInt32>(values.size());
+            }
+            else if (auto v = packed::reals(values)) {
+                state.reals += util::simd::sum(v, values.size());
+                state.has_reals = true;
+                state.count += static_cast<SInt32>(values.size());
+            }
+        }
+
+        // the integer sum wraps around, as the Papyrus integer addition does
+        void sum_finish(operator_state& state) {
+            if (state.count > 0) {
+                state.value = state.has_reals
+                    ? item(static_cast<item::Real>(state.reals + state.ints))
+                    : item(static_cast<SInt32>(static_cast<uint32_t>(state.ints)));
+            }
+        }
+        COLLECTION_OPERATOR(sum, sum_packed, sum_finish, "returns the sum of the numbers in collection: int if all of them are ints, float otherwise");
+
+        void avg(const item& val, operator_state& state) {
+            sum(val, state);
+        }
+
+        void avg_finish(operator_state& state) {
+            if (state.count > 0) {
+                state.value = static_cast<item::Real>((state.reals + state.ints) / state.count);
+            }
+        }
+        COLLECTION_OPERATOR(avg, sum_packed, avg_finish, "returns the average (float) of the numbers in collection");
+
+        void count(const item&, operator_state& state) {
+            ++state.count;
+        }
+
+        void count_packed(const packed_items& values, operator_state& state) {
+            state.count += static_cast<SInt32>(values.size());
+        }
+
+        void count_finish(operator_state& state) {
+            state.value = state.count;
+        }
+        COLLECTION_OPERATOR(count, count_packed, count_finish, "returns the number of items in collection");
 
+        // All the numbers are ints: the product wraps around like the sum does.
+        // Once there is a float, the result is the double precision product of all the numbers, ints included,
+        // so that the ints never wrap then. Both products are accumulated as it is unknown in advance which one is needed
+        void product(const item& val, operator_state& state) {
+            if (!val.isNumber()) {
+                return;
+            }
+            if (state.count++ == 0) {
+                state.ints = 1;
+                state.reals = 1;
+            }
+            if (val.is_type<SInt32>()) {
+                state.ints = static_cast<uint32_t>(state.ints) * static_cast<uint32_t>(val.intValue());
+                state.reals *= val.intValue();
+            }
+            else {
+                state.reals *= val.fltValue();
+                state.has_reals = true;
+            }
+        }
+
+        void product_packed(const packed_items& values, operator_state& state) {
+            const int32_t* ints = packed::ints(values);
+            const float* reals = packed::reals(values);
+            if (!ints && !reals) {
+                return;
+            }
+            if (state.count == 0) {
+                state.ints = 1;
+                state.reals = 1;
+            }
+            if (ints) {
+                state.ints = static_cast<uint32_t>(state.ints) * static_cast<uint32_t>(util::simd::product(ints, values.size()));
+                state.reals *= util::simd::real_product(ints, values.size());
+            }
+            else {
+                state.reals *= util::simd::product(reals, values.size());
+                state.has_reals = true;
+            }
+            state.count += static_cast<SInt32>(values.size());
+        }
+
+        void product_finish(operator_state& state) {
+            if (state.count > 0) {
+                state.value = state.has_reals
+                    ? item(static_cast<item::Real>(state.reals))
+                    : item(static_cast<SInt32>(static_cast<uint32_t>(state.ints)));
+            }
+        }
+        COLLECTION_OPERATOR(product, product_packed, product_finish, "returns the product of the numbers in collection: int if all of them are ints (wraps around on overflow), float otherwise");
 
 #undef COLLECTION_OPERATOR
     };
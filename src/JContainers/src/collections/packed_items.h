@@ -0,0 +1,229 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#include "collections/item.h"
+
+namespace collections {
+
+    // Contents of a homogeneous array in packed form: plain integers, floats or form references,
+    // with no per-value item overhead and no boxed forms.
+    // The kind is item_type::none while nothing is packed
+    class packed_items {
+    public:
+        using Real = item::Real;
+
+    private:
+        item_type _kind = item_type::none;
+        std::vector<SInt32> _ints;
+        std::vector<Real> _reals;
+        std::vector<form_ref> _forms;
+
+    public:
+
+        static bool is_packable(item_type kind) {
+            return kind == item_type::integer || kind == item_type::real || kind == item_type::form;
+        }
+
+        item_type kind() const { return _kind; }
+        bool is_packed() const { return _kind != item_type::none; }
+
+        // whether the item can be stored among the packed values
+        bool accepts(const item& itm) const { return is_packed() && itm.type() == _kind; }
+
+        // Calls @func with the vector of the packed values. Must not be called while nothing is packed
+        template<class F>
+        auto visit(F&& func) -> decltype(func(_ints)) {
+            switch (_kind) {
+            case item_type::real:   return func(_reals);
+            case item_type::form:   return func(_forms);
+            default:                return func(_ints);
+            }
+        }
+
+        template<class F>
+        auto visit(F&& func) const -> decltype(func(_ints)) {
+            switch (_kind) {
+            case item_type::real:   return func(_reals);
+            case item_type::form:   return func(_forms);
+            default:                return func(_ints);
+            }
+        }
+
+        // the packed values if they are of type T, otherwise nullptr
+        template<class T> const std::vector<T>* values() const;
+
+        size_t size() const {
+            return is_packed() ? visit([](const auto& v) { return v.size(); }) : 0;
+        }
+
+        void reserve(size_t count) {
+            if (is_packed()) {
+                visit([count](auto& v) { v.reserve(count); });
+            }
+        }
+
+        // starts packing the values of given kind, must be empty
+        void start(item_type kind) {
+            jc_assert(size() == 0 && is_packable(kind));
+            _kind = kind;
+        }
+
+        void clear() {
+            _ints.clear();
+            _reals.clear();
+            _forms.clear();
+            _kind = item_type::none;
+        }
+
+        item at(size_t index) const {
+            return visit([index](const auto& v) { return item(v[index]); });
+        }
+
+        // the following functions expect @accepts(itm) to be true
+
+        void push_back(const item& itm) {
+            visit([&itm](auto& v) { v.push_back(value_of(v, itm)); });
+        }
+
+        void insert(size_t index, const item& itm) {
+            visit([index, &itm](auto& v) { v.insert(v.begin() + index, value_of(v, itm)); });
+        }
+
+        void set(size_t index, const item& itm) {
+            visit([index, &itm](auto& v) { v[index] = value_of(v, itm); });
+        }
+
+        void erase(size_t first, size_t last) {
+            visit([first, last](auto& v) { v.erase(v.begin() + first, v.begin() + last); });
+        }
+
+        void shrink(size_t count) {
+            visit([count](auto& v) { v.resize(count); });
+        }
+
+        // appends [first, last) range of the @source values, the kinds must match
+        void append(const packed_items& source, size_t first, size_t last, size_t where) {
+            jc_assert(source._kind == _kind);
+            visit([&](auto& v) {
+                const auto& src = *source.values<typename std::decay<decltype(v)>::type::value_type>();
+                v.insert(v.begin() + where, src.begin() + first, src.begin() + last);
+            });
+        }
+
+        // the index of the first/last value equal to @itm within [first, last) range or -1
+        int32_t find(const item& itm, size_t first, size_t last) const {
+            if (!accepts(itm)) {
+                return -1;
+            }
+            return visit([&](const auto& v) -> int32_t {
+                const auto& needle = value_of(v, itm);
+                auto itr = std::find(v.begin() + first, v.begin() + last, needle);
+                return itr != v.begin() + last ? static_cast<int32_t>(itr - v.begin()) : -1;
+            });
+        }
+
+        int32_t rfind(const item& itm, size_t first, size_t last) const {
+            if (!accepts(itm)) {
+                return -1;
+            }
+            return visit([&](const auto& v) -> int32_t {
+                const auto& needle = value_of(v, itm);
+                for (size_t i = last; i-- > first;) {
+                    if (v[i] == needle) {
+                        return static_cast<int32_t>(i);
+                    }
+                }
+                return -1;
+            });
+        }
+
+        size_t count(const item& itm) const {
+            if (!accepts(itm)) {
+                return 0;
+            }
+            return visit([&](const auto& v) -> size_t {
+                const auto& needle = value_of(v, itm);
+                return static_cast<size_t>(std::count(v.begin(), v.end(), needle));
+            });
+        }
+
+        size_t erase_equal(const item& itm) {
+            if (!accepts(itm)) {
+                return 0;
+            }
+            return visit([&](auto& v) -> size_t {
+                const auto needle = value_of(v, itm);
+                auto newEnd = std::remove(v.begin(), v.end(), needle);
+                const size_t erased = v.end() - newEnd;
+                v.erase(newEnd, v.end());
+                return erased;
+            });
+        }
+
+        // moves the values into the @items, nothing remains packed
+        void unpack_into(std::vector<item>& items) {
+            if (!is_packed()) {
+                return;
+            }
+            visit([&items](auto& v) {
+                items.reserve(items.size() + v.size());
+                for (auto& value : v) {
+                    items.emplace_back(std::move(value));
+                }
+            });
+            clear();
+        }
+
+        // packs the @items if they all are of the same packable type, returns true on success
+        bool try_pack(std::vector<item>& items) {
+            if (is_packed() || items.empty() || !is_packable(items.front().type())) {
+                return false;
+            }
+
+            const item_type kind = items.front().type();
+            const bool homogeneous = std::all_of(items.begin(), items.end(),
+                [kind](const item& itm) { return itm.type() == kind; });
+
+            if (!homogeneous) {
+                return false;
+            }
+
+            start(kind);
+            visit([&items](auto& v) {
+                v.reserve(items.size());
+                for (const item& itm : items) {
+                    v.push_back(value_of(v, itm));
+                }
+            });
+            items.clear();
+            items.shrink_to_fit();
+            return true;
+        }
+
+        // direct access for serialization
+        std::vector<SInt32>& u_ints() { return _ints; }
+        std::vector<Real>& u_reals() { return _reals; }
+        std::vector<form_ref>& u_forms() { return _forms; }
+
+    private:
+        template<class T>
+        static T value_of(const std::vector<T>&, const item& itm) {
+            return *itm.get<T>();
+        }
+    };
+
+    template<> inline const std::vector<SInt32>* packed_items::values<SInt32>() const {
+        return _kind == item_type::integer ? &_ints : nullptr;
+    }
+
+    template<> inline const std::vector<item::Real>* packed_items::values<item::Real>() const {
+        return _kind == item_type::real ? &_reals : nullptr;
+    }
+
+    template<> inline const std::vector<form_ref>* packed_items::values<form_ref>() const {
+        return _kind == item_type::form ? &_forms : nullptr;
+    }
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "util/spinlock.h"
+
+namespace collections {
+
+    namespace operators {
+        struct coll_operator;
+    }
+
+    namespace path_resolving {
+
+        // A path segment: .key, [index], [__formData|plugin|0xid] or @operator
+        struct path_token {
+            enum class kind : uint8_t {
+                key,
+                index,
+                form,
+                operation,
+            };
+
+            kind type;
+            int32_t index = 0;                                      // [index]
+            uint32_t form_id = 0;                                   // [__formData|plugin|id], relative to the plugin
+            const operators::coll_operator *operation = nullptr;    // @operator, null if there is no such operator
+            // .key: the key; [__formData|...]: the plugin name, the form gets resolved on each access as the load order may change;
+            // @operator: the rest of the path the operator applies to
+            std::string text;
+        };
+
+        // The path parsed once. The segments are parsed up to the first malformed one:
+        // the path is incomplete if there is a malformed segment after the tokens
+        struct compiled_path {
+            std::vector<path_token> tokens;
+            bool complete = false;
+        };
+
+        // Least recently used compiled paths. The scripts use a few hundred fixed paths over and over,
+        // so a path gets parsed once and then looked up by its text, which allocates nothing.
+        //
+        // Every thread has a small cache of its own in front of the shared one: a hit there takes no lock and
+        // touches no shared memory, only the misses go to the shared list (and promote the path there).
+        // The paths are handed out as raw pointers. A thread's own cache keeps the paths it hands out alive,
+        // and while the thread holds a pin, the paths its cache drops are kept too, till the outermost pin is gone.
+        // So a path the thread got under a pin stays valid until the pin is released, whatever the other threads do
+        class path_cache {
+        public:
+
+            typedef std::shared_ptr<const compiled_path> path_ref;
+
+            struct statistics {
+                uint64_t hits;          // the lookups the shared list answered
+                uint64_t local_hits;    // the lookups the calling thread's own cache answered
+                uint64_t misses;
+                uint64_t evictions;
+                size_t size;
+            };
+
+            enum : size_t {
+                default_capacity = 1024,
+                local_capacity = 256,   // the slots of a thread's own cache, a power of two
+            };
+
+            // Keeps the paths the thread gets alive. The pins nest
+            class pin {
+            public:
+                pin() { ++local().pins; }
+                ~pin() {
+                    thread_state& state = local();
+                    if (--state.pins == 0 && !state.retired.empty()) {
+                        state.retired.clear();
+                    }
+                }
+
+                pin(const pin&) = delete;
+                pin& operator = (const pin&) = delete;
+            };
+
+            static bool is_pinned() { return local().pins != 0; }
+
+        private:
+
+            struct entry {
+                std::string text;
+                uint32_t hash;
+                path_ref path;
+            };
+
+            typedef std::list<entry> entry_list;    // the recently used paths first
+
+            // a slot of a thread's own cache, direct-mapped by the hash
+            struct local_slot {
+                const path_cache *owner = nullptr;
+                uint32_t generation = 0;
+                uint32_t hash = 0;
+                std::string text;
+                path_ref path;
+            };
+
+            struct thread_state {
+                std::array<local_slot, local_capacity> slots;
+                std::vector<path_ref> retired;      // the paths dropped from the slots while pinned
+                uint32_t pins = 0;
+                uint64_t hits = 0;
+            };
+
+            static thread_state& local() {
+                static thread_local thread_state state;
+                return state;
+            }
+
+            entry_list _entries;
+            std::unordered_multimap<uint32_t, entry_list::iterator> _index;
+            size_t _capacity;
+            uint64_t _hits = 0;
+            uint64_t _misses = 0;
+            uint64_t _evictions = 0;
+            std::atomic<uint32_t> _generation{ 1 };    // changes on clear, the threads' own slots get stale then
+            mutable util::spinlock _lock;
+
+            path_cache(const path_cache&) = delete;
+            path_cache& operator = (const path_cache&) = delete;
+
+            // FNV-1a, the paths are case-sensitive
+            static uint32_t hash_of(const char *text, size_t length) {
+                uint32_t hash = 2166136261u;
+                for (size_t i = 0; i < length; ++i) {
+                    hash = (hash ^ static_cast<unsigned char>(text[i])) * 16777619u;
+                }
+                return hash;
+            }
+
+            static bool same_text(const std::string& stored, const char *text, size_t length) {
+                return stored.size() == length && std::memcmp(stored.data(), text, length) == 0;
+            }
+
+            entry_list::iterator u_find(const char *text, size_t length, uint32_t hash) {
+                auto range = _index.equal_range(hash);
+                for (auto itr = range.first; itr != range.second; ++itr) {
+                    if (same_text(itr->second->text, text, length)) {
+                        return itr->second;
+                    }
+                }
+                return _entries.end();
+            }
+
+            void u_evict_last() {
+                auto last = std::prev(_entries.end());
+                auto range = _index.equal_range(last->hash);
+                for (auto itr = range.first; itr != range.second; ++itr) {
+                    if (itr->second == last) {
+                        _index.erase(itr);
+                        break;
+                    }
+                }
+                _entries.erase(last);
+                ++_evictions;
+            }
+
+            // puts the path into the thread's own slot, the path the slot held is retired while the thread is pinned
+            const compiled_path* remember(local_slot& slot, uint32_t generation, const char *text, size_t length, uint32_t hash, path_ref&& path) {
+                thread_state& state = local();
+                if (slot.path && state.pins != 0) {
+                    state.retired.push_back(std::move(slot.path));
+                }
+                slot.owner = this;
+                slot.generation = generation;
+                slot.hash = hash;
+                slot.text.assign(text, length);
+                slot.path = std::move(path);
+                return slot.path.get();
+            }
+
+        public:
+
+            explicit path_cache(size_t capacity = default_capacity) : _capacity(capacity) {}
+
+            // the path compiled earlier, or null
+            const compiled_path* find(const char *text, size_t length) {
+                const uint32_t hash = hash_of(text, length);
+                const uint32_t generation = _generation.load(std::memory_order_acquire);
+                thread_state& state = local();
+                local_slot& slot = state.slots[hash & (local_capacity - 1)];
+                if (slot.owner == this && slot.generation == generation && slot.hash == hash && same_text(slot.text, text, length)) {
+                    ++state.hits;
+                    return slot.path.get();
+                }
+
+                path_ref path;
+                {
+                    util::spinlock::guard g(_lock);
+                    auto itr = u_find(text, length, hash);
+                    if (itr == _entries.end()) {
+                        ++_misses;
+                        return nullptr;
+                    }
+                    ++_hits;
+                    _entries.splice(_entries.begin(), _entries, itr);
+                    path = itr->path;
+                }
+                return remember(slot, generation, text, length, hash, std::move(path));
+            }
+
+            // returns the path which is in the cache already, if another thread has compiled it first
+            const compiled_path* insert(const char *text, size_t length, path_ref path) {
+                const uint32_t hash = hash_of(text, length);
+                const uint32_t generation = _generation.load(std::memory_order_acquire);
+                {
+                    util::spinlock::guard g(_lock);
+                    auto itr = u_find(text, length, hash);
+                    if (itr != _entries.end()) {
+                        path = itr->path;
+                    }
+                    else {
+                        if (_entries.size() >= _capacity && !_entries.empty()) {
+                            u_evict_last();
+                        }
+                        _entries.push_front(entry{ std::string(text, length), hash, path });
+                        _index.emplace(hash, _entries.begin());
+                    }
+                }
+                local_slot& slot = local().slots[hash & (local_capacity - 1)];
+                return remember(slot, generation, text, length, hash, std::move(path));
+            }
+
+            statistics get_statistics() const {
+                const uint64_t localHits = local().hits;
+                util::spinlock::guard g(_lock);
+                return statistics{ _hits, localHits, _misses, _evictions, _entries.size() };
+            }
+
+            // the threads drop their own copies of the paths lazily, on their next lookups
+            void clear() {
+                util::spinlock::guard g(_lock);
+                _generation.fetch_add(1, std::memory_order_release);
+                _index.clear();
+                _entries.clear();
+            }
+        };
+    }
+}
@@ -11,7 +11,7 @@ namespace collections {
     };
 
 #   define JC_TEST(name, name2) TEST_F(JCFixture, name ## _ ## name2)
-#   define JC_TEST_DISABLED(name, name2) TEST_F(JCFixture, name ## _DISABLED_ ## name2)
+#   define JC_TEST_DISABLED(name, name2) TEST_F(JCFixture, DISABLED_ ## name ## _ ## name2)
 
 }
 
@@ -100,6 +100,449 @@ namespace collections { namespace {
         EXPECT_TRUE(item("A") < item("b"));
     }
 
+    JC_TEST(item, strings)
+    {
+        const char *shortStr = "fourteen chars";
+        const char *longStr = "a string that does not fit into an item";
+
+        item i1(shortStr), i2(longStr);
+        EXPECT_EQ(strlen(shortStr), i1.strLength());
+        EXPECT_EQ(std::string(shortStr), i1.readAs<std::string>());
+        EXPECT_EQ(std::string(longStr), i2.strValue());
+
+        // copies share the long string
+        item i3 = i2;
+        EXPECT_EQ(i2.strValue(), i3.strValue());
+
+        i3 = 10;
+        EXPECT_TRUE(i3 == 10);
+        EXPECT_EQ(std::string(longStr), i2.strValue());
+
+        // case-insensitive item comparison, case-sensitive comparison with a raw string
+        EXPECT_TRUE(item("FOURTEEN CHARS") == i1);
+        EXPECT_TRUE(i1 == shortStr);
+        EXPECT_FALSE(i1 == "FOURTEEN CHARS");
+
+        std::swap(i1, i2);
+        EXPECT_EQ(std::string(longStr), i1.strValue());
+        EXPECT_EQ(std::string(shortStr), i2.strValue());
+
+        item i4 = std::move(i1);
+        EXPECT_TRUE(i1.isNull());
+        EXPECT_EQ(std::string(longStr), i4.strValue());
+    }
+
+    // Measures the heap the items take in the arrays and in the maps against the boost::variant based items
+    // JContainers used before: the variant was 40 bytes wide, std::string kept up to 15 chars in-place,
+    // the maps were std::map. The allocations made while filling are counted, the inputs are prepared beforehand
+    JC_TEST(item, memory_usage)
+    {
+        EXPECT_EQ(sizeof(item), 16);
+        if (!util::allocation_counter::counted) {
+            JC_log("item.memory_usage: the allocations are not counted in this build");
+            return;
+        }
+
+        const size_t count = 10000;
+        auto& obj = map::object(context);
+
+        std::vector<std::string> keys, shortStrings, longStrings;
+        std::vector<form_ref> forms;
+        for (size_t i = 0; i < count; ++i) {
+            keys.push_back("key" + std::to_string(i));
+            shortStrings.push_back("str_" + std::to_string(i));
+            longStrings.push_back("a longer string value number " + std::to_string(i));
+            forms.push_back(form_ref::make_expired(util::to_enum<FormId>(i + 1)));
+        }
+
+        enum kind { integers, floats, short_strings, long_strings, objects, form_refs, kind_count };
+        const char *kindNames[] = { "integers", "floats", "short strings", "long strings", "objects", "forms" };
+        auto make = [&](int k, size_t i) -> item {
+            switch (k) {
+            case integers: return item((SInt32)i);
+            case floats: return item((Float32)i);
+            case short_strings: return item(shortStrings[i].c_str());
+            case long_strings: return item(longStrings[i].c_str());
+            case objects: return item(obj);
+            default: return item(forms[i]);
+            }
+        };
+
+        struct usage {
+            uint64_t allocations = 0;
+            uint64_t bytes = 0;
+        };
+        auto measure = [](usage& result, auto&& fill) {
+            util::allocation_counter counter;
+            fill();
+            result.allocations = counter.count();
+            result.bytes = counter.bytes();
+        };
+        // the bytes per item: the heap counted plus the in-place size of the elements
+        auto report = [&](const char *container, int k, size_t elementSize, size_t legacyElementSize, const usage& now, const usage& before) {
+            const double n = double(count);
+            JC_log("%s of %s: %.1f bytes, %.2f allocations per item; before: %.1f bytes, %.2f allocations per item",
+                container, kindNames[k], (now.bytes + elementSize * n) / n, now.allocations / n,
+                (before.bytes + legacyElementSize * n) / n, before.allocations / n);
+        };
+
+        for (int k = 0; k < kind_count; ++k) {
+            // arrays: the storage is reserved, so only the heap the items own gets counted
+            auto& arr = array::object(context);
+            arr.u_container().reserve(count);
+            std::vector<item::variant> legacyArray;
+            legacyArray.reserve(count);
+
+            usage now, before;
+            measure(now, [&]() {
+                for (size_t i = 0; i < count; ++i) {
+                    arr.u_container().push_back(make(k, i));
+                }
+            });
+            measure(before, [&]() {
+                for (size_t i = 0; i < count; ++i) {
+                    legacyArray.push_back(arr.u_container()[i].to_variant());
+                }
+            });
+            report("array", k, sizeof(item), sizeof(item::variant), now, before);
+            EXPECT_TRUE(now.bytes + sizeof(item) * count <= before.bytes + sizeof(item::variant) * count);
+
+            // a form item keeps the pointer to the form's entry, nothing gets allocated for it
+            if (k == integers || k == floats || k == short_strings || k == form_refs) {
+                EXPECT_EQ(0u, now.allocations);
+            }
+
+            // maps: the whole map gets counted, the container and the keys (with their string pool entries) included.
+            // Reported only: unique keys cost more once interned, the pool pays off when the keys repeat across the maps
+            auto& m = map::object(context);
+            std::map<std::string, item::variant> legacyMap;
+
+            measure(now, [&]() {
+                m.u_container().reserve(count);
+                for (size_t i = 0; i < count; ++i) {
+                    m.u_set(keys[i].c_str(), make(k, i));
+                }
+            });
+            measure(before, [&]() {
+                for (size_t i = 0; i < count; ++i) {
+                    legacyMap.emplace(keys[i], arr.u_container()[i].to_variant());
+                }
+            });
+            report("map", k, 0, 0, now, before);
+
+            arr.u_clear();
+            m.u_clear();
+        }
+    }
+
+    JC_TEST(item, values_by_copy)
+    {
+        const auto id = util::to_enum<FormId>(0x14);
+        auto itm = std::make_unique<item>(make_weak_form_id(id, context));
+        item copy = *itm;
+        itm.reset();
+        // the copy keeps the form alive
+        EXPECT_EQ(id, copy.formId());
+        EXPECT_TRUE(copy.get<form_ref>() && copy.get<form_ref>()->get() == id);
+        EXPECT_EQ(id, copy.readAs<form_ref>().get());
+        EXPECT_TRUE(copy == make_weak_form_id(id, context));
+        EXPECT_TRUE(!copy.get<std::string>());
+
+        item str("a string longer than fourteen characters");
+        auto strPtr = str.get<std::string>();
+        EXPECT_TRUE(strPtr && *strPtr == "a string longer than fourteen characters");
+        EXPECT_TRUE(!str.get<form_ref>());
+        EXPECT_TRUE(item("short").get<std::string>()->size() == 5);
+    }
+
+    JC_TEST(string_pool, interning)
+    {
+        auto& pool = context._string_pool;
+        const auto before = pool.u_statistics().strings;
+
+        auto s1 = pool.intern("SomeInternedKey");
+        auto s2 = pool.intern("SomeInternedKey");
+        auto s3 = pool.intern("someinternedkey");
+
+        EXPECT_TRUE(s1.shares_block_with(s2));
+        EXPECT_FALSE(s1.shares_block_with(s3));
+        EXPECT_TRUE(s1.iequals(s3));
+        EXPECT_EQ(std::string("someinternedkey"), s3.c_str());
+        EXPECT_EQ(before + 2, pool.u_statistics().strings);
+
+        // keys of different maps share the same string
+        auto& m1 = map::object(context);
+        auto& m2 = map::object(context);
+        m1.u_set("SomeInternedKey", item(1));
+        m2.u_set("SOMEINTERNEDKEY", item(2));
+        m2.u_set("someInternedKey", item(3));
+
+        EXPECT_EQ(1, m2.u_count());
+        EXPECT_TRUE(m1.u_container().begin()->first.shares_block_with(s1));
+        EXPECT_TRUE(*m1.u_get("someinternedkey") == 1);
+
+        s1 = s2 = s3 = util::shared_string();
+        m1.u_clear();
+        m2.u_clear();
+        EXPECT_EQ(before, pool.u_statistics().strings);
+    }
+
+    JC_TEST(map, hashed_keys)
+    {
+        auto& m = map::object(context);
+        const int count = 10000;
+
+        util::do_with_timing("map: 10k keys insertion", [&]() {
+            for (int i = 0; i < count; ++i) {
+                m.u_set("key_" + std::to_string(i), item(i));
+            }
+        });
+        EXPECT_EQ(count, m.u_count());
+
+        util::do_with_timing("map: 10k keys lookup", [&]() {
+            for (int i = 0; i < count; ++i) {
+                auto itm = m.u_get("KEY_" + std::to_string(i));
+                EXPECT_TRUE(itm && *itm == i);
+            }
+        });
+        EXPECT_TRUE(m.u_get("key_") == nullptr);
+
+        // iteration follows the insertion order, erasure keeps the order of the rest
+        EXPECT_TRUE(m.u_erase("Key_0"));
+        EXPECT_TRUE(m.u_erase("key_5000"));
+        EXPECT_FALSE(m.u_erase("key_5000"));
+
+        int expected = 1;
+        for (auto& pair : m.u_container()) {
+            EXPECT_EQ("key_" + std::to_string(expected), pair.first.c_str());
+            expected += (expected == 4999) ? 2 : 1;
+        }
+        EXPECT_EQ(count, expected);
+
+        m.u_set("KEY_1", item("updated"));
+        EXPECT_EQ(std::string("key_1"), m.u_container().begin()->first.c_str());
+        EXPECT_TRUE(m.u_container().begin()->second == "updated");
+
+        m.u_clear();
+    }
+
+    // the erased keys leave holes, so the removal doesn't move the rest of the pairs
+    JC_TEST(map, removal)
+    {
+        auto& m = map::object(context);
+        auto& fm = form_map::object(context);
+        const int count = 10000;
+
+        for (int i = 0; i < count; ++i) {
+            m.u_set("key_" + std::to_string(i), item(i));
+            fm.u_set(make_weak_form_id(util::to_enum<FormId>(0x14 + i), context), item(i));
+        }
+
+        // every other key, from the front
+        util::do_with_timing("map: 5k keys removal", [&]() {
+            for (int i = 0; i < count; i += 2) {
+                EXPECT_TRUE(m.u_erase("key_" + std::to_string(i)));
+            }
+        });
+        EXPECT_EQ(count / 2, m.u_count());
+
+        // the positions skip the holes
+        const auto& cnt = m.u_container();
+        EXPECT_EQ(std::string("key_1"), cnt.nth(0).first.c_str());
+        EXPECT_EQ(std::string("key_9999"), cnt.nth(count / 2 - 1).first.c_str());
+        EXPECT_EQ(2500u, cnt.index_of("key_5001"));
+        EXPECT_EQ(cnt.npos, cnt.index_of("key_5000"));
+
+        int expected = 1;
+        for (auto& pair : cnt) {
+            EXPECT_EQ("key_" + std::to_string(expected), pair.first.c_str());
+            expected += 2;
+        }
+        EXPECT_EQ(count + 1, expected);
+
+        // the new keys go after the rest
+        m.u_set("key_0", item(0));
+        EXPECT_EQ(std::string("key_0"), cnt.nth(count / 2).first.c_str());
+        EXPECT_EQ(size_t(count / 2), cnt.index_of("KEY_0"));
+
+        util::do_with_timing("map: 5k keys removal, the rest", [&]() {
+            for (int i = 1; i < count; i += 2) {
+                EXPECT_TRUE(m.u_erase("key_" + std::to_string(i)));
+            }
+        });
+        EXPECT_EQ(1, m.u_count());
+        EXPECT_TRUE(m.u_container().begin()->second == 0);
+
+        util::do_with_timing("form map: 10k keys removal", [&]() {
+            for (int i = 0; i < count; ++i) {
+                EXPECT_TRUE(fm.u_erase(make_weak_form_id(util::to_enum<FormId>(0x14 + i), context)));
+            }
+        });
+        EXPECT_EQ(0, fm.u_count());
+        EXPECT_TRUE(fm.u_container().begin() == fm.u_container().end());
+    }
+
+    JC_TEST(integer_map, adaptive_storage)
+    {
+        auto& m = integer_map::object(context);
+        auto& cnt = m.u_container();
+
+        for (int32_t i = 0; i < 1000; ++i) {
+            m.u_set(i, item(i * 10));
+        }
+        EXPECT_TRUE(cnt.is_dense());
+        EXPECT_TRUE(*m.u_get(500) == 5000);
+        EXPECT_EQ(250, cnt.nth(250).first);
+
+        // holes keep the map dense
+        for (int32_t i = 0; i < 1000; i += 3) {
+            m.u_erase(i);
+        }
+        EXPECT_TRUE(cnt.is_dense());
+        EXPECT_TRUE(m.u_get(300) == nullptr);
+        EXPECT_TRUE(*m.u_get(301) == 3010);
+
+        // far keys make it sparse, the order stays sorted
+        m.u_set(-2000000000, item(1));
+        m.u_set(2000000000, item(2));
+        EXPECT_FALSE(cnt.is_dense());
+        EXPECT_TRUE(*m.u_get(301) == 3010);
+        EXPECT_EQ(-2000000000, cnt.begin()->first);
+        EXPECT_EQ(2000000000, cnt.rbegin()->first);
+        EXPECT_TRUE(std::is_sorted(cnt.begin(), cnt.end(),
+            [](const integer_map::value_type& l, const integer_map::value_type& r) { return l.first < r.first; }));
+
+        m.u_erase(-2000000000);
+        m.u_erase(2000000000);
+        EXPECT_TRUE(cnt.is_dense());
+
+        m.u_clear();
+    }
+
+    JC_TEST(form_map, lazy_purge)
+    {
+        auto& m = form_map::object(context);
+        const auto fid = util::to_enum<FormId>(0xff000014);
+
+        m.u_set(make_lightweight_form_ref(fid, context), item(1));
+        for (uint32_t i = 1; i <= 8; ++i) {
+            m.u_set(make_weak_form_id(util::to_enum<FormId>(0x14 + i), context), item(i));
+        }
+        EXPECT_EQ(9, m.u_count());
+        EXPECT_TRUE(*m.u_get(make_lightweight_form_ref(fid, context)) == 1);
+        EXPECT_TRUE(*m.u_get(make_weak_form_id(util::to_enum<FormId>(0x15), context)) == 1);
+
+        context._form_watcher.on_form_deleted(forms::form_id_to_handle(fid));
+
+        // the expired key is not reachable with a live key of the same id
+        EXPECT_TRUE(m.u_get(make_lightweight_form_ref(fid, context)) == nullptr);
+        EXPECT_EQ(9, m.u_count());
+
+        // the form which reuses the id takes the expired entry over
+        m.u_set(make_lightweight_form_ref(fid, context), item(2));
+        EXPECT_EQ(9, m.u_count());
+        EXPECT_TRUE(*m.u_get(make_lightweight_form_ref(fid, context)) == 2);
+        EXPECT_TRUE(m.u_container().begin()->first.is_not_expired());
+
+        context._form_watcher.on_form_deleted(forms::form_id_to_handle(fid));
+        EXPECT_EQ(1u, m.u_purge_expired());
+        EXPECT_EQ(8, m.u_count());
+        EXPECT_EQ(0x15u, util::to_integral(m.u_container().begin()->first.get()));
+
+        m.u_clear();
+    }
+
+    JC_TEST(array, packed_storage)
+    {
+        auto& arr = array::object(context);
+
+        for (int32_t i = 0; i < 100; ++i) {
+            arr.u_push(i % 10);
+        }
+        EXPECT_EQ(item_type::integer, arr.u_packing());
+        EXPECT_TRUE(arr.u_item_at(42) == 2);
+        EXPECT_EQ(3, arr.u_find(item(3), 0));
+        EXPECT_EQ(13, arr.u_find(item(3), 4));
+        EXPECT_EQ(93, arr.u_rfind(item(3), 99));
+        EXPECT_EQ(10u, arr.u_count_equal(item(7)));
+        EXPECT_EQ(0u, arr.u_count_equal(item(7.0f)));
+
+        arr.u_apply([](auto& v) { std::sort(v.begin(), v.end()); });
+        EXPECT_TRUE(arr.u_item_at(0) == 0);
+        EXPECT_TRUE(arr.u_item_at(99) == 9);
+        EXPECT_EQ(item_type::integer, arr.u_packing());
+
+        EXPECT_EQ(10u, arr.u_erase_equal(item(0)));
+        EXPECT_EQ(90, arr.u_count());
+
+        // a value of another type promotes the contents, the values stay in place
+        arr.u_push(item("text"));
+        EXPECT_EQ(item_type::none, arr.u_packing());
+        EXPECT_EQ(91, arr.u_count());
+        EXPECT_TRUE(arr.u_item_at(0) == 1);
+        EXPECT_TRUE(arr.u_item_at(90) == "text");
+
+        // an emptied array packs again
+        arr.u_clear();
+        arr.u_push(1.5f);
+        arr.u_push(2.5f);
+        EXPECT_EQ(item_type::real, arr.u_packing());
+
+        auto& copy = array::object(context);
+        copy.u_insert(0, arr, 0, 2);
+        EXPECT_EQ(item_type::real, copy.u_packing());
+        EXPECT_TRUE(copy.u_item_at(1) == 2.5f);
+
+        // raw item access promotes
+        copy.u_container();
+        EXPECT_EQ(item_type::none, copy.u_packing());
+        EXPECT_TRUE(copy.u_try_pack());
+        EXPECT_EQ(item_type::real, copy.u_packing());
+
+        // the const access and the writes of the values which fit keep the contents packed
+        const array& constCopy = copy;
+        item scratch;
+        EXPECT_TRUE(*constCopy.u_get(-1, scratch) == 2.5f);
+        EXPECT_TRUE(constCopy[0] == 1.5f);
+        EXPECT_TRUE(copy.u_modify(0, [](item& itm) { itm = 3.5f; }));
+        EXPECT_FALSE(copy.u_modify(2, [](item& itm) { itm = 0.f; }));
+        EXPECT_EQ(item_type::real, copy.u_packing());
+        EXPECT_TRUE(copy.u_item_at(0) == 3.5f);
+
+        arr.u_clear();
+        copy.u_clear();
+    }
+
+    JC_TEST(array, packed_storage_through_paths)
+    {
+        object_stack_ref root = json_deserializer::object_from_json_data(context, STR({ "ints": [1, 2, 3] }));
+        ASSERT_TRUE(root);
+        array& ints = *ca::get(*root, ".ints")->object()->as<array>();
+        EXPECT_EQ(item_type::integer, ints.u_packing());
+
+        // the readers don't promote the array
+        EXPECT_EQ(2, ca::get<SInt32>(*root, ".ints[1]").get_value_or(0));
+        EXPECT_EQ(3, path_resolving::_resolve<SInt32>(context, root.get(), ".ints[-1]"));
+        EXPECT_TRUE(ca::visit_value(*root, ".ints[0]", ca::constant, [](const item& itm) {}));
+        EXPECT_EQ(item_type::integer, ints.u_packing());
+
+        // the writers store the values which fit through the packing
+        EXPECT_TRUE(ca::assign(*root, ".ints[0]", item(10)));
+        path_resolving::resolve(context, root.get(), ".ints[1]", [](item *itm) {
+            if (itm) {
+                *itm = 20;
+            }
+        }, true);
+        EXPECT_EQ(item_type::integer, ints.u_packing());
+        EXPECT_TRUE(ints.u_item_at(0) == 10);
+        EXPECT_TRUE(ints.u_item_at(1) == 20);
+
+        // the other values promote it
+        EXPECT_TRUE(ca::assign(*root, ".ints[2]", item("text")));
+        EXPECT_EQ(item_type::none, ints.u_packing());
+        EXPECT_TRUE(ints.u_item_at(2) == "text");
+    }
+
     TEST (forms, test)
     {
         using forms::is_form_string;
@@ -297,6 +740,324 @@ namespace collections { namespace {
         EXPECT_FALSE(ca::assign(m, ".h.f.t", 1));
     }
 
+    JC_TEST(path_resolving, compiled_paths)
+    {
+        using path_resolving::path_token;
+
+        path_resolving::path_cache::pin pinned;
+        auto path = path_resolving::compiled(".a.b[3][__formData|Skyrim.esm|0x14]");
+        EXPECT_TRUE(path->complete);
+        ASSERT_EQ(4u, path->tokens.size());
+        EXPECT_TRUE(path->tokens[0].type == path_token::kind::key && path->tokens[0].text == "a");
+        EXPECT_TRUE(path->tokens[1].type == path_token::kind::key && path->tokens[1].text == "b");
+        EXPECT_TRUE(path->tokens[2].type == path_token::kind::index && path->tokens[2].index == 3);
+        EXPECT_TRUE(path->tokens[3].type == path_token::kind::form && path->tokens[3].text == "Skyrim.esm" && path->tokens[3].form_id == 0x14);
+
+        // the segments are parsed up to the malformed one
+        auto malformed = path_resolving::compiled(".a[x].b");
+        EXPECT_FALSE(malformed->complete);
+        EXPECT_EQ(1u, malformed->tokens.size());
+
+        auto operation = path_resolving::compiled("@maxNum.value.k");
+        ASSERT_EQ(1u, operation->tokens.size());
+        EXPECT_TRUE(operation->tokens[0].type == path_token::kind::operation && operation->tokens[0].operation != nullptr);
+        EXPECT_EQ(std::string(".value.k"), operation->tokens[0].text);
+
+        // the path gets compiled once
+        auto& root = map::object(context);
+        EXPECT_TRUE(ca::assign_creative(root, ".cached.path[0]", 1));
+        EXPECT_TRUE(ca::assign_creative(root, ".cached.path[0]", 2));
+
+        const auto before = path_resolving::cache_statistics();
+        const int lookups = 100000;
+        int sum = 0;
+        util::do_with_timing("Path resolving, 100k lookups of the cached path", [&]() {
+            for (int i = 0; i < lookups; ++i) {
+                sum += path_resolving::_resolve<SInt32>(context, &root, ".cached.path[0]");
+            }
+        });
+        const auto after = path_resolving::cache_statistics();
+        EXPECT_EQ(2 * lookups, sum);
+        EXPECT_EQ(before.local_hits + lookups, after.local_hits);
+        EXPECT_EQ(before.misses, after.misses);
+    }
+
+    JC_TEST(path_resolving, allocations)
+    {
+        object_stack_ref root = json_deserializer::object_from_json_data(context, STR(
+            { "a": { "b": [1, 2, 3] }, "c": { "x": 5, "y": 10, "z": 1 } }
+        ));
+        ASSERT_TRUE(root);
+
+        const char *paths[] = { ".a.b[0]", ".a.b[-1]", ".c@maxNum.value", ".c.y", ".c@sum.value" };
+        const int expected[] = { 1, 3, 10, 10, 16 };
+        const int lookups = 100000;
+
+        for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+            // the first lookup compiles the path
+            EXPECT_EQ(expected[i], path_resolving::_resolve<SInt32>(context, root.get(), paths[i]));
+
+            int mismatches = 0;
+            uint64_t allocations = 0;
+            util::do_with_timing((std::string("Path resolving, 100k lookups of ") + paths[i]).c_str(), [&]() {
+                util::allocation_counter counter;
+                for (int n = 0; n < lookups; ++n) {
+                    mismatches += path_resolving::_resolve<SInt32>(context, root.get(), paths[i]) != expected[i];
+                }
+                allocations = counter.count();
+            });
+
+            EXPECT_EQ(0, mismatches);
+            JC_log("%s: %f allocations per resolve", paths[i], double(allocations) / lookups);
+            EXPECT_EQ(0u, allocations);
+        }
+
+        if (!util::allocation_counter::counted) {
+            JC_log("path_resolving.allocations: the allocations are not counted in this build");
+            return;
+        }
+
+        // the setters and the getters of the existing values don't copy the keys
+        map& m = *root->as<map>();
+        const char *longKeyPath = ".c.a_key_longer_than_the_short_string_buffer";
+        EXPECT_TRUE(ca::assign(m, longKeyPath, item(0), ca::creative));
+        uint64_t allocations = 0;
+        {
+            util::allocation_counter counter;
+            for (int n = 0; n < 1000; ++n) {
+                ca::assign(m, longKeyPath, item(n));
+                ca::get(m, longKeyPath);
+            }
+            allocations = counter.count();
+        }
+        EXPECT_EQ(0u, allocations);
+
+        // the allocations of a nested counter are counted by the outer one too
+        util::allocation_counter outer;
+        {
+            util::allocation_counter inner;
+            std::unique_ptr<int> p(new int(0));
+            EXPECT_EQ(1u, inner.count());
+        }
+        EXPECT_EQ(1u, outer.count());
+    }
+
+    JC_TEST(path_resolving, lock_order)
+    {
+        // the operator can't take the lock of an item's map while it holds the lock of the array:
+        // the busy map gets visited after the array lock is released
+        {
+            auto& arr = array::object(context);
+            for (int i = 1; i <= 3; ++i) {
+                auto& m = map::object(context);
+                m.set("x", item(i));
+                arr.push(item(m));
+            }
+
+            std::atomic<bool> locked{ false };
+            std::thread holder([&]() {
+                object_lock g(arr.get_item(1)->object());
+                locked = true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            });
+            while (!locked) {
+                std::this_thread::yield();
+            }
+            EXPECT_EQ(6, path_resolving::_resolve<SInt32>(context, &arr, "@sum.x"));
+            holder.join();
+        }
+
+        // the maps referencing each other, the threads walk the cycle in the opposite directions,
+        // the readers sharing the locks, the writers locking exclusively
+        auto& a = map::object(context);
+        auto& b = map::object(context);
+        auto& ring = array::object(context);
+        a.set("b", item(b));
+        a.set("n", item(1));
+        b.set("a", item(a));
+        b.set("n", item(2));
+        ring.push(item(a));
+        ring.push(item(b));
+
+        const int walks = 20000;
+        std::atomic<size_t> mismatches{ 0 };
+
+        auto walker = [&](object_base& from, const char *path, int expected, bool createMissingKeys) {
+            return std::thread([&, path, expected, createMissingKeys]() {
+                size_t wrong = 0;
+                for (int i = 0; i < walks; ++i) {
+                    int value = 0;
+                    path_resolving::resolve(context, &from, path, [&](item *itm) {
+                        value = itm ? itm->intValue() : 0;
+                    }, createMissingKeys);
+                    wrong += value != expected;
+                }
+                mismatches += wrong;
+            });
+        };
+
+        std::vector<std::thread> threads;
+        threads.push_back(walker(a, ".b.a.b.a.n", 1, false));
+        threads.push_back(walker(b, ".a.b.a.b.n", 2, false));
+        threads.push_back(walker(a, ".b.a.b.n", 2, true));
+        threads.push_back(walker(b, ".a.b.a.n", 1, true));
+        threads.push_back(walker(ring, "@sum.n", 3, false));
+        threads.push_back(walker(ring, "[0].b.a@sum.value.n", 2, false));
+        threads.push_back(std::thread([&]() {
+            for (int i = 0; i < walks; ++i) {
+                a.set("n", item(1));
+                b.set("n", item(2));
+            }
+        }));
+        for (auto& t : threads) {
+            t.join();
+        }
+        EXPECT_EQ(0u, mismatches.load());
+    }
+
+    JC_TEST(path_resolving, resolve_many)
+    {
+        object_stack_ref root = json_deserializer::object_from_json_data(context, STR(
+            { "npc": { "stats": { "hp": 100, "mp": 50, "sp": 25 }, "name": "Lydia", "items": [1, 2, { "count": 3 }] } }
+        ));
+        ASSERT_TRUE(root);
+
+        const char *paths[] = {
+            ".npc.stats.hp", ".npc.stats.mp", ".npc.stats.sp", ".npc.name", ".npc.items[2].count", ".npc.items[-3]",
+            ".npc.stats.missing", ".npc.missing.hp", ".npc.name.x", ".npc.stats@sum.value", ".npc.", "", nullptr, ".npc.stats.hp",
+        };
+        const size_t count = sizeof(paths) / sizeof(paths[0]);
+
+        auto check = [&]() {
+            std::vector<item> found(count);
+            std::vector<int> visits(count);
+            path_resolving::resolve_many(context, root.get(), paths, count, [&](size_t i, item *itm) {
+                ++visits[i];
+                found[i] = itm ? *itm : item("<null>");
+            });
+
+            for (size_t i = 0; i < count; ++i) {
+                item expected("<null>");
+                path_resolving::resolve(context, root.get(), paths[i], [&](item *itm) {
+                    expected = itm ? *itm : item("<null>");
+                });
+                EXPECT_EQ(1, visits[i]);
+                EXPECT_TRUE(found[i] == expected);
+            }
+            EXPECT_TRUE(found[0] == 100 && found[4] == 3 && found[9] == 175);
+        };
+
+        check();
+
+        // a busy subtree gets walked once the lock of the collection above it is released
+        object_base *stats = path_resolving::_resolve<object_base*>(context, root.get(), ".npc.stats");
+        ASSERT_TRUE(stats != nullptr);
+        std::atomic<bool> locked{ false };
+        std::thread holder([&]() {
+            object_lock g(stats);
+            locked = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        });
+        while (!locked) {
+            std::this_thread::yield();
+        }
+        check();
+        holder.join();
+    }
+
+    JC_TEST(array, field_index)
+    {
+        object_stack_ref root = json_deserializer::object_from_json_data(context, STR(
+            [{ "name": "Lydia", "level": 10 }, { "name": "Faendal", "level": 5 }, { "name": "lydia", "level": 20 }, 7, { "level": 5 }]
+        ));
+        ASSERT_TRUE(root);
+        array& arr = *root->as<array>();
+
+        auto find = [&](const char *path, const item& value) {
+            return array_functions::find_by_index(context, arr, path, value);
+        };
+        auto named = [&](const char *name) {
+            auto& obj = map::object(context);
+            obj.u_set("name", item(name));
+            return item(obj);
+        };
+        auto isCurrent = [&](const char *path) {
+            object_read_lock g(&arr);
+            auto index = arr.u_field_index(path);
+            return index && index->u_is_current();
+        };
+
+        // no index - all the items get checked
+        EXPECT_EQ(1, find(".name", item("Faendal")));
+
+        array_functions::create_index(context, arr, ".name");
+        array_functions::create_index(context, arr, ".level");
+        EXPECT_TRUE(isCurrent(".name") && isCurrent(".level"));
+
+        EXPECT_EQ(0, find(".name", item("LYDIA")));
+        EXPECT_EQ(1, find(".level", item(5)));
+        EXPECT_EQ(-1, find(".level", item(5.f)));
+        EXPECT_EQ(-1, find(".name", item("Aela")));
+
+        // the positions follow the insertions, erasures and replacements
+        {
+            object_lock g(&arr);
+            arr.u_push(named("Aela"));
+            arr.u_insert(0, named("Serana"));
+        }
+        EXPECT_FALSE(isCurrent(".name"));
+        EXPECT_EQ(0, find(".name", item("Serana")));
+        EXPECT_EQ(2, find(".name", item("Faendal")));
+        EXPECT_EQ(6, find(".name", item("Aela")));
+        EXPECT_TRUE(isCurrent(".name"));
+
+        {
+            object_lock g(&arr);
+            arr.u_erase(0, 1);
+            arr.u_replace(1, named("Mjoll"));
+        }
+        EXPECT_EQ(-1, find(".name", item("Faendal")));
+        EXPECT_EQ(1, find(".name", item("Mjoll")));
+        EXPECT_EQ(5, find(".name", item("Aela")));
+        EXPECT_EQ(4, find(".level", item(5)));
+
+        // the values inside of the items are not watched: a changed item is not found by its old value,
+        // a miss of the index is checked against all the items. The changed items found so get indexed again
+        auto rename = [&](int32_t index, const char *name) {
+            object_base *obj = arr.get_item(index)->object();
+            object_lock g(obj);
+            obj->as<map>()->u_set("name", item(name));
+        };
+        rename(0, "Uthgerd");
+        EXPECT_EQ(2, find(".name", item("Lydia")));
+        EXPECT_FALSE(isCurrent(".name"));
+        EXPECT_EQ(0, find(".name", item("Uthgerd")));
+        EXPECT_TRUE(isCurrent(".name"));
+
+        rename(1, "Brelyna");
+        EXPECT_EQ(1, find(".name", item("Brelyna")));
+        EXPECT_FALSE(isCurrent(".name"));
+        EXPECT_EQ(-1, find(".name", item("Mjoll")));
+        EXPECT_EQ(1, find(".name", item("brelyna")));
+        EXPECT_TRUE(isCurrent(".name"));
+
+        array_functions::create_index(context, arr, ".name");
+        EXPECT_EQ(0, find(".name", item("Uthgerd")));
+        {
+            object_lock g(&arr);
+            arr.u_swap_items(0, 2);
+        }
+        EXPECT_EQ(2, find(".name", item("Uthgerd")));
+        EXPECT_EQ(0, find(".name", item("lydia")));
+
+        {
+            object_lock g(&arr);
+            arr.u_clear();
+        }
+        EXPECT_EQ(-1, find(".name", item("lydia")));
+        EXPECT_TRUE(isCurrent(".name"));
+    }
+
     JC_TEST(json_deserializer, test)
     {
         EXPECT_NIL(json_deserializer::object_from_file(context, ""));
@@ -591,6 +1352,70 @@ namespace collections { namespace {
         EXPECT_TRUE(context.collect_garbage() == arrays.size());
         EXPECT_TRUE(context.collect_garbage() == 0);
     }
+
+    JC_TEST(garbage_collection, incremental)
+    {
+        // a cycle nothing else references
+        auto& a = array::object(context);
+        auto& b = array::object(context);
+        a.push(&b);
+        b.push(&a);
+
+        // a cycle referenced by the retained object
+        auto& root = array::object(context);
+        root.tes_retain();
+        auto& c = array::object(context);
+        auto& d = array::object(context);
+        root.push(&c);
+        c.push(&d);
+        d.push(&c);
+
+        EXPECT_EQ(2u, context.collect_garbage_incrementally());
+        EXPECT_EQ(1, c.s_count());
+        EXPECT_EQ(1, d.s_count());
+        EXPECT_EQ(1, root.s_count());
+
+        // the first cycle has broken a-b cycle, the rest of it is owned by the aqueue now
+        EXPECT_EQ(0u, context.collect_garbage_incrementally());
+
+        auto stats = context.collector_statistics();
+        EXPECT_TRUE(stats.cycles >= 2);
+        EXPECT_TRUE(stats.reclaimed >= 2);
+        EXPECT_TRUE(stats.max_pause_us >= stats.last_pause_us);
+    }
+
+    JC_TEST(garbage_collection, incremental_large_containers)
+    {
+        // the containers much larger than a part of the visit (see incremental_collector::u_visit)
+        const int count = 20000;
+
+        // the garbage: the array and the map reference each other, the items of the array reference the array
+        auto& arr = array::object(context);
+        auto& m = map::object(context);
+        arr.push(&m);
+        m.set("array", &arr);
+        for (int i = 0; i < count; ++i) {
+            auto& elem = array::object(context);
+            elem.push(&arr);
+            arr.push(&elem);
+        }
+
+        // the same, but referenced by the retained object
+        auto& root = array::object(context);
+        root.tes_retain();
+        auto& kept = map::object(context);
+        root.push(&kept);
+        for (int i = 0; i < count; ++i) {
+            auto& elem = array::object(context);
+            elem.push(&kept);
+            kept.set("key" + std::to_string(i), &elem);
+        }
+
+        EXPECT_EQ(size_t(count + 2), context.collect_garbage_incrementally());
+        EXPECT_EQ(count, kept.s_count());
+        EXPECT_EQ(1, kept.findOrDef("key0").object()->s_count());
+        EXPECT_EQ(1, kept.findOrDef("key" + std::to_string(count - 1)).object()->s_count());
+    }
 }
 }
 
@@ -706,6 +1531,327 @@ namespace collections { namespace {
         EXPECT_TRUE(allDestroyed(privateIds));
     }
 
+    JC_TEST(autorelease_queue, moves_between_buckets)
+    {
+        const size_t countBefore = context.aqueueSize();
+        std::vector<Handle> kept, dropped;
+
+        for (int i = 0; i < 100; ++i) {
+            auto& keep = map::make(context);
+            kept.push_back(keep.uid()); // public, lives for ~10 seconds
+            keep.zero_lifetime();
+            keep.prolong_lifetime();
+
+            auto& drop = map::make(context);
+            dropped.push_back(drop.uid());
+            drop.prolong_lifetime();
+            drop.zero_lifetime(); // the next tick releases it
+        }
+        // the objects were moved, not queued twice
+        EXPECT_EQ(countBefore + 200, context.aqueueSize());
+
+        std::this_thread::sleep_for(std::chrono::seconds(3));
+        EXPECT_TRUE(std::all_of(kept.begin(), kept.end(), [&](Handle id) { return context.getObject(id) != nullptr; }));
+        EXPECT_TRUE(std::none_of(dropped.begin(), dropped.end(), [&](Handle id) { return context.getObject(id) != nullptr; }));
+        EXPECT_EQ(countBefore + 100, context.aqueueSize());
+    }
+
+    JC_TEST(object_pools, occupancy)
+    {
+        auto mapsInUse = [&]() { return context.pools.u_statistics(CollectionType::Map).cells_in_use; };
+
+        const size_t before = mapsInUse();
+        {
+            auto& root = map::object(context);
+            context.set_root(&root);
+            object_lock g(root);
+            for (int i = 0; i < 1000; ++i) {
+                root.u_set(std::to_string(i).c_str(), map::object(context));
+            }
+        }
+        EXPECT_EQ(before + 1001, mapsInUse());
+
+        auto stats = context.pools.u_statistics(CollectionType::Map);
+        EXPECT_TRUE(stats.cell_size >= sizeof(map));
+        EXPECT_TRUE(stats.cells_total >= stats.cells_in_use);
+        EXPECT_TRUE(stats.slabs > 0);
+
+        // the loaded objects get into the pools too
+        auto state = context.write_to_string();
+        context.read_from_string(state);
+        EXPECT_EQ(1001u, mapsInUse());
+        EXPECT_EQ(1001u, context.object_count());
+
+        context.clearState();
+        stats = context.pools.u_statistics(CollectionType::Map);
+        EXPECT_EQ(0u, stats.cells_in_use);
+        EXPECT_EQ(0u, stats.slabs);
+    }
+
+    // runs work(threadIndex) on threadCount threads at once and logs the time taken
+    template<class Work>
+    void run_threads(const std::string& name, unsigned threadCount, Work&& work) {
+        util::do_with_timing((name + ", " + std::to_string(threadCount) + " threads").c_str(), [&]() {
+            std::vector<std::thread> threads;
+            for (unsigned t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&work, t]() { work(t); });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        });
+    }
+
+    // The benchmarks are disabled, --gtest_also_run_disabled_tests runs them.
+    // They only log the timings: how the threads scale depends on the machine.
+    // Runs the work on 1, 2, 4 and 8 threads, returns the number of threads run in total
+    template<class Work>
+    unsigned benchmark_threads(const std::string& name, Work&& work) {
+        unsigned total = 0;
+        for (unsigned threadCount : { 1u, 2u, 4u, 8u }) {
+            run_threads(name, threadCount, work);
+            total += threadCount;
+        }
+        return total;
+    }
+
+    JC_TEST(object_registry, concurrent_lookups)
+    {
+        const int objectCount = 1024;
+        const int lookupsPerThread = 20000;
+        const unsigned threadCount = 4;
+
+        std::vector<object_stack_ref> objects;
+        for (int i = 0; i < objectCount; ++i) {
+            objects.push_back(&map::object(context));
+        }
+
+        std::atomic<size_t> found{ 0 };
+        run_threads("Handle lookups", threadCount, [&](unsigned t) {
+            size_t hits = 0;
+            for (int i = 0; i < lookupsPerThread; ++i) {
+                const auto& obj = objects[(i * 7 + t * 128) % objectCount];
+                hits += context.getObjectRef(obj->uid()).get() == obj.get() ? 1 : 0;
+            }
+            found += hits;
+        });
+        EXPECT_EQ(size_t(threadCount) * lookupsPerThread, found.load());
+    }
+
+    JC_TEST_DISABLED(object_registry, concurrent_lookups_benchmark)
+    {
+        // the same handles looked up from several threads: the lock-free handle table
+        // against a hash map guarded by a reader-writer lock, the way the lookups were done before
+        const int objectCount = 4096;
+        const int lookupsPerThread = 1000000;
+
+        std::vector<object_stack_ref> objects;
+        std::vector<Handle> handles;
+        std::unordered_map<Handle, object_base *> lockedMap;
+        bshared_mutex mutex;
+
+        for (int i = 0; i < objectCount; ++i) {
+            auto& obj = map::object(context);
+            objects.push_back(&obj);
+            handles.push_back(obj.uid());
+            lockedMap[obj.uid()] = &obj;
+        }
+
+        auto run = [&](const char *name, auto&& lookup) {
+            std::atomic<size_t> found{ 0 };
+            const unsigned threadsRun = benchmark_threads(name, [&](unsigned t) {
+                size_t hits = 0;
+                for (int i = 0; i < lookupsPerThread; ++i) {
+                    hits += lookup(handles[(i * 7 + t * 512) % objectCount]) ? 1 : 0;
+                }
+                found += hits;
+            });
+            EXPECT_EQ(size_t(threadsRun) * lookupsPerThread, found.load());
+        };
+
+        run("Handle lookups, lock-free", [&](Handle hdl) {
+            return context.getObjectRef(hdl);
+        });
+        run("Handle lookups, read lock", [&](Handle hdl) -> object_stack_ref {
+            read_lock g(mutex);
+            auto itr = lockedMap.find(hdl);
+            return itr != lockedMap.end() ? itr->second : nullptr;
+        });
+    }
+
+    JC_TEST(object_base, deferred_stack_refs)
+    {
+        auto& hot = map::object(context);
+        hot.tes_retain();
+
+        {
+            deferred_stack_refs::scope scope;
+            object_stack_ref a = &hot;
+            {
+                object_stack_ref b = &hot, c = &hot;
+                EXPECT_EQ(1, hot._stack_refCount.load()); // the single shared reference of the thread
+            }
+            a = nullptr;
+            EXPECT_EQ(1, hot._stack_refCount.load()); // gets returned once the scope ends
+        }
+        EXPECT_EQ(0, hot._stack_refCount.load());
+
+        object_stack_ref outer;
+        {
+            deferred_stack_refs::scope scope;
+            outer = &hot;
+        }
+        EXPECT_EQ(1, hot._stack_refCount.load()); // the reference outlives the scope
+        outer = nullptr;
+        EXPECT_EQ(0, hot._stack_refCount.load());
+    }
+
+    JC_TEST_DISABLED(object_base, deferred_stack_refs_benchmark)
+    {
+        auto& hot = map::object(context);
+        hot.tes_retain();
+
+        // the native calls taking the nested references to the same object, the way path resolution does
+        const int callsPerThread = 200000;
+        const int refsPerCall = 8;
+
+        auto call = [&]() {
+            object_stack_ref refs[refsPerCall];
+            for (auto& ref : refs) {
+                ref = &hot;
+            }
+        };
+
+        benchmark_threads("Stack references, deferred", [&](unsigned) {
+            for (int i = 0; i < callsPerThread; ++i) {
+                deferred_stack_refs::scope scope;
+                call();
+            }
+        });
+        EXPECT_EQ(0, hot._stack_refCount.load());
+
+        benchmark_threads("Stack references, atomic", [&](unsigned) {
+            for (int i = 0; i < callsPerThread; ++i) {
+                call();
+            }
+        });
+        EXPECT_EQ(0, hot._stack_refCount.load());
+    }
+
+    TEST(spinlock, contention_counters)
+    {
+        util::counting_spinlock lock;
+        const int threadCount = 4;
+        const int increments = 100000;
+        int counter = 0;
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&]() {
+                for (int i = 0; i < increments; ++i) {
+                    util::counting_spinlock::guard g(lock);
+                    ++counter;
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        auto stats = lock.statistics();
+        EXPECT_EQ(threadCount * increments, counter);
+        EXPECT_EQ(uint64_t(threadCount * increments), stats.acquisitions);
+        EXPECT_TRUE(stats.contended <= stats.acquisitions);
+
+        // the lock held for long: the waiter ends up sleeping rather than spinning
+        const auto before = lock.statistics();
+        const auto globalBefore = util::spinlock_global_statistics();
+        std::thread waiter;
+        {
+            util::counting_spinlock::guard g(lock);
+            waiter = std::thread([&]() { util::counting_spinlock::guard g(lock); });
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+        waiter.join();
+
+        const auto after = lock.statistics();
+        EXPECT_EQ(before.contended + 1, after.contended);
+        EXPECT_TRUE(after.parks > before.parks);
+
+        // the waiter counted into its own thread's counters, kept after the thread exited
+        const auto globalAfter = util::spinlock_global_statistics();
+        EXPECT_TRUE(globalAfter.contended >= globalBefore.contended + 1);
+        EXPECT_TRUE(globalAfter.parks > globalBefore.parks);
+    }
+
+    JC_TEST(object_base, shared_reads)
+    {
+        // the reads of the same map and array don't wait for each other
+        auto& m = map::object(context);
+        m.u_set("key", item(1));
+        auto& arr = array::object(context);
+        arr.u_push(item(1));
+        arr.u_push(item(2));
+        {
+            object_read_lock first(m);
+            std::thread([&]() { EXPECT_TRUE(m.findOrDef("key") == item(1)); }).join();
+        }
+        {
+            object_read_lock first(arr);
+            std::thread([&]() { EXPECT_TRUE(arr.get_item(-1) == item(2)); }).join();
+        }
+    }
+
+    JC_TEST_DISABLED(object_base, shared_reads_benchmark)
+    {
+        // a popular map read by 8 threads while another one keeps writing into it:
+        // the shared lock against the exclusive one, the way the reads were done before
+        auto& m = map::object(context);
+        const int keyCount = 1024;
+        const int readsPerThread = 200000;
+        const unsigned readerCount = 8;
+
+        std::vector<std::string> keys, writtenKeys;
+        for (int i = 0; i < keyCount; ++i) {
+            keys.push_back("key_" + std::to_string(i));
+            writtenKeys.push_back("written_" + std::to_string(i));
+            m.set(keys.back(), item(i));
+            m.set(writtenKeys.back(), item(0));
+        }
+
+        auto run = [&](const char *name, auto&& lookup) {
+            std::atomic<unsigned> readersLeft{ readerCount };
+            std::atomic<size_t> mismatches{ 0 };
+            // the last thread is the writer
+            run_threads(name, readerCount + 1, [&](unsigned t) {
+                if (t == readerCount) {
+                    for (int i = 0; readersLeft.load(std::memory_order_relaxed) != 0; ++i) {
+                        m.set(writtenKeys[i % keyCount], item(i));
+                    }
+                    return;
+                }
+                size_t wrong = 0;
+                for (int i = 0; i < readsPerThread; ++i) {
+                    const int k = (i * 7 + t * 128) % keyCount;
+                    wrong += lookup(keys[k]) == item(k) ? 0 : 1;
+                }
+                mismatches += wrong;
+                --readersLeft;
+            });
+            EXPECT_EQ(0u, mismatches.load());
+        };
+
+        run("Map reads, 8 readers 1 writer, shared lock", [&](const std::string& key) {
+            return m.findOrDef(key);
+        });
+        run("Map reads, 8 readers 1 writer, exclusive lock", [&](const std::string& key) {
+            object_lock g(m);
+            auto itm = m.u_get(key);
+            return itm ? *itm : item();
+        });
+        EXPECT_EQ(keyCount * 2, m.u_count());
+    }
+
     JC_TEST(deadlock, _)
     {
         auto& obj = map::object(context);
@@ -128,24 +128,16 @@ inline std::optional<FormId> form_from_file (std::string_view const& file, std::
 //--------------------------------------------------------------------------------------------------
 
 /**
- * Deduce a form identifier out of proper string.
- *
- * Several options are available:
- *
- * * `__formData|<mod name>|<relative id>`
- *   Search for mod name form prefix and append the given relative, 24-bit for esp/esm and
- *   12-bit for esl, identifier. Any incoming id bits in the place of the mod bits will be
- *   ignored (e.g. `__formData|test.esl|0x006780004` is about form #4).
+ * Splits a form string into the mod name and the relative form identifier.
  *
- * * `__formData||<dynamic form id>`
- *   Same as above, but as the mod name is missing, assume the form identifier is about dynamic
- *   forms. In practice the most significant bits will be set always.
+ * The string is not resolved, so the result can be kept around and resolved later with
+ * `form_from_file` - the mod indexes may differ between the game sessions.
  *
- * @param pstr - can be nullptr or empty too. Assumed it is alive during the duration of this call.
- * @return optional absolute form identifier, converted from the passed string.
+ * @param pstr - can be nullptr or empty too. The returned mod name points into it.
+ * @return optional pair of mod name (empty for dynamic forms) and the form identifier.
  */
 
-inline std::optional<FormId> string_to_form (const char* pstr)
+inline std::optional<std::pair<std::string_view, std::uint32_t>> split_form_string (const char* pstr)
 {
     using namespace std;
 
@@ -174,7 +166,35 @@ inline std::optional<FormId> string_to_form (const char* pstr)
         return nullopt;
     }
 
-    return form_from_file (mod, form);
+    return make_pair (mod, form);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Deduce a form identifier out of proper string.
+ *
+ * Several options are available:
+ *
+ * * `__formData|<mod name>|<relative id>`
+ *   Search for mod name form prefix and append the given relative, 24-bit for esp/esm and
+ *   12-bit for esl, identifier. Any incoming id bits in the place of the mod bits will be
+ *   ignored (e.g. `__formData|test.esl|0x006780004` is about form #4).
+ *
+ * * `__formData||<dynamic form id>`
+ *   Same as above, but as the mod name is missing, assume the form identifier is about dynamic
+ *   forms. In practice the most significant bits will be set always.
+ *
+ * @param pstr - can be nullptr or empty too. Assumed it is alive during the duration of this call.
+ * @return optional absolute form identifier, converted from the passed string.
+ */
+
+inline std::optional<FormId> string_to_form (const char* pstr)
+{
+    if (auto split = split_form_string (pstr))
+        return form_from_file (split->first, split->second);
+
+    return std::nullopt;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -103,6 +103,20 @@ namespace forms {
             _watched_form.swap(other._watched_form);
         }
 
+        // The collections::item keeps a form by the plain pointer to its entry, as the form_ref doesn't fit the item.
+        // The item references of the entry keep the entry alive (see form_entry::retain_item_ref).
+        // The null form_ref has no entry, the functions accept the null entry
+
+        // adds an item reference to the entry of the form_ref
+        form_entry* retain_entry() const;
+        // adds one more item reference to the @entry, which has one already
+        static void add_entry_ref(form_entry *entry);
+        static void release_entry(form_entry *entry);
+        // the form_ref of the @entry which has an item reference
+        static form_ref of_entry(form_entry *entry);
+        // the same as the get() of the form_ref of the @entry
+        static FormId entry_id(const form_entry *entry);
+
         struct stable_less_comparer;
 
         friend class boost::serialization::access;
@@ -41,6 +41,16 @@ namespace forms {
         // to not release it if the handle wasn't be previously retained (for ex. handle's object was not loaded)
         bool _is_handle_retained = false;
 
+        // The references of the items (see form_ref::retain_entry). While there are any, the entry owns itself.
+        // The count changes without the lock, unless it goes from zero or to zero: these changes set or reset the @_self
+        std::atomic<uint32_t> _item_refs{ 0 };
+        form_entry_ref _self;
+
+        boost::detail::spinlock& item_refs_lock() const {
+            using spinlock_pool = boost::detail::spinlock_pool < 'FeIR' >;
+            return spinlock_pool::spinlock_for(this);
+        }
+
     public:
 
         form_entry(FormId handle, bool deleted, bool handle_was_retained)
@@ -73,6 +83,46 @@ namespace forms {
 
         FormId id() const { return _handle; }
 
+        // @self is the reference the caller holds
+        void retain_item_ref(const form_entry_ref& self) {
+            uint32_t refs = _item_refs.load(std::memory_order_relaxed);
+            while (refs != 0) {
+                if (_item_refs.compare_exchange_weak(refs, refs + 1, std::memory_order_relaxed)) {
+                    return;
+                }
+            }
+            std::lock_guard<boost::detail::spinlock> guard{ item_refs_lock() };
+            if (_item_refs.fetch_add(1, std::memory_order_acq_rel) == 0) {
+                _self = self;
+            }
+        }
+
+        // the caller holds an item reference already
+        void add_item_ref() {
+            _item_refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void release_item_ref() {
+            uint32_t refs = _item_refs.load(std::memory_order_relaxed);
+            while (refs > 1) {
+                if (_item_refs.compare_exchange_weak(refs, refs - 1, std::memory_order_release)) {
+                    return;
+                }
+            }
+            form_entry_ref last; // may delete the entry once released, after the lock
+            {
+                std::lock_guard<boost::detail::spinlock> guard{ item_refs_lock() };
+                if (_item_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    last.swap(_self);
+                }
+            }
+        }
+
+        // valid while the caller holds an item reference: the @_self doesn't change then
+        const form_entry_ref& item_refs_owner() const {
+            return _self;
+        }
+
         bool is_deleted() const {
             return _deleted.load(std::memory_order_acquire);
         }
@@ -341,6 +391,33 @@ namespace forms {
         return _watched_form ? _watched_form->id() : FormId::Zero;
     }
 
+    form_entry* form_ref::retain_entry() const {
+        if (_watched_form) {
+            _watched_form->retain_item_ref(_watched_form);
+        }
+        return _watched_form.get();
+    }
+
+    void form_ref::add_entry_ref(form_entry *entry) {
+        if (entry) {
+            entry->add_item_ref();
+        }
+    }
+
+    void form_ref::release_entry(form_entry *entry) {
+        if (entry) {
+            entry->release_item_ref();
+        }
+    }
+
+    form_ref form_ref::of_entry(form_entry *entry) {
+        return entry ? form_ref{ entry->item_refs_owner() } : form_ref{};
+    }
+
+    FormId form_ref::entry_id(const form_entry *entry) {
+        return entry && !entry->is_deleted() ? entry->id() : FormId::Zero;
+    }
+
     template<class Archive>
     void form_ref::save(Archive & ar, const unsigned int version) const
     {
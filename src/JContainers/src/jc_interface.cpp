@@ -3,6 +3,7 @@
 #include "util/istring.h"
 #include "reflection/reflection.h"
 #include "domains/domain_master.h"
+#include "collections/access.h"
 
 namespace jc { namespace {
 
@@ -26,6 +27,57 @@ namespace jc { namespace {
         }
     };
 
+    const path_interface path = {
+        path_interface::version,
+        [](void *domain, int32_t object, const char *const *paths, uint32_t count,
+            void (*visitor)(void *user_data, uint32_t index, const path_value *value), void *user_data)
+        {
+            using namespace collections;
+
+            if (!domain || !visitor) {
+                return;
+            }
+
+            auto& context = *static_cast<tes_context *>(domain);
+            object_stack_ref obj = context.getObjectRef(static_cast<Handle>(object));
+
+            // the visitor gets called outside of the locks, the found items keep the objects and the strings alive
+            std::vector<boost::optional<item>> found(count);
+            path_resolving::resolve_many(context, obj.get(), paths, count, [&](size_t i, item *itm) {
+                if (itm) {
+                    found[i] = *itm;
+                }
+            });
+
+            for (uint32_t i = 0; i < count; ++i) {
+                path_value value = {};
+                value.type = found[i] ? found[i]->type() : item_type::no_item;
+                if (found[i]) {
+                    const item& itm = *found[i];
+                    switch (itm.type()) {
+                    case item_type::integer:
+                        value.integer = itm.intValue();
+                        break;
+                    case item_type::real:
+                        value.real = itm.fltValue();
+                        break;
+                    case item_type::form:
+                        value.form = static_cast<uint32_t>(itm.formId());
+                        break;
+                    case item_type::object:
+                        value.object = static_cast<int32_t>(itm.readAs<Handle>());
+                        break;
+                    case item_type::string:
+                        value.string = itm.strValue();
+                        break;
+                    default:
+                        break;
+                    }
+                }
+                visitor(user_data, i, &value);
+            }
+        }
+    };
 
     const void * query_interface(uint32_t id) {
         switch (id) {
@@ -33,6 +85,8 @@ namespace jc { namespace {
             return &refl;
         case domain_interface::type_id:
             return &dom;
+        case path_interface::type_id:
+            return &path;
         }
         return nullptr;
     }
@@ -55,4 +55,31 @@ namespace jc {
         void * (*get_domain_with_name)(const char *domain_name);
 
     };
+
+    // the value at a path, see path_interface
+    struct path_value {
+        uint32_t type;              // the JValue.valueType codes: 0 - no value, 1 - none, 2 - int, 3 - float, 4 - form, 5 - object, 6 - string
+        union {
+            int32_t integer;
+            float real;
+            uint32_t form;          // the form id
+            int32_t object;         // the object handle, as the Papyrus functions see it
+            const char *string;     // valid during the visitor call only
+        };
+    };
+
+    struct path_interface {
+
+        enum {
+            type_id = 3,
+            version = 1,
+        };
+
+        uint32_t current_version;
+
+        // Resolves the @count paths of the object (see JValue.solveMany): the visitor gets called once per path
+        // with the path's index. The domain is the one of the domain_interface, the object is the object handle
+        void (*solve_many)(void *domain, int32_t object, const char *const *paths, uint32_t count,
+            void (*visitor)(void *user_data, uint32_t index, const path_value *value), void *user_data);
+    };
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <array>
 #include <deque>
 #include <boost\serialization\version.hpp>
 #include <boost\asio\io_service.hpp>
@@ -53,6 +54,11 @@ namespace collections {
     class object_registry;
 
     // The purpose of autorelease_queue (aqueue) is to temporarily own an object and increase an object's lifetime
+    //
+    // The objects are kept in a timing wheel: a bucket per tick of the object's lifetime, the object is in the bucket
+    // of the tick its lifetime expires at. A tick releases the objects of a single bucket and moves the wheel forward,
+    // prolonging the lifetime moves the object into another bucket. Both are independent of the amount of objects in the queue.
+    // The object knows its bucket and its index in the bucket (see object_base::_aqueue_bucket).
     class autorelease_queue : boost::noncopyable {
     public:
         typedef std::lock_guard<bshared_mutex> lock;
@@ -69,20 +75,37 @@ namespace collections {
         };
 
         typedef boost::intrusive_ptr_jc<object_base, object_lifetime_policy> queue_object_ref;
-        typedef std::deque<queue_object_ref> queue;
+        typedef std::vector<queue_object_ref> bucket;
+
+        enum {
+            obj_lifetime = 10, // seconds
+            tick_duration = 2, // seconds, interval between ticks, interval between aqueue tests its objects for should-be-released state,
+            // and releases if needed
+            one_tick = 1, // em, one tick is one tick..
+        };
+
+        enum {
+            obj_lifeInTicks = obj_lifetime / tick_duration, // object's lifetime described in amount-of-ticks
+        };
+
+        enum : uint32_t {
+            no_bucket = ~0u,
+        };
 
     private:
 
         object_registry& _registry;
-        queue _queue;
+        std::array<bucket, obj_lifeInTicks> _wheel;
+        uint32_t _wheelPosition = 0; // the bucket the next tick releases
+        size_t _count = 0;
         time_point _tickCounter;
-        spinlock _queue_mutex;
+        util::counting_spinlock _queue_mutex;
         
         boost::asio::deadline_timer _timer;
         std::mutex _timer_mutex;
         bool _timer_stopped = true;
         // reusable array for temp objects
-        std::vector<queue_object_ref> _toRelease;
+        bucket _toRelease;
 
     public:
 
@@ -90,18 +113,30 @@ namespace collections {
             stop();
             
             _tickCounter = 0;
-            _queue.clear();
+            for (auto& b : _wheel) {
+                b.clear();
+            }
+            _wheelPosition = 0;
+            _count = 0;
             _toRelease.clear();
         }
 
         friend class boost::serialization::access;
         BOOST_SERIALIZATION_SPLIT_MEMBER();
 
+        // The buckets are not saved, the objects are: an object's bucket is defined by its _aqueue_push_time
         template<class Archive>
         void save(Archive & ar, const unsigned int version) const {
-            jc_assert(version == 2);
+            jc_assert(version == 3);
             ar & _tickCounter;
-            ar & _queue;
+
+            uint32_t count = static_cast<uint32_t>(_count);
+            ar & count;
+            for (const auto& b : _wheel) {
+                for (const auto& ref : b) {
+                    ar & ref;
+                }
+            }
         }
 
         template<class Archive>
@@ -109,18 +144,37 @@ namespace collections {
             ar & _tickCounter;
 
             switch (version) {
-            case 2:
-                ar & _queue;
+            case 3: {
+                uint32_t count = 0;
+                ar & count;
+                for (uint32_t i = 0; i < count; ++i) {
+                    queue_object_ref ref;
+                    ar & ref;
+                    if (ref.get()) {
+                        u_insert(std::move(ref));
+                    }
+                }
+                break;
+            }
+            case 2: {
+                std::deque<queue_object_ref> old;
+                ar & old;
+                for (auto& ref : old) {
+                    if (ref.get()) {
+                        u_insert(std::move(ref));
+                    }
+                }
                 break;
+            }
             case 1: {
                 typedef std::deque<std::pair<queue_object_ref, time_point> > queue_old;
                 queue_old old;
                 ar & old;
-                for (const auto& pair : old) {
+                for (auto& pair : old) {
                     auto object = pair.first.get();
                     if (object) {
-                        _queue.push_back(std::move(pair.first));
                         object->_aqueue_push_time = pair.second;
+                        u_insert(std::move(pair.first));
                     }
                 }
                 break;
@@ -132,8 +186,8 @@ namespace collections {
                 for (const auto& pair : old) {
                     auto object = _registry.u_getObject(pair.first);
                     if (object) {
-                        _queue.push_back(object);
                         object->_aqueue_push_time = pair.second;
+                        u_insert(object);
                     }
                 }
                 break;
@@ -146,7 +200,6 @@ namespace collections {
 
         explicit autorelease_queue(object_registry& registry) 
             : _registry(registry)
-            , _queue()
             , _tickCounter(0)
             , _timer(detail::g_background_worker.get()._io)
         {
@@ -158,33 +211,41 @@ namespace collections {
         void prolong_lifetime(object_base& object, bool isPublic) {
             //jc_debug("aqueue: added id - %u as %s", object._uid(), isPublic ? "public" : "private");
 
-            spinlock::guard g(_queue_mutex);
+            util::counting_spinlock::guard g(_queue_mutex);
             object._aqueue_push_time = isPublic ? _tickCounter : time_subtract(_tickCounter, obj_lifeInTicks);
-            if (!object.is_in_aqueue()) {
-                _queue.push_back(&object);
+            if (object._aqueue_bucket != no_bucket) {
+                u_move(object);
+            }
+            else {
+                // the object is either not in the queue or is being released by the @tick
+                u_insert(&object);
             }
         }
 
         void not_prolong_lifetime(object_base& object) {
             if (object.is_in_aqueue()) {
                 //jc_debug("aqueue: removed id - %u", object._uid());
-                spinlock::guard g(_queue_mutex);
+                util::counting_spinlock::guard g(_queue_mutex);
                 object._aqueue_push_time = time_subtract(_tickCounter, obj_lifeInTicks);
+                if (object._aqueue_bucket != no_bucket) {
+                    u_move(object);
+                }
             }
         }
 
         // amount of objects in queue
         size_t count() {
-            spinlock::guard g(_queue_mutex);
+            util::counting_spinlock::guard g(_queue_mutex);
             return u_count();
         }
 
-        queue& u_queue() {
-            return _queue;
+        size_t u_count() const {
+            return _count;
         }
 
-        size_t u_count() const {
-            return _queue.size();
+        // the contention of the queue's lock
+        util::spinlock_statistics lock_statistics() const {
+            return _queue_mutex.statistics();
         }
 
         // starts asynchronouos aqueue run, asynchronouosly releases objects when their time comes, starts timers, 
@@ -207,8 +268,10 @@ namespace collections {
         }
 
         void u_nullify() {
-            for (auto &ref : _queue) {
-                ref.jc_nullify();
+            for (auto& b : _wheel) {
+                for (auto& ref : b) {
+                    ref.jc_nullify();
+                }
             }
         }
 
@@ -245,20 +308,59 @@ namespace collections {
             return time_subtract(_tickCounter, time);
         }
 
-    public:
+    private:
 
-        enum {
-            obj_lifetime = 10, // seconds
-            tick_duration = 2, // seconds, interval between ticks, interval between aqueue tests its objects for should-be-released state,
-            // and releases if needed
-            one_tick = 1, // em, one tick is one tick..
-        };
+        // the number of ticks to pass before the object gets released, 0 means the next tick releases it
+        uint32_t u_ticks_left(const object_base& object) const {
+            // the next tick releases the object if (_tickCounter - _aqueue_push_time + 1) >= obj_lifeInTicks
+            const time_point lived = lifetimeDiff(object._aqueue_push_time);
+            return lived >= obj_lifeInTicks - 1 ? 0 : (obj_lifeInTicks - 1) - lived;
+        }
 
-        enum {
-            obj_lifeInTicks = obj_lifetime / tick_duration, // object's lifetime described in amount-of-ticks
-        };
+        uint32_t u_bucket_for(const object_base& object) const {
+            return (_wheelPosition + u_ticks_left(object)) % obj_lifeInTicks;
+        }
 
-    private:
+        void u_link(queue_object_ref&& ref, uint32_t bucketIdx) {
+            bucket& b = _wheel[bucketIdx];
+            ref->_aqueue_bucket = bucketIdx;
+            ref->_aqueue_position = static_cast<uint32_t>(b.size());
+            b.push_back(std::move(ref));
+        }
+
+        // takes the object out of its bucket, the last object of the bucket takes its place
+        queue_object_ref u_unlink(object_base& object) {
+            bucket& b = _wheel[object._aqueue_bucket];
+            const uint32_t position = object._aqueue_position;
+            jc_assert(position < b.size() && b[position].get() == &object);
+
+            queue_object_ref ref = std::move(b[position]);
+            if (position + 1 != b.size()) {
+                b[position] = std::move(b.back());
+                b[position]->_aqueue_position = position;
+            }
+            b.pop_back();
+            object._aqueue_bucket = no_bucket;
+            return ref;
+        }
+
+        void u_insert(queue_object_ref&& ref) {
+            // the object is listed twice in an old save
+            if (ref->_aqueue_bucket != no_bucket) {
+                u_move(*ref);
+                return;
+            }
+            const uint32_t bucketIdx = u_bucket_for(*ref);
+            u_link(std::move(ref), bucketIdx);
+            ++_count;
+        }
+
+        void u_move(object_base& object) {
+            const uint32_t bucketIdx = u_bucket_for(object);
+            if (bucketIdx != object._aqueue_bucket) {
+                u_link(u_unlink(object), bucketIdx);
+            }
+        }
 
         void u_startTimer() {
 
@@ -281,20 +383,16 @@ namespace collections {
 
         void tick() {
             {
-                spinlock::guard g(_queue_mutex);
-                _queue.erase(
-                    std::remove_if(_queue.begin(), _queue.end(), [&](const queue_object_ref& ref) {
-                        jc_assert(ref.get());
-                        auto diff = time_subtract(_tickCounter, ref->_aqueue_push_time) + 1; // +1 because 0,1,2,3,4,5 is 6 ticks
-                        bool release = diff >= obj_lifeInTicks;
-                        //jc_debug("id - %u diff - %u, rc - %u", ref->_uid(), diff, ref->refCount());
-
-                        // just move out object reference to release it later
-                        if (release)
-                            _toRelease.push_back(std::move(ref));
-                        return release;
-                    }),
-                    _queue.end());
+                util::counting_spinlock::guard g(_queue_mutex);
+                // just move out the expired bucket to release its objects later
+                jc_assert(_toRelease.empty());
+                _toRelease.swap(_wheel[_wheelPosition]);
+                for (const auto& ref : _toRelease) {
+                    jc_assert(ref.get());
+                    ref->_aqueue_bucket = no_bucket;
+                }
+                _count -= _toRelease.size();
+                _wheelPosition = (_wheelPosition + 1) % obj_lifeInTicks;
 
                 // Increments tick counter, _tickCounter += 1
                 _tickCounter = time_add(_tickCounter, one_tick);
@@ -349,4 +447,4 @@ namespace collections {
     }
 }
 
-BOOST_CLASS_VERSION(collections::autorelease_queue, 2);
+BOOST_CLASS_VERSION(collections::autorelease_queue, 3);
@@ -35,7 +35,8 @@ namespace collections
             auto findNonReachable = [&registry](const object_list& root_objects) -> object_set {
 
                 object_list objects_to_visit(root_objects);
-                object_set not_reachable = registry.u_all_objects(); // potentially huge op ?
+                const auto& all_objects = registry.u_all_objects();
+                object_set not_reachable(all_objects.begin(), all_objects.end()); // potentially huge op ?
 
                 for (auto& root : root_objects) {
                     not_reachable.erase(root);
@@ -0,0 +1,173 @@
+#pragma once
+
+namespace collections {
+
+    // Read sections of the lock-free readers, a kind of RCU.
+    //
+    // A reader announces itself by incrementing one of the reader counters for the time it reads.
+    // The counters are spread over a number of cache lines, each thread sticks to its own line,
+    // so the readers running in different threads do not bounce a shared cache line as they would do
+    // with a reader-writer lock. The parity of the epoch tells which of the two counters of the line to use.
+    //
+    // @synchronize flips the epoch and waits until the counters of the previous parity drop to zero.
+    // Once it returns, every read section which could have seen the data unpublished before the call is over.
+    class read_epochs {
+
+        enum : size_t {
+            line_count = 32,
+        };
+
+        struct alignas(64) line {
+            std::atomic<uint32_t> readers[2];
+        };
+
+        std::atomic<uint32_t> _epoch;
+        mutable std::array<line, line_count> _lines;
+        std::mutex _synchronize_mutex;
+
+        read_epochs(const read_epochs&) = delete;
+        read_epochs& operator = (const read_epochs&) = delete;
+
+        static size_t thread_line() {
+            static std::atomic<size_t> next_line{ 0 };
+            thread_local const size_t index = next_line.fetch_add(1, std::memory_order_relaxed) % line_count;
+            return index;
+        }
+
+        std::atomic<uint32_t>& enter() const {
+            line& l = _lines[thread_line()];
+            for (;;) {
+                const uint32_t epoch = _epoch.load();
+                auto& readers = l.readers[epoch & 1];
+                readers.fetch_add(1);
+                // the epoch got flipped in between: the synchronize might have missed the increment
+                if (_epoch.load() == epoch) {
+                    return readers;
+                }
+                readers.fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+    public:
+
+        read_epochs() : _epoch(0) {
+            for (auto& l : _lines) {
+                l.readers[0].store(0, std::memory_order_relaxed);
+                l.readers[1].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        class read_section {
+            std::atomic<uint32_t>& _readers;
+
+            read_section(const read_section&) = delete;
+            read_section& operator = (const read_section&) = delete;
+
+        public:
+            explicit read_section(const read_epochs& epochs) : _readers(epochs.enter()) {}
+            ~read_section() { _readers.fetch_sub(1, std::memory_order_release); }
+        };
+
+        void synchronize() {
+            std::lock_guard<std::mutex> g(_synchronize_mutex);
+            const uint32_t previous = _epoch.fetch_add(1);
+            for (auto& l : _lines) {
+                while (l.readers[previous & 1].load(std::memory_order_acquire) != 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    };
+
+    // Handle (or any other 32-bit key) -> value table, readable without locks.
+    //
+    // A three-level radix tree of atomic values indexed by the key value: a lookup is three
+    // dependent loads, no hashing, no locking. The writers must be serialized by the owner of the table.
+    // The missing levels get created on demand and never get freed while the table is alive,
+    // so a reader may always walk the levels it has loaded. A missing value reads as zero
+    template<class Value>
+    class basic_handle_table {
+
+        enum : uint32_t {
+            leaf_bits = 10,
+            middle_bits = 10,
+            root_bits = 32 - leaf_bits - middle_bits,
+        };
+
+        using leaf = std::array<std::atomic<Value>, 1 << leaf_bits>;
+        using middle = std::array<std::atomic<leaf *>, 1 << middle_bits>;
+
+        std::array<std::atomic<middle *>, 1 << root_bits> _root;
+
+        basic_handle_table(const basic_handle_table&) = delete;
+        basic_handle_table& operator = (const basic_handle_table&) = delete;
+
+        static uint32_t root_index(HandleT key) { return key >> (leaf_bits + middle_bits); }
+        static uint32_t middle_index(HandleT key) { return (key >> leaf_bits) & ((1 << middle_bits) - 1); }
+        static uint32_t leaf_index(HandleT key) { return key & ((1 << leaf_bits) - 1); }
+
+        // publishes the level created by a writer
+        template<class Level>
+        static Level& u_level(std::atomic<Level *>& slot) {
+            Level *level = slot.load(std::memory_order_relaxed);
+            if (!level) {
+                level = new Level(); // value-initialization zeroes the values
+                slot.store(level, std::memory_order_release);
+            }
+            return *level;
+        }
+
+    public:
+
+        basic_handle_table() {
+            for (auto& m : _root) {
+                m.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        ~basic_handle_table() {
+            for (auto& m : _root) {
+                if (middle *mid = m.load(std::memory_order_relaxed)) {
+                    for (auto& l : *mid) {
+                        delete l.load(std::memory_order_relaxed);
+                    }
+                    delete mid;
+                }
+            }
+        }
+
+        Value get(HandleT key) const {
+            const middle *mid = _root[root_index(key)].load(std::memory_order_acquire);
+            if (!mid) {
+                return Value();
+            }
+            const leaf *lf = (*mid)[middle_index(key)].load(std::memory_order_acquire);
+            if (!lf) {
+                return Value();
+            }
+            return (*lf)[leaf_index(key)].load(std::memory_order_acquire);
+        }
+
+        void u_set(HandleT key, Value value) {
+            leaf& lf = u_level(u_level(_root[root_index(key)])[middle_index(key)]);
+            lf[leaf_index(key)].store(value, std::memory_order_release);
+        }
+
+        // the levels are kept, a concurrent reader may still walk them
+        void u_clear() {
+            for (auto& m : _root) {
+                if (middle *mid = m.load(std::memory_order_relaxed)) {
+                    for (auto& l : *mid) {
+                        if (leaf *lf = l.load(std::memory_order_relaxed)) {
+                            for (auto& value : *lf) {
+                                value.store(Value(), std::memory_order_relaxed);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    using handle_table = basic_handle_table<object_base *>;
+}
@@ -0,0 +1,565 @@
+#pragma once
+
+namespace collections
+{
+    // Incremental tri-color mark & sweep of the cyclic garbage while the game runs.
+    //
+    // A cycle runs on the background worker in short slices, each slice does a bounded amount of work,
+    // the scripts keep running between the slices. A large container gets its references visited in parts,
+    // so that it doesn't hold the slice (or the scripts waiting for its lock) past the budget - see u_visit:
+    //
+    //  - marking: the roots (the objects retained by the scripts, by the stack or by the aqueue) get shaded gray,
+    //    the gray objects get scanned and turn black. An object is black or gray if its _gc_epoch equals the cycle's epoch.
+    //    The objects referenced while the marking is in progress get shaded by the write barrier (see object_base::retain),
+    //    the objects created during the cycle are black from the start
+    //  - collecting: the white objects of the snapshot become the garbage candidates
+    //  - verifying (counting, deciding, sparing): a candidate referenced from outside of the candidate set,
+    //    or a candidate which has became a root, is spared with everything it references.
+    //    This makes the sweep safe even if the barrier has missed a reference
+    //  - sweeping: the garbage objects get cleared (which breaks the cycles, so the objects die through the aqueue)
+    //    or deleted if nothing references them
+    //
+    // All the objects get deleted on the background worker thread (by aqueue or by this collector),
+    // so an object can't disappear in the middle of a slice. Between the slices it can -
+    // the collector checks that an object is still registered before it touches the object.
+    // The registry keeps track of the removed objects while the collector holds a snapshot of the objects.
+    // A candidate which dies while the references are being counted has released its references,
+    // so the counting starts over without it.
+    class incremental_collector : boost::noncopyable {
+    public:
+
+        typedef gc_statistics statistics;
+
+        enum {
+            cycle_interval = 60,    // seconds, between the end of a cycle and the start of the next one
+            slice_interval = 10,    // milliseconds, between the slices
+            slice_budget = 1000,    // microseconds of work per slice
+            visit_part = 256,       // the container positions visited between the clock checks
+            max_visit_restarts = 3, // see u_visit
+        };
+
+    private:
+
+        enum class phase {
+            idle,
+            marking,
+            collecting,
+            counting,
+            deciding,
+            sparing,
+            sweeping,
+        };
+
+        typedef std::vector<object_base *> object_list;
+
+        object_registry& _registry;
+
+        std::atomic<bool> _marking{ false };
+        std::atomic<uint32_t> _epoch{ 0 };
+        phase _phase = phase::idle;
+
+        object_list _snapshot;
+        bool _holds_snapshot = false;
+        size_t _cursor = 0;
+        object_list _gray;
+        spinlock _gray_mutex;
+        object_list _garbage;
+        uint32_t _cycle_garbage = 0;
+
+        // the trial deletion: the references the candidates get from each other, the spared candidates to visit
+        std::unordered_map<object_base *, int32_t> _internal_refs;
+        object_list _spared;
+        std::unordered_set<object_base *> _spared_set;
+        size_t _removed_seen = 0;   // the registry's removals checked for the dead candidates, see u_drop_dead_candidates
+
+        // the container whose references are being visited in parts, see u_visit
+        struct partial_visit {
+            object_base *object = nullptr;
+            size_t position = 0;
+            size_t size = 0;
+            uint32_t restarts = 0;
+        };
+        partial_visit _visit;
+        object_list _visit_refs;    // the candidates the counting has met in the visited parts
+
+        statistics _stats = {};
+        mutable spinlock _stats_mutex;
+
+        boost::asio::deadline_timer _timer;
+        std::mutex _timer_mutex;
+        bool _timer_stopped = true;
+
+        // the slice ends once the budget is spent. The clock gets checked once @check_period units of work are done:
+        // a step is one unit, a visited part of a container is as many units as it has positions
+        struct slice_clock {
+            enum { check_period = 32 };
+
+            std::chrono::steady_clock::time_point deadline;
+            size_t work = 0;
+
+            explicit slice_clock(std::chrono::microseconds budget)
+                : deadline(std::chrono::steady_clock::now() + budget) {}
+
+            bool expired(size_t units = 1) {
+                work += units;
+                if (work < check_period) {
+                    return false;
+                }
+                work = 0;
+                return std::chrono::steady_clock::now() >= deadline;
+            }
+        };
+
+        static bool is_root(const object_base& obj) {
+            return obj.u_is_user_retains() || obj.is_in_aqueue() || obj._stack_refCount.load(std::memory_order_relaxed) > 0;
+        }
+
+        bool is_marked(const object_base& obj) const {
+            return obj._gc_epoch.load(std::memory_order_relaxed) == _epoch.load(std::memory_order_relaxed);
+        }
+
+        bool is_alive(object_base *obj) const {
+            return _registry.is_registered(obj);
+        }
+
+        void u_start_cycle() {
+            uint32_t epoch = _epoch.load(std::memory_order_relaxed) + 1;
+            _epoch.store(epoch ? epoch : 1, std::memory_order_relaxed);
+
+            _snapshot = _registry.take_snapshot();
+            _holds_snapshot = true;
+            _removed_seen = 0;
+            _cursor = 0;
+            _cycle_garbage = 0;
+            _phase = phase::marking;
+
+            _marking.store(true);
+            ++g_marking_contexts;
+        }
+
+        void u_stop_marking() {
+            if (_marking.exchange(false)) {
+                --g_marking_contexts;
+            }
+        }
+
+        void u_release_snapshot() {
+            if (_holds_snapshot) {
+                _holds_snapshot = false;
+                _registry.release_snapshot();
+            }
+        }
+
+        void u_abort_cycle() {
+            u_stop_marking();
+            u_release_snapshot();
+            _phase = phase::idle;
+            _snapshot = object_list();
+            _garbage = object_list();
+            u_release_verification();
+            u_reset_visit();
+            spinlock::guard g(_gray_mutex);
+            _gray = object_list();
+        }
+
+        object_base *u_pop_gray() {
+            spinlock::guard g(_gray_mutex);
+            if (_gray.empty()) {
+                return nullptr;
+            }
+            object_base *obj = _gray.back();
+            _gray.pop_back();
+            return obj;
+        }
+
+        void u_reset_visit() {
+            _visit = partial_visit();
+            _visit_refs = object_list();
+        }
+
+        // Visits the references of @obj in parts of @visit_part positions, so that a large container doesn't hold
+        // the slice longer than the budget. Returns false if the @clock has expired before the end:
+        // the object is locked during a part only, the visit gets resumed by the next u_resume_visit call.
+        // The positions of a container which has changed its size meanwhile may have shifted, its visit starts over then
+        // (@restart lets the visitor discard what it has seen). A container which keeps changing gets visited at once
+        // after @max_visit_restarts attempts
+        template<class Restart>
+        bool u_visit(object_base *obj, slice_clock& clock, const std::function<void(object_base&)>& visitor, Restart&& restart) {
+            if (_visit.object != obj) {
+                _visit = partial_visit();
+                _visit.object = obj;
+            }
+
+            object_lock g(obj);
+            const size_t size = obj->u_visit_referenced_objects_part(0, 0, visitor);
+            if (_visit.position != 0 && size != _visit.size) {
+                restart();
+                _visit.position = 0;
+                ++_visit.restarts;
+            }
+            _visit.size = size;
+
+            const size_t part = _visit.restarts < max_visit_restarts ? size_t(visit_part) : size;
+            while (_visit.position < size) {
+                obj->u_visit_referenced_objects_part(_visit.position, part, visitor);
+                _visit.position += part;
+                if (_visit.position < size && clock.expired(part)) {
+                    return false;
+                }
+            }
+            _visit = partial_visit();
+            return true;
+        }
+
+        // continues the unfinished visit of u_visit, if any. The visit of an object which has died meanwhile is dropped
+        template<class Restart>
+        bool u_resume_visit(slice_clock& clock, const std::function<void(object_base&)>& visitor, Restart&& restart) {
+            object_base *obj = _visit.object;
+            if (!obj) {
+                return true;
+            }
+            if (!is_alive(obj)) {
+                restart();
+                _visit = partial_visit();
+                return true;
+            }
+            return u_visit(obj, clock, visitor, restart);
+        }
+
+        // shades the roots of the snapshot, then scans the gray objects until there are none
+        bool u_mark(slice_clock& clock) {
+            std::function<void(object_base&)> shader = [this](object_base& referenced) { shade(referenced); };
+            auto restart = []() {}; // shading twice is harmless
+
+            if (!u_resume_visit(clock, shader, restart)) {
+                return false;
+            }
+
+            while (!clock.expired()) {
+                if (_cursor < _snapshot.size()) {
+                    object_base *obj = _snapshot[_cursor++];
+                    if (is_alive(obj) && is_root(*obj)) {
+                        shade(*obj);
+                    }
+                }
+                else if (object_base *obj = u_pop_gray()) {
+                    if (is_alive(obj) && !u_visit(obj, clock, shader, restart)) {
+                        return false;
+                    }
+                }
+                else {
+                    u_stop_marking();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool u_collect(slice_clock& clock) {
+            while (_cursor < _snapshot.size()) {
+                object_base *obj = _snapshot[_cursor++];
+                if (is_alive(obj) && !is_marked(*obj)) {
+                    _garbage.push_back(obj);
+                }
+                if (clock.expired()) {
+                    return false;
+                }
+            }
+            _snapshot = object_list();
+            return true;
+        }
+
+        void u_release_verification() {
+            _internal_refs = std::unordered_map<object_base *, int32_t>();
+            _spared = object_list();
+            _spared_set = std::unordered_set<object_base *>();
+        }
+
+        void u_start_counting() {
+            _spared.clear();
+            _spared_set.clear();
+            _internal_refs.clear();
+            u_reset_visit();
+            _internal_refs.reserve(_garbage.size());
+            for (object_base *obj : _garbage) {
+                _internal_refs.emplace(obj, 0);
+            }
+            _cursor = 0;
+            _phase = phase::counting;
+        }
+
+        // The candidates removed from the registry since the last check are dropped, the counting starts over then.
+        // Only the removals since the last check get looked at, not all the candidates
+        bool u_drop_dead_candidates() {
+            const object_list removed = _registry.removed_objects(_removed_seen);
+            _removed_seen += removed.size();
+
+            std::unordered_set<object_base *> dead;
+            for (object_base *obj : removed) {
+                if (_internal_refs.count(obj)) {
+                    dead.insert(obj);
+                }
+            }
+            if (dead.empty()) {
+                return false;
+            }
+            _garbage.erase(
+                std::remove_if(_garbage.begin(), _garbage.end(), [&](object_base *obj) { return dead.count(obj) != 0; }),
+                _garbage.end());
+            u_start_counting();
+            return true;
+        }
+
+        // Trial deletion, step 1: counts the references the candidates get from each other.
+        // A candidate visited in parts gets its references counted once the visit is over, as the visit may start over
+        bool u_count(slice_clock& clock) {
+            std::function<void(object_base&)> counter = [this](object_base& referenced) {
+                if (_internal_refs.count(&referenced)) {
+                    _visit_refs.push_back(&referenced);
+                }
+            };
+            auto restart = [this]() { _visit_refs.clear(); };
+            auto commit = [this]() {
+                for (object_base *referenced : _visit_refs) {
+                    ++_internal_refs[referenced];
+                }
+                _visit_refs.clear();
+            };
+
+            if (!u_resume_visit(clock, counter, restart)) {
+                return false;
+            }
+            commit();
+
+            while (_cursor < _garbage.size()) {
+                object_base *obj = _garbage[_cursor++];
+                if (is_alive(obj)) {
+                    if (!u_visit(obj, clock, counter, restart)) {
+                        return false;
+                    }
+                    commit();
+                }
+                if (clock.expired()) {
+                    return false;
+                }
+            }
+            _cursor = 0;
+            return true;
+        }
+
+        // step 2: the candidate referenced more times than the other candidates reference it
+        // is referenced from outside. Such candidates and the roots get spared
+        bool u_decide(slice_clock& clock) {
+            while (_cursor < _garbage.size()) {
+                object_base *obj = _garbage[_cursor++];
+                if (is_alive(obj) && (is_root(*obj) || obj->_refCount.load() > _internal_refs[obj])) {
+                    if (_spared_set.insert(obj).second) {
+                        _spared.push_back(obj);
+                    }
+                }
+                if (clock.expired()) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // step 3: everything the spared candidates reference gets spared too, the rest is the garbage
+        bool u_spare(slice_clock& clock) {
+            std::function<void(object_base&)> spare = [this](object_base& referenced) {
+                if (_internal_refs.count(&referenced) && _spared_set.insert(&referenced).second) {
+                    _spared.push_back(&referenced);
+                }
+            };
+            auto restart = []() {}; // sparing twice is harmless
+
+            if (!u_resume_visit(clock, spare, restart)) {
+                return false;
+            }
+
+            while (!_spared.empty()) {
+                object_base *obj = _spared.back();
+                _spared.pop_back();
+                if (is_alive(obj) && !u_visit(obj, clock, spare, restart)) {
+                    return false;
+                }
+                if (clock.expired()) {
+                    return false;
+                }
+            }
+
+            if (!_spared_set.empty()) {
+                _garbage.erase(
+                    std::remove_if(_garbage.begin(), _garbage.end(), [&](object_base *obj) { return _spared_set.count(obj) != 0; }),
+                    _garbage.end());
+            }
+            u_release_verification();
+            _cycle_garbage = static_cast<uint32_t>(_garbage.size());
+            _cursor = 0;
+            return true;
+        }
+
+        bool u_sweep(slice_clock& clock) {
+            while (_cursor < _garbage.size()) {
+                object_base *obj = _garbage[_cursor++];
+                // the object has been resurrected by a handle lookup or has got into the aqueue as the result of the sweep
+                if (is_alive(obj) && !is_root(*obj)) {
+                    if (obj->noOwners()) {
+                        obj->_delete_self();
+                    }
+                    else {
+                        obj->s_clear();
+                    }
+                }
+                if (clock.expired()) {
+                    return false;
+                }
+            }
+            _garbage = object_list();
+            u_release_snapshot();
+            return true;
+        }
+
+        // performs the next step of the current cycle or starts a new one, returns true if the cycle is over
+        bool u_slice() {
+            const auto started = std::chrono::steady_clock::now();
+            slice_clock clock{ std::chrono::microseconds(slice_budget) };
+            bool cycleOver = false;
+
+            switch (_phase) {
+            case phase::idle:
+                u_start_cycle();
+                break;
+            case phase::marking:
+                if (u_mark(clock)) {
+                    _cursor = 0;
+                    _phase = phase::collecting;
+                }
+                break;
+            case phase::collecting:
+                if (u_collect(clock)) {
+                    u_start_counting();
+                }
+                break;
+            case phase::counting:
+                if (!u_drop_dead_candidates() && u_count(clock)) {
+                    _phase = phase::deciding;
+                }
+                break;
+            case phase::deciding:
+                // a candidate dead since the counting has released its references, the counts are wrong then
+                if (!u_drop_dead_candidates() && u_decide(clock)) {
+                    _phase = phase::sparing;
+                }
+                break;
+            case phase::sparing:
+                if (u_spare(clock)) {
+                    _phase = phase::sweeping;
+                }
+                break;
+            case phase::sweeping:
+                if (u_sweep(clock)) {
+                    _phase = phase::idle;
+                    cycleOver = true;
+                }
+                break;
+            }
+
+            const auto pause = static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+
+            spinlock::guard g(_stats_mutex);
+            _stats.last_pause_us = pause;
+            _stats.max_pause_us = (std::max)(_stats.max_pause_us, pause);
+            _stats.total_pause_us += pause;
+            if (cycleOver) {
+                ++_stats.cycles;
+                _stats.reclaimed += _cycle_garbage;
+                _stats.last_reclaimed = _cycle_garbage;
+            }
+            return cycleOver;
+        }
+
+        void u_startTimer(boost::posix_time::time_duration delay) {
+            boost::system::error_code code;
+            _timer.expires_from_now(delay, code);
+            assert(!code);
+
+            _timer.async_wait([this](const boost::system::error_code& error) {
+                if (error) {
+                    return;
+                }
+
+                std::lock_guard<std::mutex> g(this->_timer_mutex);
+                if (!this->_timer_stopped) {
+                    const bool cycleOver = this->u_slice();
+                    this->u_startTimer(cycleOver
+                        ? boost::posix_time::seconds(int(cycle_interval))
+                        : boost::posix_time::milliseconds(int(slice_interval)));
+                }
+            });
+        }
+
+    public:
+
+        explicit incremental_collector(object_registry& registry)
+            : _registry(registry)
+            , _timer(detail::g_background_worker.get()._io)
+        {
+            start();
+        }
+
+        ~incremental_collector() {
+            stop();
+        }
+
+        // the write barrier, marks the object if the marking is in progress
+        void shade(object_base& obj) {
+            if (!_marking.load(std::memory_order_relaxed)) {
+                return;
+            }
+            const uint32_t epoch = _epoch.load(std::memory_order_relaxed);
+            if (obj._gc_epoch.exchange(epoch) != epoch) {
+                spinlock::guard g(_gray_mutex);
+                _gray.push_back(&obj);
+            }
+        }
+
+        // the objects created during the cycle are black
+        void mark_new(object_base& obj) {
+            if (_marking.load(std::memory_order_relaxed)) {
+                obj._gc_epoch.store(_epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+        }
+
+        // starts the cycles, the first one starts in @cycle_interval seconds
+        void start() {
+            std::lock_guard<std::mutex> g(_timer_mutex);
+            if (_timer_stopped) {
+                _timer_stopped = false;
+                u_startTimer(boost::posix_time::seconds(int(cycle_interval)));
+            }
+        }
+
+        // stops the cycles, the unfinished cycle gets abandoned
+        void stop() {
+            std::lock_guard<std::mutex> g(_timer_mutex);
+            _timer_stopped = true;
+            _timer.cancel();
+            u_abort_cycle();
+        }
+
+        // runs a whole cycle right away, returns the number of garbage objects found. Exposed for testing purposes
+        size_t collect() {
+            std::lock_guard<std::mutex> g(_timer_mutex);
+            u_abort_cycle();
+            while (!u_slice()) {}
+            return _cycle_garbage;
+        }
+
+        statistics get_statistics() const {
+            spinlock::guard g(_stats_mutex);
+            return _stats;
+        }
+    };
+}
@@ -2,6 +2,7 @@
 
 #include <mutex>
 #include <atomic>
+#include <array>
 #include <assert.h>
 #include <boost/optional/optional.hpp>
 #include "boost/noncopyable.hpp"
@@ -21,6 +22,9 @@ namespace collections {
     class object_base;
     class object_context;
 
+    // the number of contexts whose objects are being marked by the incremental collector right now
+    inline std::atomic<int32_t> g_marking_contexts{ 0 };
+
     enum CollectionType {
         None = 0,
         Array,
@@ -56,9 +60,13 @@ namespace collections {
         std::atomic_int32_t _stack_refCount     = 0;
         std::atomic_int32_t _aqueue_refCount    = 0;
         time_point _aqueue_push_time            = 0;
+        uint32_t _aqueue_bucket                 = ~0u; // the aqueue's wheel bucket the object is in, guarded by the aqueue
+        uint32_t _aqueue_position               = 0; // the object's index in the bucket
+        uint32_t _registry_index                = ~0u; // the object's index in the registry's object list, guarded by the registry
+        std::atomic<uint32_t> _gc_epoch         = 0; // the collection cycle which has marked the object last time
 
         CollectionType                          _type = CollectionType::None;
-        util::istring                           _tag;
+        util::istring                           _tag; // changes under the object lock, see object_registry::set_tag
     private:
         object_context *_context                = nullptr;
 
@@ -71,8 +79,9 @@ namespace collections {
         virtual ~object_base() {}
 
     public:
-        using lock = std::lock_guard<spinlock>;
-        mutable spinlock _mutex;
+        // exclusive for the writers, shared for the readers (see object_read_lock)
+        using lock = std::lock_guard<util::shared_spinlock>;
+        mutable util::shared_spinlock _mutex;
 
         explicit object_base(CollectionType type)
             : _type(type)
@@ -92,7 +101,7 @@ namespace collections {
             return _uid() != Handle::Null;
         }
 
-        spinlock& mutex() const { return _mutex; }
+        util::shared_spinlock& mutex() const { return _mutex; }
 
         template<class T> T* as() {
             return const_cast<T*>(const_cast<const object_base*>(this)->as<T>());
@@ -118,9 +127,15 @@ namespace collections {
 
         object_base * retain() {
             ++_refCount;
+            // the write barrier: the object which gets referenced while the objects are being marked gets marked too
+            if (g_marking_contexts.load(std::memory_order_relaxed) > 0) {
+                _gc_shade();
+            }
             return this;
         }
 
+        void _gc_shade();
+
         object_base * tes_retain();
 
         int32_t refCount() const {
@@ -186,12 +201,8 @@ namespace collections {
             u_clear();
         }
 
-        void set_tag (const char* tag)
-        {
-            lock g (_mutex);
-            if (tag) _tag = tag;
-            else _tag.clear ();
-        }
+        // retags the object, keeping the context's tag index up to date
+        void set_tag (const char* tag);
 
         bool has_equal_tag (char const* tag) const
         {
@@ -204,14 +215,146 @@ namespace collections {
         }
 
         virtual void u_visit_referenced_objects(const std::function<void(object_base&)>& visitor) {}
+
+        // The same for the [@from, @from + @count) positions of the contents only, so that a large container can be visited
+        // in parts. Returns the number of the positions, a zero @count visits nothing. The contents which can't be split
+        // have one position
+        virtual size_t u_visit_referenced_objects_part(size_t from, size_t count, const std::function<void(object_base&)>& visitor) {
+            if (from == 0 && count != 0) {
+                u_visit_referenced_objects(visitor);
+            }
+            return 1;
+        }
     };
 
+    // Deferred stack references.
+    //
+    // Every native call opens a deferral scope (see reflection::binding). Within the scope the thread's first stack reference
+    // to an object takes a single shared reference (_stack_refCount), the rest of the thread's stack references to the object
+    // are counted in a thread-local table and do not touch the object at all. The outermost scope end is the safe point:
+    // the local counts get flushed into the shared counters, the shared references taken by the table get returned.
+    // Outside of a scope a stack reference is a plain atomic increment, as is a reference which did not fit into the table.
+    //
+    // A stack reference taken within a scope must be released by the same thread, as the scoped object_stack_ref is.
+    // The references of Lua (JValue_retain) may be released by another thread, so they do not go through the table.
+    class deferred_stack_refs {
+
+        enum : size_t {
+            capacity = 64,
+            max_used = capacity * 3 / 4,
+        };
+
+        struct entry {
+            object_base *object;
+            int32_t count; // the stack references the thread has not returned yet
+        };
+
+        std::array<entry, capacity> _entries;
+        size_t _used = 0;
+        uint32_t _depth = 0;
+
+        deferred_stack_refs() {
+            for (auto& e : _entries) {
+                e = entry{ nullptr, 0 };
+            }
+        }
+
+        static deferred_stack_refs& current() {
+            thread_local deferred_stack_refs refs;
+            return refs;
+        }
+
+        static size_t index_of(const object_base *obj) {
+            // the objects are at least 16 bytes apart
+            return ((reinterpret_cast<uintptr_t>(obj) >> 4) * 0x9E3779B1u) % capacity;
+        }
+
+        // the entry of the @obj, the free entry for the @obj, or null if the object is not in the table and the table is full
+        entry *u_find(object_base *obj) {
+            for (size_t i = index_of(obj);; i = (i + 1) % capacity) {
+                entry& e = _entries[i];
+                if (e.object == obj) {
+                    return &e;
+                }
+                if (!e.object) {
+                    return _used < max_used ? &e : nullptr;
+                }
+            }
+        }
+
+        void u_flush();
+
+    public:
+
+        class scope {
+            scope(const scope&) = delete;
+            scope& operator = (const scope&) = delete;
+        public:
+            scope() { ++current()._depth; }
+            ~scope() {
+                deferred_stack_refs& refs = current();
+                if (--refs._depth == 0 && refs._used != 0) {
+                    refs.u_flush();
+                }
+            }
+        };
+
+        static void retain(object_base& obj);
+        static void release(object_base& obj);
+    };
+
+    inline void deferred_stack_refs::retain(object_base& obj) {
+        deferred_stack_refs& refs = current();
+        entry *e = refs._depth != 0 ? refs.u_find(&obj) : nullptr;
+        if (!e) {
+            obj.stack_retain();
+        }
+        else if (e->object) {
+            ++e->count;
+        }
+        else {
+            // the table's shared reference, held until the scope ends
+            obj.stack_retain();
+            *e = entry{ &obj, 1 };
+            ++refs._used;
+        }
+    }
+
+    inline void deferred_stack_refs::release(object_base& obj) {
+        deferred_stack_refs& refs = current();
+        entry *e = refs._used != 0 ? refs.u_find(&obj) : nullptr;
+        if (e && e->object && e->count > 0) {
+            --e->count;
+        }
+        else {
+            obj.stack_release();
+        }
+    }
+
+    inline void deferred_stack_refs::u_flush() {
+        for (auto& e : _entries) {
+            if (object_base *obj = e.object) {
+                const int32_t count = e.count;
+                e = entry{ nullptr, 0 };
+                --_used;
+
+                // the table's shared reference stands for the references still alive (they may outlive the scope)
+                if (count == 0) {
+                    obj->stack_release();
+                }
+                else if (count > 1) {
+                    obj->_stack_refCount += count - 1;
+                }
+            }
+        }
+    }
+
     inline void object_base_stack_ref_policy::retain(object_base * p) {
-        p->stack_retain();
+        deferred_stack_refs::retain(*p);
     }
 
     inline void object_base_stack_ref_policy::release(object_base * p) {
-        p->stack_release();
+        deferred_stack_refs::release(*p);
     }
 
     struct internal_object_lifetime_policy {
@@ -236,4 +379,88 @@ namespace collections {
         template<class T, class P>
         explicit object_lock(const boost::intrusive_ptr_jc<T, P>& ref) : _lock(static_cast<const object_base&>(*ref)._mutex) {}
     };
+
+    // Shared lock for the readers: the concurrent readers of an object do not wait for each other.
+    // The reader must not modify the object, including its items, and must not lock the object again
+    class object_read_lock {
+        util::shared_spinlock::shared_guard _lock;
+    public:
+        explicit object_read_lock(const object_base *obj) : _lock(obj->_mutex) {}
+        explicit object_read_lock(const object_base &obj) : _lock(obj._mutex) {}
+    };
+
+    // Hand-over-hand locking along a chain of objects, each object referenced by the previous one:
+    // the next object gets locked before the current one gets released, so the chain can't change under the walker.
+    //
+    // The lock order. The object graph may have cycles and the threads walk it in any direction,
+    // so there is no order of the objects to lock them in. Instead:
+    //  - a thread waits for an object lock only while it holds no other object lock
+    //  - holding a lock, a thread may only try to take another one. If the next object is busy, the walker releases
+    //    the current one and then waits (see step), or gives up and comes back once it holds nothing (see try_step)
+    // No thread ever waits while holding a lock, so the threads can't wait for each other in a circle.
+    // The object_lock and object_read_lock wait, so they may be nested only under a lock no other thread can take
+    // (the deep copy locks the origins while holding the locks of its fresh copies).
+    class object_lock_chain {
+        const object_base *_locked = nullptr;
+        bool _shared;
+
+        static void lock(const object_base& obj, bool shared) {
+            shared ? obj.mutex().lock_shared() : obj.mutex().lock();
+        }
+
+        static bool try_lock(const object_base& obj, bool shared) {
+            return shared ? obj.mutex().try_lock_shared() : obj.mutex().try_lock();
+        }
+
+        static void unlock(const object_base& obj, bool shared) {
+            shared ? obj.mutex().unlock_shared() : obj.mutex().unlock();
+        }
+
+        object_lock_chain(const object_lock_chain&) = delete;
+        object_lock_chain& operator = (const object_lock_chain&) = delete;
+
+    public:
+
+        // the readers share the locks, the writers lock exclusively
+        explicit object_lock_chain(bool shared) : _shared(shared) {}
+
+        ~object_lock_chain() {
+            release();
+        }
+
+        const object_base *locked() const { return _locked; }
+        bool shared() const { return _shared; }
+
+        // locks the @next object, then releases the current one. If the @next is busy,
+        // the current lock gets released first and then the walker waits for the @next
+        void step(const object_base& next) {
+            if (_locked && try_lock(next, _shared)) {
+                unlock(*_locked, _shared);
+            }
+            else {
+                release();
+                lock(next, _shared);
+            }
+            _locked = &next;
+        }
+
+        // never waits: locks the @next object and releases the current one, false if the @next is busy
+        bool try_step(const object_base& next) {
+            if (!try_lock(next, _shared)) {
+                return false;
+            }
+            if (_locked) {
+                unlock(*_locked, _shared);
+            }
+            _locked = &next;
+            return true;
+        }
+
+        void release() {
+            if (_locked) {
+                unlock(*_locked, _shared);
+                _locked = nullptr;
+            }
+        }
+    };
 }
@@ -1,9 +1,16 @@
 namespace collections
 {
     void object_base::_registerSelf() {
+        context().collector->mark_new(*this);
         context().registry->registerNewObject(*this);
     }
 
+    void object_base::_gc_shade() {
+        if (is_completely_initialized()) {
+            context().collector->shade(*this);
+        }
+    }
+
     Handle object_base::public_id() {
         using namespace std;
 
@@ -84,6 +91,10 @@ namespace collections
         delete this;
     }
 
+    void object_base::set_tag(const char* tag) {
+        context().registry->set_tag(*this, tag);
+    }
+
     object_base* object_base::tes_retain() {
         ++_tes_refCount;
         context().aqueue->not_prolong_lifetime(*this);
@@ -92,8 +103,8 @@ namespace collections
 
     void object_base::tes_release() {
         if (_tes_refCount > 0) {
-            --_tes_refCount;
-            if (noOwners()) {
+            // the rest of the owners are checked only if the released counter drops to zero
+            if (--_tes_refCount == 0 && noOwners()) {
                 // a user releases the object, no owners - I may even delete it immediately
                 context().aqueue->prolong_lifetime(*this, true);
             }
@@ -102,8 +113,7 @@ namespace collections
 
     void object_base::stack_release() {
         if (_stack_refCount > 0) {
-            --_stack_refCount;
-            if (noOwners()) {
+            if (--_stack_refCount == 0 && noOwners()) {
                 // the object no more referenced by Lua or stack, no owners - I may even delete it immediately
                 // (immediately if the object is not exposed to Skyrim, i.e. has no public ID)
                 prolong_lifetime();
@@ -116,8 +126,7 @@ namespace collections
         //jc_assert(_refCount > 0);
 
         if (_refCount > 0) {
-            --_refCount;
-            if (noOwners()) {
+            if (--_refCount == 0 && noOwners()) {
                 // the object get's erased from another object, no owners - I may even delete it immediately
                 // (immediately if the object is not exposed to Skyrim, i.e. has no public ID)
 
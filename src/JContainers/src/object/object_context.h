@@ -6,6 +6,7 @@
 #include <boost/serialization/split_member.hpp>
 
 #include "object_base.h"
+#include "object_pools.h"
 
 namespace boost {
 namespace archive {
@@ -18,6 +19,7 @@ namespace collections {
 
     class object_registry;
     class autorelease_queue;
+    class incremental_collector;
 
 
     class dependent_context {
@@ -27,6 +29,22 @@ namespace collections {
     };
 
 
+    // the metrics of the incremental garbage collector
+    struct gc_statistics {
+        uint32_t cycles;                // completed cycles
+        uint64_t reclaimed;             // garbage objects found by all the cycles
+        uint32_t last_reclaimed;        // by the last cycle
+        uint32_t last_pause_us;         // the duration of the last slice, microseconds
+        uint32_t max_pause_us;          // the longest slice
+        uint64_t total_pause_us;
+    };
+
+    // the contention of the locks, counted since the start
+    struct lock_statistics {
+        util::spinlock_statistics all;      // all the spinlocks, summed up over the threads
+        util::spinlock_statistics aqueue;   // the lock of the autorelease queue
+    };
+
     enum class serialization_version {
         pre_aqueue_fix = 2,
         no_header = 3, // no JSON header in the beginning of a stream
@@ -53,8 +71,10 @@ namespace collections {
         void u_print_stats() const;
 
     public:
+        object_pools pools;
         std::unique_ptr<object_registry> registry;
         std::unique_ptr<autorelease_queue> aqueue;
+        std::unique_ptr<incremental_collector> collector;
 
     public:
 
@@ -62,6 +82,8 @@ namespace collections {
         virtual ~object_context();
 
         std::vector<object_stack_ref> filter_objects(std::function<bool(object_base& obj)> predicate) const;
+        std::vector<object_stack_ref> objects_with_tag(const char *tag) const;
+        size_t count_objects_with_tag(const char *tag) const;
 
         template<class T>
         T * getObjectOfType(Handle hdl) {
@@ -81,6 +103,9 @@ namespace collections {
 
         // exposed for testing purposes only
         size_t collect_garbage();
+        size_t collect_garbage_incrementally();
+        gc_statistics collector_statistics() const;
+        lock_statistics locks_statistics() const;
     public:
 
         // stops object_context's activity, until destroyed and then restarts it 
@@ -6,6 +6,7 @@ namespace collections
     {
         registry.reset(new object_registry{});
         aqueue.reset(new autorelease_queue{ *registry });
+        collector.reset(new incremental_collector{ *registry });
     }
 
     object_context::~object_context() {
@@ -23,10 +24,12 @@ namespace collections
 
     void object_context::stop_activity() {
         aqueue->stop();
+        collector->stop();
     }
 
     void object_context::start_activity() {
         aqueue->start();
+        collector->start();
     }
     
     void object_context::u_clearState() {
@@ -53,9 +56,16 @@ namespace collections
             for (auto& obj : registry->u_all_objects()) {
                 obj->u_nullifyObjects();
             }
+            // the pooled objects are destroyed in place, their memory is freed by slabs
             for (auto& obj : registry->u_all_objects()) {
-                delete obj;
+                if (pools.owns(*obj)) {
+                    obj->~object_base();
+                }
+                else {
+                    delete obj;
+                }
             }
+            pools.u_release_all();
 
             registry->u_clear();
             aqueue->u_clear();
@@ -66,6 +76,14 @@ namespace collections
         return registry->filter_objects(predicate);
     }
 
+    std::vector<object_stack_ref> object_context::objects_with_tag(const char *tag) const {
+        return registry->objects_with_tag(tag);
+    }
+
+    size_t object_context::count_objects_with_tag(const char *tag) const {
+        return registry->count_objects_with_tag(tag);
+    }
+
     object_base * object_context::getObject(Handle hdl) {
         return registry->getObject(hdl);
     }
@@ -92,10 +110,25 @@ namespace collections
         return res.garbage_total;
     }
 
+    size_t object_context::collect_garbage_incrementally() {
+        // the slices run in this thread, while no object can be deleted in the background
+        activity_stopper s{ *this };
+        return collector->collect();
+    }
+
+    gc_statistics object_context::collector_statistics() const {
+        return collector->get_statistics();
+    }
+
+    lock_statistics object_context::locks_statistics() const {
+        return lock_statistics{ util::spinlock_global_statistics(), aqueue->lock_statistics() };
+    }
+
     //////////////////////////////////////////////////////////////////////////
 
     template<>
     void object_context::load(boost::archive::binary_iarchive & ar, unsigned int version) {
+        object_pools::loading_scope scope(pools);
         ar >> *registry >> *aqueue;
     }
 
@@ -106,6 +139,7 @@ namespace collections
 
     template<>
     void object_context::load_data_in_old_way(boost::archive::binary_iarchive& ar) {
+        object_pools::loading_scope scope(pools);
         ar >> *registry >> *aqueue;
     }
 
@@ -113,6 +147,25 @@ namespace collections
         JC_log("%lu objects total", registry->u_all_objects().size());
         JC_log("%lu public objects", registry->u_public_object_count());
         JC_log("%lu objects in aqueue", aqueue->u_count());
+
+        auto gc = collector_statistics();
+        JC_log("Incremental GC: %u cycles, %llu garbage objects collected (%u by the last cycle), slice pause %u us last, %u us max",
+            gc.cycles, gc.reclaimed, gc.last_reclaimed, gc.last_pause_us, gc.max_pause_us);
+
+        auto printLockStats = [](const char *name, const util::spinlock_statistics& stats) {
+            JC_log("%s: %llu contended locks, %llu backoff rounds, %llu yields, %llu sleeps",
+                name, stats.contended, stats.pauses, stats.yields, stats.parks);
+        };
+        auto locks = locks_statistics();
+        printLockStats("Spinlocks", locks.all);
+        printLockStats("Aqueue lock", locks.aqueue);
+
+        const char *names[] = { "JArray", "JMap", "JFormMap", "JIntMap" };
+        for (auto type : { CollectionType::Array, CollectionType::Map, CollectionType::FormMap, CollectionType::IntegerMap }) {
+            auto stats = pools.u_statistics(type);
+            JC_log("%s pool: %lu of %lu cells in use, %lu slabs, %lu bytes per cell",
+                names[type - CollectionType::Array], stats.cells_in_use, stats.cells_total, stats.slabs, stats.cell_size);
+        }
     }
 
     //////////////////////////////////////////////////////////////////////////
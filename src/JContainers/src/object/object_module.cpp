@@ -5,7 +5,10 @@
 #include <algorithm>
 #include <vector>
 #include <atomic>
+#include <array>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <jansson.h>
 
@@ -41,9 +44,12 @@
 #include "object_base_serialization.h"
 
 #include "id_generator.h"
+#include "handle_table.h"
+#include "slot_table.h"
 #include "object_registry.h"
 #include "autorelease_queue.h"
 #include "garbage_collector.h"
+#include "incremental_collector.h"
 
 #include "object_base.hpp"
 #include "object_context.hpp"
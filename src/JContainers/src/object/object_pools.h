@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+
+#include "util/slab_pool.h"
+#include "object/object_base.h"
+
+namespace collections {
+
+    // Per-context pools of the collection objects, a pool per collection type.
+    //
+    // The objects created by the context get allocated from its pools. The objects created by the deserialization
+    // get allocated from the pools of the context which is being loaded (see loading_scope).
+    // Once the context is cleared, its objects get destroyed in place and the slabs get freed all at once.
+    class object_pools {
+
+        enum : size_t {
+            pool_count = CollectionType::IntegerMap + 1,
+        };
+
+        std::array<util::slab_pool, pool_count> _pools;
+
+        static object_pools *& loading_pools() {
+            thread_local object_pools *pools = nullptr;
+            return pools;
+        }
+
+    public:
+
+        using statistics = util::slab_pool::statistics;
+
+        object_pools() = default;
+        object_pools(const object_pools&) = delete;
+        object_pools& operator = (const object_pools&) = delete;
+
+        // makes the @pools the pools of the objects the deserialization creates in the current thread
+        class loading_scope {
+            object_pools *_previous;
+
+        public:
+            explicit loading_scope(object_pools& pools) : _previous(loading_pools()) {
+                loading_pools() = &pools;
+            }
+            ~loading_scope() {
+                loading_pools() = _previous;
+            }
+        };
+
+        void *allocate(CollectionType type, size_t size) {
+            return _pools[type].allocate(size);
+        }
+
+        // allocates from the pools of the context being loaded, if any, otherwise from the heap
+        static void *allocate_loaded(CollectionType type, size_t size) {
+            object_pools *pools = loading_pools();
+            return util::slab_pool::allocate(pools ? &pools->_pools[type] : nullptr, size);
+        }
+
+        static void deallocate(void *p) {
+            util::slab_pool::deallocate(p);
+        }
+
+        // whether the object lives in one of the pools
+        bool owns(object_base& obj) const {
+            const util::slab_pool *owner = util::slab_pool::owner_of(dynamic_cast<void *>(&obj));
+            return owner >= &_pools.front() && owner <= &_pools.back();
+        }
+
+        // frees the slabs, all the objects living in the pools must be destroyed already
+        void u_release_all() {
+            for (auto& pool : _pools) {
+                pool.u_release_all();
+            }
+        }
+
+        statistics u_statistics(CollectionType type) const {
+            return _pools[type].u_statistics();
+        }
+    };
+}
@@ -3,20 +3,44 @@
 
 namespace collections
 {
+    // The handle lookups (getObject, getObjectRef) take no locks: the public objects are published
+    // in the slot_table, the readers look them up within a read section.
+    // The writers are serialized by the mutex. An unpublished object gets deleted only after the read sections
+    // which could have seen it are over (see removeObject), so a reader never touches freed memory.
+    //
+    // All the objects are kept in a list, each object knows its position in the list (see object_base::_registry_index),
+    // so the registration and the removal are O(1) and allocate nothing, and a scan of all the objects streams through memory.
+    //
+    // The tagged objects are indexed by their tags (case-insensitive), so the objects with a tag are found
+    // without scanning all the objects. The index is not serialized, it gets rebuilt once the objects are loaded.
+    // The registry lock is never held around an object lock: the object locks are held while registering the objects
+    // (see object_base::uid, the path walkers creating the missing keys), so the other order would deadlock.
     class object_registry
     {
     public:
-        typedef std::unordered_set<object_base *> all_objects_set;
-        typedef std::unordered_map<Handle, object_base *> registry_container;
+        typedef std::vector<object_base *> object_list;
+        typedef std::unordered_set<object_base *> all_objects_set;  // the serialized form of the list
+        typedef std::map<util::istring, all_objects_set> tag_index;
+
+        enum : uint32_t {
+            no_index = ~0u,
+        };
 
     private:
 
         friend class object_context;
 
-        registry_container _map;
-        id_generator_type _idGen;
-        all_objects_set _all_objects;
+        slot_table _table;
+        read_epochs _readers;
+        object_list _all_objects;
+        tag_index _tagged;
+        // the objects removed since the snapshot was taken, tracked while there is a snapshot (see take_snapshot)
+        all_objects_set _removed;
+        object_list _removed_log;   // the same objects in the order of their removal
+        uint32_t _snapshots = 0;
         mutable bshared_mutex _mutex;
+        // serializes the tag changes, so the index sees them in the order the objects do. Taken with no other lock held
+        std::mutex _tag_writers;
 
         object_registry(const object_registry& );
         object_registry& operator = (const object_registry& );
@@ -28,11 +52,32 @@ namespace collections
         {
         }
 
+        bool u_contains(const object_base& obj) const {
+            const uint32_t index = obj._registry_index;
+            return index < _all_objects.size() && _all_objects[index] == &obj;
+        }
+
+        void u_link(object_base& obj) {
+            jc_assert(!u_contains(obj));
+            obj._registry_index = static_cast<uint32_t>(_all_objects.size());
+            _all_objects.push_back(&obj);
+        }
+
+        // the last object takes the place of the removed one
+        void u_unlink(object_base& obj) {
+            jc_assert(u_contains(obj));
+            object_base *last = _all_objects.back();
+            _all_objects[obj._registry_index] = last;
+            last->_registry_index = obj._registry_index;
+            _all_objects.pop_back();
+            obj._registry_index = no_index;
+        }
+
+        // A new object at the address of a removed one stays in the removed set until the snapshot gets released:
+        // the snapshot holds the address of the dead object, the new one must not be taken for it (see is_registered)
         void registerNewObject(object_base& obj) {
             write_lock g(_mutex);
-            auto itr = _all_objects.find(&obj);
-            jc_assert(itr == _all_objects.end());
-            _all_objects.insert(&obj);
+            u_link(obj);
         }
 
         Handle registerNewObjectId(object_base& obj) {
@@ -40,35 +85,106 @@ namespace collections
 
             write_lock g(_mutex);
 
-            auto id = (Handle)_idGen.new_id();
-            jc_assert(_map.find(id) == _map.end());
-            _map.insert(registry_container::value_type(id, &obj));
-            return id;
+            return _table.u_allocate(obj);
         }
 
+        // Once the function returns, the object can be safely deleted: the lookups which have found it are over
         void removeObject(object_base& obj) {
-            write_lock g(_mutex);
-            u_removeObject(obj);
+            {
+                write_lock g(_mutex);
+                u_removeObject(obj);
+            }
+
+            if (obj._uid() != Handle::Null) {
+                _readers.synchronize();
+            }
         }
 
         void u_removeObject(object_base& obj) {
             auto id = obj._uid();
             if (id != Handle::Null) {
-                _map.erase(id);
-                _idGen.reuse_id((HandleT)id);
+                _table.u_release(id);
             }
 
-            auto itr = _all_objects.find(&obj);
-            jc_assert(itr != _all_objects.end());
-            _all_objects.erase(itr);
+            u_unlink(obj);
+            u_untag(obj, obj._tag);
+
+            if (_snapshots != 0) {
+                _removed.insert(&obj);
+                _removed_log.push_back(&obj);
+            }
         }
 
-        object_base *getObject(Handle hdl) const {
-            if (hdl == Handle::Null) {
-                return nullptr;
+        void u_tag(object_base& obj, const util::istring& tag) {
+            if (!tag.empty()) {
+                _tagged[tag].insert(&obj);
+            }
+        }
+
+        void u_untag(object_base& obj, const util::istring& tag) {
+            if (tag.empty()) {
+                return;
+            }
+            auto itr = _tagged.find(tag);
+            if (itr != _tagged.end()) {
+                itr->second.erase(&obj);
+                if (itr->second.empty()) {
+                    _tagged.erase(itr);
+                }
             }
-            
-            read_lock g(_mutex);
+        }
+
+        void u_index_tags() {
+            _tagged.clear();
+            for (auto obj : _all_objects) {
+                u_tag(*obj, obj->_tag);
+            }
+        }
+
+        // The tag changes under the object lock, then the index follows under the registry lock - the locks are not nested.
+        // The caller must hold no object lock. Null or empty @tag removes the tag
+        void set_tag(object_base& obj, const char *tag) {
+            std::lock_guard<std::mutex> w(_tag_writers);
+
+            util::istring oldTag, newTag;
+            {
+                object_base::lock l(obj._mutex);
+                oldTag = obj._tag;
+                if (tag) obj._tag = tag;
+                else obj._tag.clear();
+                newTag = obj._tag;
+            }
+
+            write_lock g(_mutex);
+            u_untag(obj, oldTag);
+            u_tag(obj, newTag);
+        }
+
+        // the objects tagged with the @tag, in no particular order
+        std::vector<object_stack_ref> objects_with_tag(const char *tag) const {
+            read_lock r(_mutex);
+
+            std::vector<object_stack_ref> objects;
+            if (tag && *tag) {
+                auto itr = _tagged.find(tag);
+                if (itr != _tagged.end()) {
+                    objects.assign(itr->second.begin(), itr->second.end());
+                }
+            }
+            return objects;
+        }
+
+        size_t count_objects_with_tag(const char *tag) const {
+            read_lock r(_mutex);
+
+            if (tag && *tag) {
+                auto itr = _tagged.find(tag);
+                return itr != _tagged.end() ? itr->second.size() : 0;
+            }
+            return 0;
+        }
+
+        object_base *getObject(Handle hdl) const {
             return u_getObject(hdl);
         }
 
@@ -87,38 +203,35 @@ namespace collections
         }
 
         object_stack_ref getObjectRef(Handle hdl) const {
-            // had to copy&paste getObject function as we really must own an object BEFORE read lock will be released
+            // we really must own an object BEFORE the read section ends
             if (hdl == Handle::Null) {
                 return nullptr;
             }
-            read_lock g(_mutex);
-            return u_getObject(hdl);
+            read_epochs::read_section r(_readers);
+            return _table.get(hdl);
         }
 
         object_base *u_getObject(Handle hdl) const {
             if (hdl == Handle::Null) {
                 return nullptr;
             }
-
-            auto itr = _map.find(hdl);
-            if (itr != _map.end())
-                return itr->second;
-
-            return nullptr;
+            return _table.get(hdl);
         }
 
         void u_clear() {
-            _map.clear();
-            _idGen.u_clear();
+            _table.u_clear();
             _all_objects.clear();
+            _tagged.clear();
+            _removed.clear();
+            _removed_log.clear();
         }
 
-        all_objects_set& u_all_objects() {
+        const object_list& u_all_objects() const {
             return _all_objects;
         }
 
         size_t u_public_object_count() const {
-            return _map.size();
+            return _table.u_count();
         }
 
         size_t object_count() const {
@@ -126,49 +239,162 @@ namespace collections
             return _all_objects.size();
         }
 
+        // The copy of the object list. Until the snapshot gets released, the registry remembers the removed objects,
+        // so the objects of the snapshot can be checked without touching them, see is_registered
+        object_list take_snapshot() {
+            write_lock guard(_mutex);
+            ++_snapshots;
+            return _all_objects;
+        }
+
+        void release_snapshot() {
+            write_lock guard(_mutex);
+            jc_assert(_snapshots != 0);
+            if (--_snapshots == 0) {
+                _removed = all_objects_set();
+                _removed_log = object_list();
+            }
+        }
+
+        // the objects removed since the snapshot was taken, starting with the @first removed one.
+        // The snapshot holder learns about the removals without checking each of its objects
+        object_list removed_objects(size_t first) const {
+            read_lock guard(_mutex);
+            jc_assert(_snapshots != 0);
+            return first < _removed_log.size() ? object_list(_removed_log.begin() + first, _removed_log.end()) : object_list();
+        }
+
+        // Whether the object of the snapshot is still registered. The @obj is not dereferenced, it may be deleted already.
+        // An address removed since the snapshot was taken stays removed even if a new object has got it, so the new object
+        // is not registered for the snapshot holder - it is skipped, which is safe as it is not a garbage candidate anyway
+        bool is_registered(object_base *obj) const {
+            read_lock guard(_mutex);
+            jc_assert(_snapshots != 0);
+            return _removed.count(obj) == 0;
+        }
+
         friend class boost::serialization::access;
         BOOST_SERIALIZATION_SPLIT_MEMBER();
 
         template<class Archive>
         void save(Archive & ar, const unsigned int version) const {
-            jc_assert(version == 1);
-            ar << _all_objects << _idGen;
+            jc_assert(version == 2);
+            const all_objects_set objects(_all_objects.begin(), _all_objects.end());
+            ar << objects << _table;
+        }
+
+        void u_insert_loaded_objects(const all_objects_set& objects) {
+            for (object_base *obj : objects) {
+                u_link(*obj);
+            }
+        }
+
+        void u_insert_public_objects() {
+            for (auto& obj : _all_objects) {
+                if (obj->is_public()) {
+                    _table.u_insert(*obj);
+                }
+            }
+            _table.u_rebuild_free_slots();
         }
 
         template<class Archive>
         void load(Archive & ar, const unsigned int version) {
 
+            all_objects_set objects;
+
             switch (version) {
             default:
                 jc_assert(false);
                 break;
-            case 1:
-                ar >> _all_objects >> _idGen;
-
-                for (auto& obj : _all_objects) {
-                    if (obj->is_public()) {
-                        _map.insert(registry_container::value_type(obj->_uid(), obj));
-                    }
-                }
-
+            case 2:
+                ar >> objects >> _table;
+                u_insert_loaded_objects(objects);
+                u_insert_public_objects();
+                break;
+            case 1: {
+                // the identifiers handed out by the id_generator are kept, the generator state is not needed anymore
+                id_generator_type idGen;
+                ar >> objects >> idGen;
+                u_insert_loaded_objects(objects);
+                u_insert_public_objects();
+            }
                 break;
             case 0: {
                 typedef std::map<Handle, object_base *> registry_container_old;
                 registry_container_old oldCnt;
-                ar >> oldCnt >> _idGen;
-
-                _map.insert(oldCnt.begin(), oldCnt.end());
+                id_generator_type idGen;
+                ar >> oldCnt >> idGen;
 
-                std::transform(oldCnt.begin(), oldCnt.end(), std::inserter(_all_objects, _all_objects.begin()),
+                std::transform(oldCnt.begin(), oldCnt.end(), std::inserter(objects, objects.begin()),
                     [](const registry_container_old::value_type& pair) {
                         return pair.second;
                     }
                 );
+                u_insert_loaded_objects(objects);
+                u_insert_public_objects();
             }
                 break;
             }
+
+            u_index_tags();
         }
     };
+
+#   ifndef TEST_COMPILATION_DISABLED
+
+    namespace {
+        struct object_registry_test_object : object_base {
+            object_registry_test_object() : object_base(CollectionType::None) {}
+            void u_clear() override {}
+            SInt32 u_count() const override { return 0; }
+            void u_nullifyObjects() override {}
+        };
+    }
+
+    TEST(object_registry, object_list)
+    {
+        object_registry registry;
+        object_registry_test_object a, b, c;
+
+        registry.registerNewObject(a);
+        registry.registerNewObject(b);
+        registry.registerNewObject(c);
+        EXPECT_EQ(3u, registry.object_count());
+
+        auto snapshot = registry.take_snapshot();
+        EXPECT_EQ(3u, snapshot.size());
+
+        // the last object takes the place of the removed one
+        registry.removeObject(a);
+        EXPECT_EQ(2u, registry.object_count());
+        EXPECT_EQ(&c, registry.u_all_objects()[0]);
+        EXPECT_EQ(0u, c._registry_index);
+        EXPECT_FALSE(registry.is_registered(&a));
+        EXPECT_TRUE(registry.is_registered(&b));
+        EXPECT_TRUE(registry.is_registered(&c));
+        EXPECT_EQ(object_registry::object_list{ &a }, registry.removed_objects(0));
+        EXPECT_TRUE(registry.removed_objects(1).empty());
+
+        // a new object at the address of the removed one is not taken for the object of the snapshot
+        registry.registerNewObject(a);
+        EXPECT_FALSE(registry.is_registered(&a));
+        EXPECT_EQ(2u, a._registry_index);
+        EXPECT_EQ(3u, registry.object_count());
+        registry.release_snapshot();
+
+        // the next snapshot sees it
+        registry.take_snapshot();
+        EXPECT_TRUE(registry.is_registered(&a));
+        registry.release_snapshot();
+
+        registry.removeObject(c);
+        registry.removeObject(a);
+        registry.removeObject(b);
+        EXPECT_EQ(0u, registry.object_count());
+    }
+
+#   endif
 }
 
-BOOST_CLASS_VERSION(collections::object_registry, 1);
+BOOST_CLASS_VERSION(collections::object_registry, 2);
@@ -0,0 +1,256 @@
+#pragma once
+
+namespace collections {
+
+    // Public object slots. A handle encodes the slot index and the slot generation:
+    //
+    //     handle = generation << slot_bits | slot
+    //
+    // The free slots are kept in a stack, so a handle allocation and release is O(1), as is the lookup.
+    // A slot's generation gets bumped each time its handle is released, so a stale handle
+    // does not resolve to the object which got the slot later.
+    //
+    // The handles loaded from the saves made before the slots were introduced are arbitrary numbers.
+    // Such a handle occupies the slot it decodes into, unless the slot is already taken by another loaded handle -
+    // then the handle gets into the legacy table, keyed by its whole value. A new handle never equals a legacy one.
+    //
+    // Lookups are lock-free (see handle_table), the writers must be serialized by the owner.
+    // A lookup never touches the object itself, which may be getting deleted: the handle of the object in a slot
+    // is kept next to it.
+    class slot_table {
+
+        enum : uint32_t {
+            slot_bits = 22,
+            generation_bits = 31 - slot_bits,
+
+            slot_mask = (1 << slot_bits) - 1,
+            generation_mask = (1 << generation_bits) - 1,
+
+            // slot 0 is never used, so the handle is never zero, the last slot is never used either -
+            // the largest handle is 0x7FFFFFFE, as it was
+            max_slot = slot_mask - 1,
+        };
+
+        handle_table _slots;            // slot index -> object
+        basic_handle_table<HandleT> _handles;   // slot index -> handle of the object in the slot, set before the object
+        handle_table _legacy;           // whole handle value -> object
+        std::vector<uint16_t> _generations;
+        std::vector<uint32_t> _free_slots;
+        size_t _count = 0;
+        size_t _legacy_count = 0;
+
+        slot_table(const slot_table&) = delete;
+        slot_table& operator = (const slot_table&) = delete;
+
+        static uint32_t slot_of(Handle hdl) { return static_cast<uint32_t>(hdl) & slot_mask; }
+        static uint16_t generation_of(Handle hdl) { return static_cast<uint16_t>(static_cast<uint32_t>(hdl) >> slot_bits); }
+
+        static Handle make_handle(uint32_t slot, uint16_t generation) {
+            return static_cast<Handle>((uint32_t(generation) << slot_bits) | slot);
+        }
+
+        static bool is_usable_slot(uint32_t slot) { return slot != 0 && slot <= max_slot; }
+
+        bool u_slot_taken(uint32_t slot) const {
+            return slot < _generations.size() && _slots.get(slot) != nullptr;
+        }
+
+        uint32_t u_take_slot() {
+            if (!_free_slots.empty()) {
+                const uint32_t slot = _free_slots.back();
+                _free_slots.pop_back();
+                return slot;
+            }
+
+            const uint32_t slot = (std::max)(uint32_t(1), static_cast<uint32_t>(_generations.size()));
+            if (slot > max_slot) {
+                return 0;
+            }
+            _generations.resize(slot + 1, 0);
+            return slot;
+        }
+
+    public:
+
+        slot_table() = default;
+
+        // The object the handle refers to. The object in the slot is returned only if its handle equals to @hdl,
+        // otherwise it's the object which got the slot after the @hdl was released.
+        // The handle is read after the object: a reader which sees the object sees its handle, or a later one
+        object_base *get(Handle hdl) const {
+            const uint32_t slot = slot_of(hdl);
+            object_base *obj = _slots.get(slot);
+            if (obj && _handles.get(slot) == static_cast<HandleT>(hdl)) {
+                return obj;
+            }
+            return _legacy.get(static_cast<HandleT>(hdl));
+        }
+
+        size_t u_count() const { return _count; }
+
+        // the handle for the @obj or Handle::Null if all the slots are in use
+        Handle u_allocate(object_base& obj) {
+            const uint32_t slot = u_take_slot();
+            if (slot == 0) {
+                jc_assert(false);
+                return Handle::Null;
+            }
+
+            uint16_t& generation = _generations[slot];
+            // skip the legacy handles which are still alive
+            while (_legacy_count != 0 && _legacy.get(static_cast<HandleT>(make_handle(slot, generation)))) {
+                generation = static_cast<uint16_t>((generation + 1) & generation_mask);
+            }
+
+            const Handle hdl = make_handle(slot, generation);
+            _handles.u_set(slot, static_cast<HandleT>(hdl));
+            _slots.u_set(slot, &obj);
+            ++_count;
+            return hdl;
+        }
+
+        void u_release(Handle hdl) {
+            const uint32_t slot = slot_of(hdl);
+            if (u_slot_taken(slot) && _handles.get(slot) == static_cast<HandleT>(hdl)) {
+                _slots.u_set(slot, nullptr);
+                _generations[slot] = static_cast<uint16_t>((_generations[slot] + 1) & generation_mask);
+                _free_slots.push_back(slot);
+                --_count;
+            }
+            else if (_legacy.get(static_cast<HandleT>(hdl))) {
+                _legacy.u_set(static_cast<HandleT>(hdl), nullptr);
+                --_legacy_count;
+                --_count;
+            }
+        }
+
+        // Puts the loaded object with already assigned handle into the table.
+        // The loading ends with @u_rebuild_free_slots call
+        void u_insert(object_base& obj) {
+            const Handle hdl = obj._uid();
+            const uint32_t slot = slot_of(hdl);
+
+            if (is_usable_slot(slot) && !u_slot_taken(slot)) {
+                if (slot >= _generations.size()) {
+                    _generations.resize(slot + 1, 0);
+                }
+                _generations[slot] = generation_of(hdl);
+                _handles.u_set(slot, static_cast<HandleT>(hdl));
+                _slots.u_set(slot, &obj);
+            }
+            else {
+                jc_assert(_legacy.get(static_cast<HandleT>(hdl)) == nullptr);
+                _legacy.u_set(static_cast<HandleT>(hdl), &obj);
+                ++_legacy_count;
+            }
+            ++_count;
+        }
+
+        void u_rebuild_free_slots() {
+            _free_slots.clear();
+            // the lowest slots are taken first
+            for (uint32_t slot = static_cast<uint32_t>(_generations.size()); slot-- > 1;) {
+                if (!_slots.get(slot)) {
+                    _free_slots.push_back(slot);
+                }
+            }
+        }
+
+        void u_clear() {
+            _slots.u_clear();
+            _handles.u_clear();
+            _legacy.u_clear();
+            _generations.clear();
+            _free_slots.clear();
+            _count = 0;
+            _legacy_count = 0;
+        }
+
+        friend class boost::serialization::access;
+
+        // the generations are kept, so the handles stored by the scripts stay stale after the game gets loaded
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version) {
+            ar & _generations;
+        }
+    };
+
+#   ifndef TEST_COMPILATION_DISABLED
+
+    namespace {
+        struct slot_table_test_object : object_base {
+            slot_table_test_object() : object_base(CollectionType::None) {}
+            void u_clear() override {}
+            SInt32 u_count() const override { return 0; }
+            void u_nullifyObjects() override {}
+        };
+    }
+
+    TEST(slot_table, stale_handles)
+    {
+        slot_table table;
+        slot_table_test_object a, b, c;
+
+        a._id = table.u_allocate(a);
+        b._id = table.u_allocate(b);
+        EXPECT_EQ(&a, table.get(a._uid()));
+        EXPECT_EQ(&b, table.get(b._uid()));
+        EXPECT_EQ(2u, table.u_count());
+
+        const Handle stale = b._uid();
+        table.u_release(stale);
+        EXPECT_TRUE(table.get(stale) == nullptr);
+
+        // the slot gets reused with the next generation
+        c._id = table.u_allocate(c);
+        EXPECT_NE(stale, c._uid());
+        EXPECT_EQ(static_cast<HandleT>(stale) + (1u << 22), static_cast<HandleT>(c._uid()));
+        EXPECT_TRUE(table.get(stale) == nullptr);
+        EXPECT_EQ(&c, table.get(c._uid()));
+        EXPECT_EQ(2u, table.u_count());
+    }
+
+    TEST(slot_table, lookups_do_not_read_the_object)
+    {
+        slot_table table;
+        slot_table_test_object a;
+
+        // the handle is found even before the object knows it, as the lookup reads the handle kept in the table
+        const Handle hdl = table.u_allocate(a);
+        EXPECT_EQ(&a, table.get(hdl));
+        a._id = hdl;
+
+        table.u_release(hdl);
+        EXPECT_TRUE(table.get(hdl) == nullptr);
+    }
+
+    TEST(slot_table, legacy_handles)
+    {
+        slot_table table;
+        slot_table_test_object a, b, c;
+
+        // the identifiers as the id_generator could have handed them out: both decode into the slot 1
+        a._id = static_cast<Handle>(1);
+        b._id = static_cast<Handle>(1 + (1u << 22));
+        table.u_insert(a);
+        table.u_insert(b);
+        table.u_rebuild_free_slots();
+
+        EXPECT_EQ(&a, table.get(a._uid()));
+        EXPECT_EQ(&b, table.get(b._uid()));
+
+        // the new handle of the slot 1 skips the generation which the legacy handle occupies
+        table.u_release(a._uid());
+        c._id = table.u_allocate(c);
+        EXPECT_EQ(static_cast<Handle>(1 + (2u << 22)), c._uid());
+        EXPECT_EQ(&b, table.get(b._uid()));
+        EXPECT_EQ(&c, table.get(c._uid()));
+        EXPECT_TRUE(table.get(a._uid()) == nullptr);
+
+        table.u_release(b._uid());
+        EXPECT_TRUE(table.get(b._uid()) == nullptr);
+        EXPECT_EQ(1u, table.u_count());
+    }
+
+#   endif
+}
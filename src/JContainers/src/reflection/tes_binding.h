@@ -2,7 +2,9 @@
 
 #include "skse64/PapyrusNativeFunctions.h"
 #include "skse/string.h"
+#include "util/shared_string.h"
 #include "reflection/reflection.h"
+#include "object/object_base.h"
 
 class BGSListForm;
 
@@ -49,6 +51,10 @@ namespace reflection { namespace binding {
         static skse::string_ref convert2Tes(const AnyString& str) {
             return skse::string_ref(str);
         }
+
+        static skse::string_ref convert2Tes(const util::shared_string& str) {
+            return skse::string_ref(str.c_str());
+        }
     };
 
     template<class JType> struct GetConv : IdentityConverter < JType > {
@@ -136,7 +142,7 @@ namespace reflection { namespace binding {
 
     // Template monster, proxy class that:
     // - adapts my internal types to native Papyrus types and vica versa
-    // - generates native Papyrus function
+    // - generates native Papyrus function, which defers the stack references for the duration of the call (see deferred_stack_refs)
     // - holds function meta-info, like @parameter_info
     template <typename T> struct proxy;
     template <typename T> struct state_proxy;
@@ -170,6 +176,7 @@ namespace reflection { namespace binding {
                     StaticFunctionTag* tag,
                     convert_to_tes_type<Params> ... params)
                 {
+                    collections::deferred_stack_refs::scope refs;
                     return GetConv<R>::convert2Tes(
                         func(
                             get_converter<Params>::convert2J(params, tag) ...
@@ -183,6 +190,7 @@ namespace reflection { namespace binding {
                     StaticFunctionTag* tag,
                     convert_to_tes_type<Params> ... params)
                 {
+                    collections::deferred_stack_refs::scope refs;
                     func(get_converter<Params>::convert2J(params, tag) ...);
                 }
             };
@@ -239,6 +247,7 @@ namespace reflection { namespace binding {
                     State& state,
                     convert_to_tes_type<Params> ... params)
                 {
+                    collections::deferred_stack_refs::scope refs;
                     return GetConv<R>::convert2Tes(
                         func(
                             state,
@@ -253,6 +262,7 @@ namespace reflection { namespace binding {
                     State& state,
                     convert_to_tes_type<Params> ... params)
                 {
+                    collections::deferred_stack_refs::scope refs;
                     func(state, get_converter<Params>::convert2J(params, state) ...);
                 }
             };
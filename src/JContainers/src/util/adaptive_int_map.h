@@ -0,0 +1,272 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+#include <utility>
+#include <vector>
+#include <algorithm>
+
+namespace util {
+
+    // Map with int32_t keys stored in a flat vector sorted by key - no per-entry allocations,
+    // the n-th pair is accessible in O(1).
+    //
+    // While the keys are dense (their span is not much larger than their count) the map also keeps
+    // a direct index: the entry positions indexed by (key - lowest key), so the lookup is O(1).
+    // Once the keys get sparse the index is dropped and the lookup falls back to the binary search.
+    // The switch happens automatically, with some hysteresis so that the map doesn't flip on every insertion.
+    //
+    // Iterators are the iterators of the entry vector - random access, invalidated by insertion and erasure.
+    template<class Value>
+    class adaptive_int_map {
+    public:
+        using key_type = int32_t;
+        using mapped_type = Value;
+        using value_type = std::pair<int32_t, Value>;
+
+    private:
+        using entries_type = std::vector<value_type>;
+
+        enum : uint32_t { no_position = 0xFFFFFFFF };
+
+        entries_type _entries;
+        std::vector<uint32_t> _positions;   // the direct index, empty while the keys are sparse
+        int32_t _base = 0;                  // the key at _positions[0]
+
+    public:
+        using iterator = typename entries_type::iterator;
+        using const_iterator = typename entries_type::const_iterator;
+        using reverse_iterator = typename entries_type::reverse_iterator;
+        using const_reverse_iterator = typename entries_type::const_reverse_iterator;
+        using size_type = size_t;
+
+        enum : size_t { npos = size_t(-1) };
+
+        iterator begin() { return _entries.begin(); }
+        iterator end() { return _entries.end(); }
+        const_iterator begin() const { return _entries.begin(); }
+        const_iterator end() const { return _entries.end(); }
+        const_iterator cbegin() const { return _entries.cbegin(); }
+        const_iterator cend() const { return _entries.cend(); }
+        reverse_iterator rbegin() { return _entries.rbegin(); }
+        reverse_iterator rend() { return _entries.rend(); }
+        const_reverse_iterator rbegin() const { return _entries.rbegin(); }
+        const_reverse_iterator rend() const { return _entries.rend(); }
+
+        size_t size() const { return _entries.size(); }
+        bool empty() const { return _entries.empty(); }
+
+        // true if the lookup goes through the direct index
+        bool is_dense() const { return !_positions.empty(); }
+
+        // the entry at the position @index in the key order
+        value_type& nth(size_t index) { return _entries[index]; }
+        const value_type& nth(size_t index) const { return _entries[index]; }
+
+        // the same interface as the ordered_hash_map has, the storage positions are the iteration positions
+        size_t storage_size() const { return _entries.size(); }
+
+        template<class F>
+        void for_each_stored(size_t first, size_t last, F&& func) const {
+            for (size_t i = first; i < last && i < _entries.size(); ++i) {
+                func(_entries[i]);
+            }
+        }
+
+        void clear() {
+            _entries.clear();
+            _positions.clear();
+            _base = 0;
+        }
+
+        void reserve(size_t count) {
+            _entries.reserve(count);
+        }
+
+        // position of the key in the key order or npos
+        size_t index_of(int32_t key) const {
+            if (is_dense()) {
+                const int64_t offset = int64_t(key) - _base;
+                if (offset < 0 || offset >= int64_t(_positions.size())) {
+                    return npos;
+                }
+                const uint32_t position = _positions[size_t(offset)];
+                return position != no_position ? position : npos;
+            }
+
+            const size_t position = lower_bound_position(key);
+            return position != _entries.size() && _entries[position].first == key ? position : npos;
+        }
+
+        iterator find(int32_t key) {
+            const size_t idx = index_of(key);
+            return idx != npos ? _entries.begin() + idx : _entries.end();
+        }
+
+        const_iterator find(int32_t key) const {
+            const size_t idx = index_of(key);
+            return idx != npos ? _entries.begin() + idx : _entries.end();
+        }
+
+        size_t count(int32_t key) const {
+            return index_of(key) != npos ? 1 : 0;
+        }
+
+        iterator lower_bound(int32_t key) {
+            return _entries.begin() + lower_bound_position(key);
+        }
+
+        const_iterator lower_bound(int32_t key) const {
+            return _entries.begin() + lower_bound_position(key);
+        }
+
+        template<class V>
+        std::pair<iterator, bool> emplace(int32_t key, V&& value) {
+            const size_t idx = index_of(key);
+            if (idx != npos) {
+                return std::make_pair(_entries.begin() + idx, false);
+            }
+
+            const size_t position = lower_bound_position(key);
+            _entries.emplace(_entries.begin() + position, key, std::forward<V>(value));
+            on_inserted(position);
+            return std::make_pair(_entries.begin() + position, true);
+        }
+
+        std::pair<iterator, bool> insert(const value_type& pair) {
+            return emplace(pair.first, pair.second);
+        }
+
+        // inserts the pairs whose keys are not present yet
+        template<class InputIterator>
+        void insert(InputIterator first, InputIterator last) {
+            for (; first != last; ++first) {
+                emplace(first->first, first->second);
+            }
+        }
+
+        Value& operator [] (int32_t key) {
+            return emplace(key, Value()).first->second;
+        }
+
+        iterator erase(const_iterator where) {
+            const size_t position = where - _entries.cbegin();
+            const int32_t key = where->first;
+            _entries.erase(_entries.begin() + position);
+            on_erased(key, position);
+            return _entries.begin() + position;
+        }
+
+        iterator erase(iterator where) {
+            return erase(const_iterator(where));
+        }
+
+        size_t erase(int32_t key) {
+            const size_t idx = index_of(key);
+            if (idx == npos) {
+                return 0;
+            }
+            erase(_entries.cbegin() + idx);
+            return 1;
+        }
+
+        void swap(adaptive_int_map& other) {
+            _entries.swap(other._entries);
+            _positions.swap(other._positions);
+            std::swap(_base, other._base);
+        }
+
+    private:
+
+        // the index is built once the span of the keys is at most twice their count
+        // and dropped once it grows over four times their count
+        static bool dense_enough(int64_t span, size_t count) {
+            return span <= int64_t(count) * 2 + 8;
+        }
+
+        static bool too_sparse(int64_t span, size_t count) {
+            return span > int64_t(count) * 4 + 16;
+        }
+
+        int64_t key_span() const {
+            return _entries.empty() ? 0 : int64_t(_entries.back().first) - _entries.front().first + 1;
+        }
+
+        size_t lower_bound_position(int32_t key) const {
+            auto itr = std::lower_bound(_entries.begin(), _entries.end(), key,
+                [](const value_type& pair, int32_t k) { return pair.first < k; });
+            return itr - _entries.begin();
+        }
+
+        uint32_t& position_of(int32_t key) {
+            return _positions[size_t(int64_t(key) - _base)];
+        }
+
+        void build_index() {
+            _positions.clear();
+            if (_entries.empty()) {
+                return;
+            }
+
+            _base = _entries.front().first;
+            _positions.assign(size_t(key_span()), no_position);
+            for (size_t i = 0; i < _entries.size(); ++i) {
+                position_of(_entries[i].first) = static_cast<uint32_t>(i);
+            }
+        }
+
+        void on_inserted(size_t position) {
+            if (!is_dense()) {
+                if (dense_enough(key_span(), _entries.size())) {
+                    build_index();
+                }
+                return;
+            }
+
+            const int32_t key = _entries[position].first;
+            const int64_t offset = int64_t(key) - _base;
+
+            if (offset < 0 || offset >= int64_t(_positions.size())) {
+                // the key is out of the indexed span
+                if (too_sparse(key_span(), _entries.size())) {
+                    _positions.clear();
+                }
+                else if (offset > 0) {
+                    // the greatest key: the index grows at the back (amortized O(1) when the keys are appended in order)
+                    _positions.resize(size_t(offset) + 1, no_position);
+                    position_of(key) = static_cast<uint32_t>(position);
+                }
+                else {
+                    build_index();
+                }
+                return;
+            }
+
+            position_of(key) = static_cast<uint32_t>(position);
+            for (size_t i = position + 1; i < _entries.size(); ++i) {
+                ++position_of(_entries[i].first);
+            }
+        }
+
+        void on_erased(int32_t key, size_t position) {
+            if (!is_dense()) {
+                if (dense_enough(key_span(), _entries.size())) {
+                    build_index();
+                }
+                return;
+            }
+
+            position_of(key) = no_position;
+            for (size_t i = position; i < _entries.size(); ++i) {
+                --position_of(_entries[i].first);
+            }
+
+            if (too_sparse(int64_t(_positions.size()), _entries.size())) {
+                _positions.clear();
+                if (dense_enough(key_span(), _entries.size())) {
+                    build_index();
+                }
+            }
+        }
+    };
+}
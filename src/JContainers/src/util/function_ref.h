@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace util {
+
+    template<class Signature>
+    class function_ref;
+
+    // Non-owning reference to a callable: no allocation, no copying of the callable.
+    // The callable must outlive the reference, so it suits the parameters only
+    template<class R, class... Args>
+    class function_ref<R(Args...)>
+    {
+        void *_callable;
+        R (*_invoke)(void *, Args...);
+
+    public:
+
+        template<class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, function_ref>::value>::type>
+        function_ref(F&& callable)
+            : _callable(const_cast<void *>(static_cast<const void *>(std::addressof(callable))))
+            , _invoke([](void *callable, Args... args) -> R {
+                return (*static_cast<typename std::remove_reference<F>::type *>(callable))(std::forward<Args>(args)...);
+            })
+        {
+        }
+
+        R operator () (Args... args) const {
+            return _invoke(_callable, std::forward<Args>(args)...);
+        }
+    };
+}
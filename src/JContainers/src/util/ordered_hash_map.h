@@ -0,0 +1,521 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+
+namespace util {
+
+    // Hash map which keeps its entries in a vector in insertion order.
+    // The entries are indexed by an open-addressing (linear probing) table of (hash, entry index) slots,
+    // so the lookup compares the keys only when the whole 32-bit hashes are equal.
+    //
+    // An erased entry leaves a hole, so the erasure doesn't move the other entries. While there are holes,
+    // a Fenwick tree counts the live entries, so the position of an entry in the iteration order (nth, index_of)
+    // takes O(log n). Once the holes outnumber the entries, the entries get compacted: the erasure is O(log n) amortized.
+    //
+    // Traits must provide:
+    //   static uint32_t hash(const K& key)                     - for Key and every lookup type K
+    //   static bool equal(const Key& stored, const K& key)     - for Key and every lookup type K
+    //
+    // Iterators are bidirectional, invalidated by insertion and erasure.
+    // Erasure preserves the order of the remaining entries.
+    template<class Key, class Value, class Traits>
+    class ordered_hash_map {
+    public:
+        using key_type = Key;
+        using mapped_type = Value;
+        using value_type = std::pair<Key, Value>;
+        using traits_type = Traits;
+
+    private:
+        using entries_type = std::vector<value_type>;
+
+        struct slot {
+            uint32_t hash;
+            uint32_t index;
+        };
+
+        enum : uint32_t { empty_index = 0xFFFFFFFF };
+        enum : size_t { min_capacity = 8 };
+
+        entries_type _entries;          // the live entries and the holes
+        std::vector<slot> _slots;
+        uint32_t _shift = 32;   // 32 - log2(slot count)
+
+        // tracked while there are holes only
+        size_t _holes = 0;
+        std::vector<bool> _erased;
+        std::vector<uint32_t> _ranks;   // the Fenwick tree of the live entries, 1-based
+
+        bool is_hole(size_t position) const {
+            return _holes != 0 && _erased[position];
+        }
+
+        template<class Map, class Entry>
+        class basic_iterator {
+            template<class, class> friend class basic_iterator;
+            friend class ordered_hash_map;
+
+            Map *_map = nullptr;
+            size_t _position = 0;   // in the entry vector
+
+            void skip_holes() {
+                while (_position < _map->_entries.size() && _map->is_hole(_position)) {
+                    ++_position;
+                }
+            }
+
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = typename ordered_hash_map::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = Entry *;
+            using reference = Entry &;
+
+            basic_iterator() = default;
+            basic_iterator(Map *map, size_t position) : _map(map), _position(position) { skip_holes(); }
+
+            // iterator to const_iterator
+            template<class M, class E, class = typename std::enable_if<std::is_convertible<E *, Entry *>::value>::type>
+            basic_iterator(const basic_iterator<M, E>& other) : _map(other._map), _position(other._position) {}
+
+            reference operator * () const { return _map->_entries[_position]; }
+            pointer operator -> () const { return &_map->_entries[_position]; }
+
+            basic_iterator& operator ++ () {
+                ++_position;
+                skip_holes();
+                return *this;
+            }
+
+            basic_iterator operator ++ (int) {
+                basic_iterator copy(*this);
+                ++*this;
+                return copy;
+            }
+
+            basic_iterator& operator -- () {
+                do {
+                    --_position;
+                } while (_map->is_hole(_position));
+                return *this;
+            }
+
+            basic_iterator operator -- (int) {
+                basic_iterator copy(*this);
+                --*this;
+                return copy;
+            }
+
+            template<class M, class E>
+            bool operator == (const basic_iterator<M, E>& other) const { return _position == other._position; }
+            template<class M, class E>
+            bool operator != (const basic_iterator<M, E>& other) const { return _position != other._position; }
+        };
+
+    public:
+        using iterator = basic_iterator<ordered_hash_map, value_type>;
+        using const_iterator = basic_iterator<const ordered_hash_map, const value_type>;
+        using reverse_iterator = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+        using size_type = size_t;
+
+        enum : size_t { npos = size_t(-1) };
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, _entries.size()); }
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, _entries.size()); }
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+        reverse_iterator rbegin() { return reverse_iterator(end()); }
+        reverse_iterator rend() { return reverse_iterator(begin()); }
+        const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+        const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+        size_t size() const { return _entries.size() - _holes; }
+        bool empty() const { return size() == 0; }
+
+        // the entry at the position @index in the iteration order
+        value_type& nth(size_t index) { return _entries[position_of_nth(index)]; }
+        const value_type& nth(size_t index) const { return _entries[position_of_nth(index)]; }
+
+        // The storage positions: the entries and the holes. The positions don't move while nothing gets inserted
+        // or erased, so an iteration over the [@first, @last) storage positions can be resumed later
+        size_t storage_size() const { return _entries.size(); }
+
+        template<class F>
+        void for_each_stored(size_t first, size_t last, F&& func) const {
+            for (size_t i = first; i < last && i < _entries.size(); ++i) {
+                if (!is_hole(i)) {
+                    func(_entries[i]);
+                }
+            }
+        }
+
+        void clear() {
+            _entries.clear();
+            _slots.clear();
+            _shift = 32;
+            stop_tracking_holes();
+        }
+
+        void reserve(size_t count) {
+            _entries.reserve(count + _holes);
+            if (count > max_load(_slots.size())) {
+                rehash(slots_for(count));
+            }
+        }
+
+        // position of the key in the iteration order or npos
+        template<class K>
+        size_t index_of(const K& key) const {
+            const size_t position = position_of(key);
+            return position != npos && _holes != 0 ? rank(position) : position;
+        }
+
+        template<class K>
+        iterator find(const K& key) {
+            const size_t position = position_of(key);
+            return position != npos ? iterator(this, position) : end();
+        }
+
+        template<class K>
+        const_iterator find(const K& key) const {
+            const size_t position = position_of(key);
+            return position != npos ? const_iterator(this, position) : end();
+        }
+
+        template<class K>
+        size_t count(const K& key) const {
+            return position_of(key) != npos ? 1 : 0;
+        }
+
+        // Looks up the @key. If there is no such key, appends the (make_key(), Value()) entry,
+        // so the stored key gets constructed (interned, for ex.) only when it's really needed
+        template<class K, class MakeKey>
+        std::pair<iterator, bool> find_or_emplace(const K& key, MakeKey&& make_key) {
+            const uint32_t hash = Traits::hash(key);
+            const size_t s = find_slot(key, hash);
+            if (s != npos) {
+                return std::make_pair(iterator(this, _slots[s].index), false);
+            }
+            append(make_key(), Value(), hash);
+            return std::make_pair(iterator(this, _entries.size() - 1), true);
+        }
+
+        template<class V>
+        std::pair<iterator, bool> emplace(const Key& key, V&& value) {
+            return emplace_hashed(Key(key), std::forward<V>(value));
+        }
+
+        template<class V>
+        std::pair<iterator, bool> emplace(Key&& key, V&& value) {
+            return emplace_hashed(std::move(key), std::forward<V>(value));
+        }
+
+        std::pair<iterator, bool> insert(const value_type& pair) {
+            return emplace(pair.first, pair.second);
+        }
+
+        // inserts the entries whose keys are not present yet
+        template<class InputIterator>
+        void insert(InputIterator first, InputIterator last) {
+            for (; first != last; ++first) {
+                emplace(first->first, first->second);
+            }
+        }
+
+        Value& operator [] (const Key& key) {
+            return find_or_emplace(key, [&key]() { return key; }).first->second;
+        }
+
+        // O(log n) amortized: the entry becomes a hole
+        iterator erase(const_iterator position) {
+            const size_t idx = position._position;
+            value_type& entry = _entries[idx];
+            const size_t s = find_slot(entry.first, Traits::hash(entry.first));
+            assert(s != npos && _slots[s].index == idx);
+
+            remove_slot(s);
+            entry = value_type();
+
+            if (idx + 1 == _entries.size()) {
+                _entries.pop_back();
+                if (_holes != 0) {
+                    _erased.pop_back();
+                    _ranks.pop_back();
+                    drop_trailing_holes();
+                }
+                return end();
+            }
+
+            if (_holes == 0) {
+                start_tracking_holes();
+            }
+            _erased[idx] = true;
+            ++_holes;
+            add_rank(idx, -1);
+
+            if (_holes > size()) {
+                const size_t next = rank(idx);
+                compact_if([](const value_type&) { return false; });
+                return iterator(this, next);
+            }
+            return iterator(this, idx);
+        }
+
+        iterator erase(iterator position) {
+            return erase(const_iterator(position));
+        }
+
+        template<class K>
+        size_t erase(const K& key) {
+            const size_t position = position_of(key);
+            if (position == npos) {
+                return 0;
+            }
+            erase(const_iterator(this, position));
+            return 1;
+        }
+
+        // erases all the entries matching the predicate in one pass, keeps the order of the rest
+        template<class Predicate>
+        size_t erase_if(Predicate&& pred) {
+            return compact_if(std::forward<Predicate>(pred));
+        }
+
+        void swap(ordered_hash_map& other) {
+            _entries.swap(other._entries);
+            _slots.swap(other._slots);
+            std::swap(_shift, other._shift);
+            std::swap(_holes, other._holes);
+            _erased.swap(other._erased);
+            _ranks.swap(other._ranks);
+        }
+
+    private:
+
+        template<class K>
+        size_t position_of(const K& key) const {
+            const size_t s = find_slot(key, Traits::hash(key));
+            return s != npos ? _slots[s].index : npos;
+        }
+
+        // the Fenwick tree: the number of the live entries before the @position
+        size_t rank(size_t position) const {
+            size_t count = 0;
+            for (size_t i = position; i > 0; i -= i & (0 - i)) {
+                count += _ranks[i];
+            }
+            return count;
+        }
+
+        void add_rank(size_t position, int32_t delta) {
+            for (size_t i = position + 1; i < _ranks.size(); i += i & (0 - i)) {
+                _ranks[i] += static_cast<uint32_t>(delta);
+            }
+        }
+
+        // the position of the live entry which has @index live entries before it
+        size_t position_of_nth(size_t index) const {
+            if (_holes == 0) {
+                return index;
+            }
+            size_t bit = 1;
+            while (bit * 2 < _ranks.size()) {
+                bit *= 2;
+            }
+            size_t position = 0;
+            for (; bit != 0; bit /= 2) {
+                if (position + bit < _ranks.size() && _ranks[position + bit] <= index) {
+                    position += bit;
+                    index -= _ranks[position];
+                }
+            }
+            return position;
+        }
+
+        // all the entries are live at this moment
+        void start_tracking_holes() {
+            const size_t count = _entries.size();
+            _erased.assign(count, false);
+            _ranks.assign(count + 1, 0);
+            for (size_t i = 1; i <= count; ++i) {
+                _ranks[i] += 1;
+                const size_t parent = i + (i & (0 - i));
+                if (parent <= count) {
+                    _ranks[parent] += _ranks[i];
+                }
+            }
+        }
+
+        void stop_tracking_holes() {
+            _holes = 0;
+            _erased = std::vector<bool>();
+            _ranks = std::vector<uint32_t>();
+        }
+
+        void drop_trailing_holes() {
+            while (!_entries.empty() && _erased.back()) {
+                _entries.pop_back();
+                _erased.pop_back();
+                _ranks.pop_back();
+                --_holes;
+            }
+            if (_holes == 0) {
+                stop_tracking_holes();
+            }
+        }
+
+        // removes the holes and the live entries matching the predicate, keeps the order of the rest
+        template<class Predicate>
+        size_t compact_if(Predicate&& pred) {
+            // recover the hashes by entry position - the keys are not rehashed
+            std::vector<uint32_t> hashes(_entries.size());
+            for (const slot& sl : _slots) {
+                if (sl.index != empty_index) {
+                    hashes[sl.index] = sl.hash;
+                }
+            }
+
+            size_t kept = 0;
+            for (size_t i = 0; i < _entries.size(); ++i) {
+                if (!is_hole(i) && !pred(static_cast<const value_type&>(_entries[i]))) {
+                    if (kept != i) {
+                        _entries[kept] = std::move(_entries[i]);
+                        hashes[kept] = hashes[i];
+                    }
+                    ++kept;
+                }
+            }
+
+            const size_t removed = size() - kept;
+            if (kept != _entries.size()) {
+                _entries.erase(_entries.begin() + kept, _entries.end());
+                stop_tracking_holes();
+                std::fill(_slots.begin(), _slots.end(), slot{ 0, empty_index });
+                for (size_t i = 0; i < kept; ++i) {
+                    place(hashes[i], static_cast<uint32_t>(i));
+                }
+            }
+            return removed;
+        }
+
+        static size_t max_load(size_t slot_count) {
+            return slot_count - slot_count / 4;
+        }
+
+        static size_t slots_for(size_t count) {
+            size_t slots = min_capacity;
+            while (max_load(slots) < count) {
+                slots *= 2;
+            }
+            return slots;
+        }
+
+        // Fibonacci hashing: spreads the sequential hashes (FormIds, for ex.) over the table
+        size_t home_of(uint32_t hash) const {
+            return static_cast<size_t>((hash * 2654435769u) >> _shift);
+        }
+
+        size_t mask() const {
+            return _slots.size() - 1;
+        }
+
+        template<class K>
+        size_t find_slot(const K& key, uint32_t hash) const {
+            if (_slots.empty()) {
+                return npos;
+            }
+
+            for (size_t s = home_of(hash);; s = (s + 1) & mask()) {
+                const slot& sl = _slots[s];
+                if (sl.index == empty_index) {
+                    return npos;
+                }
+                if (sl.hash == hash && Traits::equal(_entries[sl.index].first, key)) {
+                    return s;
+                }
+            }
+        }
+
+        void place(uint32_t hash, uint32_t index) {
+            size_t s = home_of(hash);
+            while (_slots[s].index != empty_index) {
+                s = (s + 1) & mask();
+            }
+            _slots[s] = slot{ hash, index };
+        }
+
+        template<class V>
+        std::pair<iterator, bool> emplace_hashed(Key&& key, V&& value) {
+            const uint32_t hash = Traits::hash(key);
+            const size_t s = find_slot(key, hash);
+            if (s != npos) {
+                return std::make_pair(iterator(this, _slots[s].index), false);
+            }
+            append(std::move(key), std::forward<V>(value), hash);
+            return std::make_pair(iterator(this, _entries.size() - 1), true);
+        }
+
+        template<class K, class V>
+        void append(K&& key, V&& value, uint32_t hash) {
+            if (size() + 1 > max_load(_slots.size())) {
+                rehash(slots_for(size() + 1));
+            }
+            _entries.emplace_back(std::forward<K>(key), std::forward<V>(value));
+            place(hash, static_cast<uint32_t>(_entries.size() - 1));
+
+            if (_holes != 0) {
+                _erased.push_back(false);
+                const size_t i = _ranks.size();
+                _ranks.push_back(0);
+                _ranks[i] = static_cast<uint32_t>(1 + rank(i - 1) - rank(i - (i & (0 - i))));
+            }
+        }
+
+        void rehash(size_t slot_count) {
+            assert((slot_count & (slot_count - 1)) == 0);
+
+            uint32_t shift = 32;
+            for (size_t n = slot_count; n > 1; n /= 2) {
+                --shift;
+            }
+
+            std::vector<slot> old(slot_count, slot{ 0, empty_index });
+            old.swap(_slots);
+            _shift = shift;
+
+            for (const slot& sl : old) {
+                if (sl.index != empty_index) {
+                    place(sl.hash, sl.index);
+                }
+            }
+        }
+
+        // backward shift deletion: no tombstones, the probe sequences stay short
+        void remove_slot(size_t hole) {
+            size_t s = hole;
+            for (;;) {
+                s = (s + 1) & mask();
+                const slot& sl = _slots[s];
+                if (sl.index == empty_index) {
+                    break;
+                }
+                // the slot may fill the hole if the hole lies between its home position and itself
+                const size_t home = home_of(sl.hash);
+                if (((s - home) & mask()) >= ((s - hole) & mask())) {
+                    _slots[hole] = sl;
+                    hole = s;
+                }
+            }
+            _slots[hole].index = empty_index;
+        }
+    };
+}
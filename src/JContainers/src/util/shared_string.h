@@ -0,0 +1,234 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <unordered_map>
+
+#include "util/spinlock.h"
+
+namespace util {
+
+    class string_pool;
+
+    // FNV-1a over ASCII-lowercased characters: the strings which are equal
+    // in terms of _stricmp have equal hashes
+    inline uint32_t case_folded_hash(const char* str, size_t length) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; ++i) {
+            unsigned char c = static_cast<unsigned char>(str[i]);
+            if (c >= 'A' && c <= 'Z') {
+                c += 'a' - 'A';
+            }
+            hash = (hash ^ c) * 16777619u;
+        }
+        return hash;
+    }
+
+    // Immutable, reference counted string. Copies share the same heap block,
+    // so a long string stored in many items occupies the memory only once
+    class shared_string {
+    public:
+
+        struct block {
+            std::atomic<int32_t> refs;
+            uint32_t length;
+            uint32_t ihash;         // case_folded_hash of the characters
+            string_pool* pool;      // the pool the string is interned in, if any
+            char chars[1];
+
+            static block* allocate(const char* str, size_t length, string_pool* pool = nullptr) {
+                void *memory = ::operator new(offsetof(block, chars) + length + 1);
+                block *b = static_cast<block *>(memory);
+                new (&b->refs) std::atomic<int32_t>(1);
+                b->length = static_cast<uint32_t>(length);
+                b->ihash = case_folded_hash(str, length);
+                b->pool = pool;
+                memcpy(b->chars, str, length);
+                b->chars[length] = '\0';
+                return b;
+            }
+
+            void retain() {
+                refs.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // retains the block unless it's already being destroyed
+            bool try_retain() {
+                int32_t count = refs.load(std::memory_order_relaxed);
+                while (count > 0) {
+                    if (refs.compare_exchange_weak(count, count + 1, std::memory_order_relaxed)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void release();
+        };
+
+    private:
+        block* _block = nullptr;
+
+        friend class string_pool;
+
+        // takes the ownership of the already retained block
+        explicit shared_string(block* b) : _block(b) {}
+
+    public:
+
+        shared_string() = default;
+
+        shared_string(const char* str, size_t length) : _block(block::allocate(str, length)) {}
+
+        shared_string(const shared_string& other) : _block(other._block) {
+            if (_block) {
+                _block->retain();
+            }
+        }
+
+        shared_string(shared_string&& other) noexcept : _block(other._block) {
+            other._block = nullptr;
+        }
+
+        shared_string& operator = (const shared_string& other) {
+            shared_string(other).swap(*this);
+            return *this;
+        }
+
+        shared_string& operator = (shared_string&& other) noexcept {
+            shared_string(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        ~shared_string() {
+            if (_block) {
+                _block->release();
+            }
+        }
+
+        void swap(shared_string& other) noexcept {
+            std::swap(_block, other._block);
+        }
+
+        const char* c_str() const { return _block ? _block->chars : ""; }
+        size_t size() const { return _block ? _block->length : 0; }
+        bool empty() const { return size() == 0; }
+
+        uint32_t ihash() const { return _block ? _block->ihash : case_folded_hash("", 0); }
+
+        // the number of items and keys sharing the block
+        int32_t use_count() const {
+            return _block ? _block->refs.load(std::memory_order_relaxed) : 0;
+        }
+
+        bool shares_block_with(const shared_string& other) const { return _block == other._block; }
+
+        explicit operator bool() const { return _block != nullptr; }
+
+        // case-insensitive equality. Interned strings of the same spelling are compared by pointer,
+        // strings with different hashes can't be equal
+        bool iequals(const shared_string& other) const {
+            return _block == other._block
+                || (ihash() == other.ihash() && _stricmp(c_str(), other.c_str()) == 0);
+        }
+    };
+
+    static_assert(sizeof(shared_string) == sizeof(void*), "shared_string is expected to be stored in-place");
+
+    // Intern table: interning equal strings returns the same block.
+    // The table is indexed by the case-folded hash, so the strings differing in case only
+    // land in the same bucket, but stay distinct entries - the values must preserve their case.
+    // The table does not own the strings: a block removes itself once its last reference dies
+    class string_pool {
+        using table = std::unordered_multimap<uint32_t, shared_string::block*>;
+
+        mutable spinlock _lock;
+        table _strings;
+
+        friend struct shared_string::block;
+
+        void _forget(shared_string::block* b) {
+            spinlock::guard g(_lock);
+            auto range = _strings.equal_range(b->ihash);
+            for (auto itr = range.first; itr != range.second; ++itr) {
+                if (itr->second == b) {
+                    _strings.erase(itr);
+                    break;
+                }
+            }
+        }
+
+    public:
+
+        string_pool() = default;
+        string_pool(const string_pool&) = delete;
+        string_pool& operator = (const string_pool&) = delete;
+
+        ~string_pool() {
+            spinlock::guard g(_lock);
+            for (auto& pair : _strings) {
+                pair.second->pool = nullptr;
+            }
+        }
+
+        shared_string intern(const char* str, size_t length) {
+            const uint32_t hash = case_folded_hash(str, length);
+
+            spinlock::guard g(_lock);
+            auto range = _strings.equal_range(hash);
+            for (auto itr = range.first; itr != range.second; ++itr) {
+                shared_string::block *b = itr->second;
+                if (b->length == length && memcmp(b->chars, str, length) == 0 && b->try_retain()) {
+                    return shared_string(b);
+                }
+            }
+
+            auto b = shared_string::block::allocate(str, length, this);
+            _strings.emplace(hash, b);
+            return shared_string(b);
+        }
+
+        shared_string intern(const char* str) {
+            return intern(str, strlen(str));
+        }
+
+        shared_string intern(const shared_string& str) {
+            if (str._block && str._block->pool == this) {
+                return str;
+            }
+            return intern(str.c_str(), str.size());
+        }
+
+        struct statistics {
+            size_t strings = 0;         // unique strings in the table
+            size_t bytes = 0;           // the characters they occupy
+            size_t bytes_saved = 0;     // the characters their duplicates would have occupied
+        };
+
+        statistics u_statistics() const {
+            statistics stats;
+            spinlock::guard g(_lock);
+            for (auto& pair : _strings) {
+                const size_t bytes = pair.second->length + 1;
+                const int32_t refs = pair.second->refs.load(std::memory_order_relaxed);
+                ++stats.strings;
+                stats.bytes += bytes;
+                stats.bytes_saved += refs > 1 ? bytes * (refs - 1) : 0;
+            }
+            return stats;
+        }
+    };
+
+    inline void shared_string::block::release() {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            if (pool) {
+                pool->_forget(this);
+            }
+            ::operator delete(this);
+        }
+    }
+}
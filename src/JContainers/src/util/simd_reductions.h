@@ -0,0 +1,322 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#   define JC_SIMD_AVX2 1
+#   define JC_SIMD_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define JC_SIMD_SSE2 1
+#endif
+
+// Reductions over plain integer and float arrays: sum, product, min and max.
+// AVX2 kernels when the compiler targets AVX2, SSE2 otherwise, with the scalar loops for the tails
+// and for the targets without SSE2.
+//
+// The integer sum is exact (64-bit), the integer product wraps around like a 32-bit multiplication,
+// the real_product of the integers doesn't wrap - it is accumulated in double precision.
+// The float sum and product are accumulated in double precision, so the different order of the operations
+// the vector lanes introduce practically never shows up in the float result.
+// The min/max functions expect a non-empty range.
+namespace util { namespace simd {
+
+    namespace scalar {
+
+        inline int64_t sum(const int32_t* v, size_t first, size_t count) {
+            int64_t total = 0;
+            for (size_t i = first; i < count; ++i) {
+                total += v[i];
+            }
+            return total;
+        }
+
+        inline double sum(const float* v, size_t first, size_t count) {
+            double total = 0;
+            for (size_t i = first; i < count; ++i) {
+                total += v[i];
+            }
+            return total;
+        }
+
+        inline uint32_t product(const int32_t* v, size_t first, size_t count) {
+            uint32_t total = 1;
+            for (size_t i = first; i < count; ++i) {
+                total *= static_cast<uint32_t>(v[i]);
+            }
+            return total;
+        }
+
+        inline double product(const float* v, size_t first, size_t count) {
+            double total = 1;
+            for (size_t i = first; i < count; ++i) {
+                total *= v[i];
+            }
+            return total;
+        }
+
+        inline double real_product(const int32_t* v, size_t first, size_t count) {
+            double total = 1;
+            for (size_t i = first; i < count; ++i) {
+                total *= v[i];
+            }
+            return total;
+        }
+
+        template<class T>
+        inline T min(const T* v, size_t first, size_t count, T current) {
+            for (size_t i = first; i < count; ++i) {
+                current = (std::min)(current, v[i]);
+            }
+            return current;
+        }
+
+        template<class T>
+        inline T max(const T* v, size_t first, size_t count, T current) {
+            for (size_t i = first; i < count; ++i) {
+                current = (std::max)(current, v[i]);
+            }
+            return current;
+        }
+    }
+
+#if JC_SIMD_SSE2
+    namespace detail {
+
+        inline int64_t hsum_epi64(__m128i v) {
+            alignas(16) int64_t lanes[2];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+            return lanes[0] + lanes[1];
+        }
+
+        inline double hsum_pd(__m128d v) {
+            return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+        }
+
+        inline double hproduct_pd(__m128d v) {
+            return _mm_cvtsd_f64(_mm_mul_sd(v, _mm_unpackhi_pd(v, v)));
+        }
+
+        // SSE2 has no 32-bit integer min/max: select through the comparison mask
+        inline __m128i min_epi32(__m128i a, __m128i b) {
+            const __m128i greater = _mm_cmpgt_epi32(a, b);
+            return _mm_or_si128(_mm_and_si128(greater, b), _mm_andnot_si128(greater, a));
+        }
+
+        inline __m128i max_epi32(__m128i a, __m128i b) {
+            const __m128i greater = _mm_cmpgt_epi32(a, b);
+            return _mm_or_si128(_mm_and_si128(greater, a), _mm_andnot_si128(greater, b));
+        }
+
+        template<class T, class V>
+        inline T lanes_reduce(V v, const T& (*pick)(const T&, const T&)) {
+            alignas(32) T lanes[sizeof(V) / sizeof(T)];
+            memcpy(lanes, &v, sizeof(V));
+            T result = lanes[0];
+            for (size_t i = 1; i < sizeof(V) / sizeof(T); ++i) {
+                result = pick(result, lanes[i]);
+            }
+            return result;
+        }
+    }
+#endif
+
+    inline int64_t sum(const int32_t* v, size_t count) {
+        size_t i = 0;
+        int64_t total = 0;
+#if JC_SIMD_AVX2
+        __m256i acc = _mm256_setzero_si256();
+        for (; i + 8 <= count; i += 8) {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+            acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(x)));
+            acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1)));
+        }
+        total += detail::hsum_epi64(_mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+#elif JC_SIMD_SSE2
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 4 <= count; i += 4) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+            const __m128i sign = _mm_srai_epi32(x, 31);
+            acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(x, sign));
+            acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(x, sign));
+        }
+        total += detail::hsum_epi64(acc);
+#endif
+        return total + scalar::sum(v, i, count);
+    }
+
+    inline double sum(const float* v, size_t count) {
+        size_t i = 0;
+        double total = 0;
+#if JC_SIMD_AVX2
+        __m256d acc = _mm256_setzero_pd();
+        for (; i + 8 <= count; i += 8) {
+            const __m256 x = _mm256_loadu_ps(v + i);
+            acc = _mm256_add_pd(acc, _mm256_cvtps_pd(_mm256_castps256_ps128(x)));
+            acc = _mm256_add_pd(acc, _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)));
+        }
+        total += detail::hsum_pd(_mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1)));
+#elif JC_SIMD_SSE2
+        __m128d acc = _mm_setzero_pd();
+        for (; i + 4 <= count; i += 4) {
+            const __m128 x = _mm_loadu_ps(v + i);
+            acc = _mm_add_pd(acc, _mm_cvtps_pd(x));
+            acc = _mm_add_pd(acc, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+        }
+        total += detail::hsum_pd(acc);
+#endif
+        return total + scalar::sum(v, i, count);
+    }
+
+    inline int32_t product(const int32_t* v, size_t count) {
+        size_t i = 0;
+        uint32_t total = 1;
+#if JC_SIMD_AVX2
+        __m256i acc = _mm256_set1_epi32(1);
+        for (; i + 8 <= count; i += 8) {
+            acc = _mm256_mullo_epi32(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)));
+        }
+        alignas(32) uint32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        for (uint32_t lane : lanes) {
+            total *= lane;
+        }
+#endif
+        // SSE2 has no 32-bit integer multiplication which keeps the low halves - the scalar loop does it
+        return static_cast<int32_t>(total * scalar::product(v, i, count));
+    }
+
+    inline double product(const float* v, size_t count) {
+        size_t i = 0;
+        double total = 1;
+#if JC_SIMD_AVX2
+        __m256d acc = _mm256_set1_pd(1);
+        for (; i + 4 <= count; i += 4) {
+            acc = _mm256_mul_pd(acc, _mm256_cvtps_pd(_mm_loadu_ps(v + i)));
+        }
+        total *= detail::hproduct_pd(_mm_mul_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1)));
+#elif JC_SIMD_SSE2
+        __m128d acc = _mm_set1_pd(1);
+        for (; i + 2 <= count; i += 2) {
+            acc = _mm_mul_pd(acc, _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(v + i)))));
+        }
+        total *= detail::hproduct_pd(acc);
+#endif
+        return total * scalar::product(v, i, count);
+    }
+
+    inline double real_product(const int32_t* v, size_t count) {
+        size_t i = 0;
+        double total = 1;
+#if JC_SIMD_AVX2
+        __m256d acc = _mm256_set1_pd(1);
+        for (; i + 4 <= count; i += 4) {
+            acc = _mm256_mul_pd(acc, _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i))));
+        }
+        total *= detail::hproduct_pd(_mm_mul_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1)));
+#elif JC_SIMD_SSE2
+        __m128d acc = _mm_set1_pd(1);
+        for (; i + 2 <= count; i += 2) {
+            acc = _mm_mul_pd(acc, _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + i))));
+        }
+        total *= detail::hproduct_pd(acc);
+#endif
+        return total * scalar::real_product(v, i, count);
+    }
+
+    inline int32_t min(const int32_t* v, size_t count) {
+        size_t i = 0;
+        int32_t result = v[0];
+#if JC_SIMD_AVX2
+        if (count >= 8) {
+            __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v));
+            for (i = 8; i + 8 <= count; i += 8) {
+                acc = _mm256_min_epi32(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)));
+            }
+            result = detail::lanes_reduce<int32_t>(acc, &std::min<int32_t>);
+        }
+#elif JC_SIMD_SSE2
+        if (count >= 4) {
+            __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v));
+            for (i = 4; i + 4 <= count; i += 4) {
+                acc = detail::min_epi32(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)));
+            }
+            result = detail::lanes_reduce<int32_t>(acc, &std::min<int32_t>);
+        }
+#endif
+        return scalar::min(v, i, count, result);
+    }
+
+    inline int32_t max(const int32_t* v, size_t count) {
+        size_t i = 0;
+        int32_t result = v[0];
+#if JC_SIMD_AVX2
+        if (count >= 8) {
+            __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v));
+            for (i = 8; i + 8 <= count; i += 8) {
+                acc = _mm256_max_epi32(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)));
+            }
+            result = detail::lanes_reduce<int32_t>(acc, &std::max<int32_t>);
+        }
+#elif JC_SIMD_SSE2
+        if (count >= 4) {
+            __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v));
+            for (i = 4; i + 4 <= count; i += 4) {
+                acc = detail::max_epi32(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)));
+            }
+            result = detail::lanes_reduce<int32_t>(acc, &std::max<int32_t>);
+        }
+#endif
+        return scalar::max(v, i, count, result);
+    }
+
+    inline float min(const float* v, size_t count) {
+        size_t i = 0;
+        float result = v[0];
+#if JC_SIMD_AVX2
+        if (count >= 8) {
+            __m256 acc = _mm256_loadu_ps(v);
+            for (i = 8; i + 8 <= count; i += 8) {
+                acc = _mm256_min_ps(acc, _mm256_loadu_ps(v + i));
+            }
+            result = detail::lanes_reduce<float>(acc, &std::min<float>);
+        }
+#elif JC_SIMD_SSE2
+        if (count >= 4) {
+            __m128 acc = _mm_loadu_ps(v);
+            for (i = 4; i + 4 <= count; i += 4) {
+                acc = _mm_min_ps(acc, _mm_loadu_ps(v + i));
+            }
+            result = detail::lanes_reduce<float>(acc, &std::min<float>);
+        }
+#endif
+        return scalar::min(v, i, count, result);
+    }
+
+    inline float max(const float* v, size_t count) {
+        size_t i = 0;
+        float result = v[0];
+#if JC_SIMD_AVX2
+        if (count >= 8) {
+            __m256 acc = _mm256_loadu_ps(v);
+            for (i = 8; i + 8 <= count; i += 8) {
+                acc = _mm256_max_ps(acc, _mm256_loadu_ps(v + i));
+            }
+            result = detail::lanes_reduce<float>(acc, &std::max<float>);
+        }
+#elif JC_SIMD_SSE2
+        if (count >= 4) {
+            __m128 acc = _mm_loadu_ps(v);
+            for (i = 4; i + 4 <= count; i += 4) {
+                acc = _mm_max_ps(acc, _mm_loadu_ps(v + i));
+            }
+            result = detail::lanes_reduce<float>(acc, &std::max<float>);
+        }
+#endif
+        return scalar::max(v, i, count, result);
+    }
+}}
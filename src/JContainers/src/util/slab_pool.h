@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include "util/spinlock.h"
+
+namespace util {
+
+    // Pool of equally sized cells carved out of big slabs.
+    //
+    // Allocation pops a free cell, deallocation pushes it back - no trips to the heap except when the pool grows.
+    // Each cell starts with a header which points to the pool the cell belongs to, so a cell can be
+    // deallocated without knowing its pool. The memory which didn't come from a pool (see the static allocate)
+    // has the same header with no pool in it.
+    //
+    // The cell size is defined by the first allocation.
+    class slab_pool {
+    public:
+
+        struct statistics {
+            size_t cells_in_use;
+            size_t cells_total;
+            size_t slabs;
+            size_t cell_size;
+        };
+
+    private:
+
+        struct alignas(16) cell_header {
+            slab_pool *owner;
+        };
+
+        struct free_cell {
+            free_cell *next;
+        };
+
+        enum : size_t {
+            slab_bytes = 64 * 1024,
+        };
+
+        size_t _cell_size = 0;
+        std::vector<char *> _slabs;
+        free_cell *_free = nullptr;
+        size_t _in_use = 0;
+        mutable spinlock _lock;
+
+        slab_pool(const slab_pool&) = delete;
+        slab_pool& operator = (const slab_pool&) = delete;
+
+        static cell_header *header_of(const void *p) {
+            return reinterpret_cast<cell_header *>(const_cast<char *>(static_cast<const char *>(p)) - sizeof(cell_header));
+        }
+
+        static void *payload_of(cell_header *header) {
+            return reinterpret_cast<char *>(header) + sizeof(cell_header);
+        }
+
+        size_t cells_per_slab() const {
+            return slab_bytes / _cell_size;
+        }
+
+        void u_grow() {
+            char *slab = static_cast<char *>(::operator new(slab_bytes));
+            _slabs.push_back(slab);
+
+            // the free list gets the cells in the order of their addresses
+            for (size_t i = cells_per_slab(); i-- > 0;) {
+                cell_header *header = reinterpret_cast<cell_header *>(slab + i * _cell_size);
+                header->owner = this;
+                free_cell *cell = static_cast<free_cell *>(payload_of(header));
+                cell->next = _free;
+                _free = cell;
+            }
+        }
+
+        void u_free_slabs() {
+            for (char *slab : _slabs) {
+                ::operator delete(slab);
+            }
+            _slabs.clear();
+            _free = nullptr;
+            _in_use = 0;
+        }
+
+    public:
+
+        slab_pool() = default;
+
+        // the slabs with the cells still in use are never freed
+        ~slab_pool() {
+            if (_in_use == 0) {
+                u_free_slabs();
+            }
+        }
+
+        void *allocate(size_t size) {
+            spinlock::guard g(_lock);
+
+            if (_cell_size == 0) {
+                _cell_size = (sizeof(cell_header) + size + alignof(cell_header) - 1) & ~(alignof(cell_header) - 1);
+            }
+            if (sizeof(cell_header) + size > _cell_size) {
+                throw std::bad_alloc();
+            }
+
+            if (!_free) {
+                u_grow();
+            }
+            free_cell *cell = _free;
+            _free = cell->next;
+            ++_in_use;
+            return cell;
+        }
+
+        // allocates from the @pool if there is a pool, otherwise from the heap
+        static void *allocate(slab_pool *pool, size_t size) {
+            if (pool) {
+                return pool->allocate(size);
+            }
+            cell_header *header = static_cast<cell_header *>(::operator new(sizeof(cell_header) + size));
+            header->owner = nullptr;
+            return payload_of(header);
+        }
+
+        static void deallocate(void *p) {
+            if (!p) {
+                return;
+            }
+            cell_header *header = header_of(p);
+            slab_pool *pool = header->owner;
+            if (!pool) {
+                ::operator delete(header);
+                return;
+            }
+
+            spinlock::guard g(pool->_lock);
+            free_cell *cell = static_cast<free_cell *>(p);
+            cell->next = pool->_free;
+            pool->_free = cell;
+            --pool->_in_use;
+        }
+
+        static slab_pool *owner_of(const void *p) {
+            return header_of(p)->owner;
+        }
+
+        // Frees all the slabs at once. The objects which were living in the cells must be destroyed already
+        void u_release_all() {
+            u_free_slabs();
+        }
+
+        statistics u_statistics() const {
+            const size_t slabs = _slabs.size();
+            return statistics{ _in_use, slabs ? slabs * cells_per_slab() : 0, slabs, _cell_size };
+        }
+    };
+}
@@ -2,31 +2,356 @@
 
 #include <atomic>
 #include <mutex>
+#include <thread>
+#include <chrono>
 #include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <immintrin.h>
 
 namespace util {
 
-    class spinlock
+    struct spinlock_statistics {
+        uint64_t acquisitions;  // the lock calls, counted by the counting_spinlock only
+        uint64_t contended;     // the lock calls which have found the lock taken
+        uint64_t pauses;        // the backoff rounds spent spinning
+        uint64_t yields;        // the times the waiter gave up the rest of its time slice
+        uint64_t parks;         // the times the waiter went to sleep
+    };
+
+    namespace detail {
+
+        struct spinlock_counters {
+            std::atomic<uint64_t> acquisitions = 0;
+            std::atomic<uint64_t> contended = 0;
+            std::atomic<uint64_t> pauses = 0;
+            std::atomic<uint64_t> yields = 0;
+            std::atomic<uint64_t> parks = 0;
+
+            void count(std::atomic<uint64_t>& counter, uint64_t amount = 1) {
+                counter.fetch_add(amount, std::memory_order_relaxed);
+            }
+
+            spinlock_statistics statistics() const {
+                return spinlock_statistics{
+                    acquisitions.load(std::memory_order_relaxed),
+                    contended.load(std::memory_order_relaxed),
+                    pauses.load(std::memory_order_relaxed),
+                    yields.load(std::memory_order_relaxed),
+                    parks.load(std::memory_order_relaxed),
+                };
+            }
+        };
+
+        // The contention of all the locks, counted on the contended path only. Each thread counts into its own block,
+        // so the contended locks don't make the threads write to one shared cache line.
+        // The blocks get summed up when the statistics are asked for
+        class thread_contention_counters {
+            // written by the owning thread only
+            std::atomic<uint64_t> _contended = 0;
+            std::atomic<uint64_t> _pauses = 0;
+            std::atomic<uint64_t> _yields = 0;
+            std::atomic<uint64_t> _parks = 0;
+
+            static void add(std::atomic<uint64_t>& counter, uint64_t amount) {
+                counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+            }
+
+        public:
+            thread_contention_counters();
+            ~thread_contention_counters();
+
+            thread_contention_counters(const thread_contention_counters&) = delete;
+            thread_contention_counters& operator = (const thread_contention_counters&) = delete;
+
+            void count(uint64_t pauses, uint64_t yields, uint64_t parks) {
+                add(_contended, 1);
+                add(_pauses, pauses);
+                add(_yields, yields);
+                add(_parks, parks);
+            }
+
+            void add_to(spinlock_statistics& total) const {
+                total.contended += _contended.load(std::memory_order_relaxed);
+                total.pauses += _pauses.load(std::memory_order_relaxed);
+                total.yields += _yields.load(std::memory_order_relaxed);
+                total.parks += _parks.load(std::memory_order_relaxed);
+            }
+        };
+
+        // the blocks of the running threads and the sum of the exited ones
+        class contention_registry {
+            std::mutex _mutex;
+            std::vector<const thread_contention_counters *> _threads;
+            spinlock_statistics _exited = {};
+
+        public:
+            void add(const thread_contention_counters *counters) {
+                std::lock_guard<std::mutex> g(_mutex);
+                _threads.push_back(counters);
+            }
+
+            void remove(const thread_contention_counters *counters) {
+                std::lock_guard<std::mutex> g(_mutex);
+                counters->add_to(_exited);
+                _threads.erase(std::remove(_threads.begin(), _threads.end(), counters), _threads.end());
+            }
+
+            spinlock_statistics total() {
+                std::lock_guard<std::mutex> g(_mutex);
+                spinlock_statistics sum = _exited;
+                for (auto counters : _threads) {
+                    counters->add_to(sum);
+                }
+                return sum;
+            }
+
+            // never destroyed: the threads may exit after the static objects are gone
+            static contention_registry& instance() {
+                static contention_registry *registry = new contention_registry();
+                return *registry;
+            }
+        };
+
+        inline thread_contention_counters::thread_contention_counters() {
+            contention_registry::instance().add(this);
+        }
+
+        inline thread_contention_counters::~thread_contention_counters() {
+            contention_registry::instance().remove(this);
+        }
+
+        inline thread_local thread_contention_counters t_contention_counters;
+
+        struct no_lock_counters {
+            void on_lock() {}
+            void on_contended(uint64_t pauses, uint64_t yields, uint64_t parks) {}
+        };
+
+        // The waiting: spins with exponentially growing pauses, then yields the time slice, then sleeps
+        class backoff {
+            enum : uint32_t {
+                max_pauses = 64,        // the pauses per backoff round, the rounds double the pauses until reaching this
+                spin_rounds = 10,       // then the waiter yields
+                yield_rounds = 64,      // then it sleeps
+            };
+
+            uint32_t _roundPauses = 1;
+
+        public:
+            uint64_t pauses = 0, yields = 0, parks = 0;
+
+            void wait() {
+                if (pauses < spin_rounds) {
+                    for (uint32_t i = 0; i < _roundPauses; ++i) {
+                        _mm_pause();
+                    }
+                    _roundPauses = (std::min)(_roundPauses * 2, uint32_t(max_pauses));
+                    ++pauses;
+                }
+                else if (yields < yield_rounds) {
+                    std::this_thread::yield();
+                    ++yields;
+                }
+                else {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    ++parks;
+                }
+            }
+
+            // counts the contention into the thread's counters
+            void count() const {
+                t_contention_counters.count(pauses, yields, parks);
+            }
+        };
+
+        struct lock_counters {
+            spinlock_counters _counters;
+
+            void on_lock() { _counters.count(_counters.acquisitions); }
+            void on_contended(uint64_t pauses, uint64_t yields, uint64_t parks) {
+                _counters.count(_counters.contended);
+                _counters.count(_counters.pauses, pauses);
+                _counters.count(_counters.yields, yields);
+                _counters.count(_counters.parks, parks);
+            }
+        };
+    }
+
+    // Adaptive spinlock. The waiter spins with exponentially growing pauses, then yields its time slice,
+    // then sleeps - so a lock held for long (by a sort or a deep copy) does not make the waiters burn the cores.
+    // The waiter spins on a plain load, the cache line stays shared until the lock gets released.
+    //
+    // The Counters are either nothing (spinlock, the size of a long as it always was) or the per-lock contention counters
+    // (counting_spinlock). The contention of all the locks is counted anyway, see spinlock_global_statistics.
+    template<class Counters>
+    class basic_spinlock : private Counters
     {
-        // deperecated in C++20 as ctor defaults to zero. MSVC ctor seems to do it, but just to be safe.
-        std::atomic_flag _lock = ATOMIC_FLAG_INIT; 
+        std::atomic<uint32_t> _locked = 0;
+
+        void lock_contended() {
+            detail::backoff waiting;
+            do {
+                while (_locked.load(std::memory_order_relaxed)) {
+                    waiting.wait();
+                }
+            } while (_locked.exchange(1, std::memory_order_acquire));
+
+            waiting.count();
+            Counters::on_contended(waiting.pauses, waiting.yields, waiting.parks);
+        }
 
     public:
 
-        spinlock() {
-            // Likely the old's code here _lock._My_Val have been also an long.
-            static_assert (sizeof (_lock._Storage._Storage._Value) == sizeof (long), "ABI compatibility, check serialization.");
+        basic_spinlock() {
+            static_assert(std::is_same<Counters, detail::lock_counters>::value || sizeof(basic_spinlock) == sizeof(long),
+                "ABI compatibility, check serialization.");
         }
 
+        basic_spinlock(const basic_spinlock&) = delete;
+        basic_spinlock& operator = (const basic_spinlock&) = delete;
+
         void lock() {
-            while(_lock.test_and_set(std::memory_order_acquire))  // acquire lock
-                ; // spin
+            Counters::on_lock();
+            if (_locked.exchange(1, std::memory_order_acquire)) {
+                lock_contended();
+            }
+        }
+
+        bool try_lock() {
+            return _locked.load(std::memory_order_relaxed) == 0 && _locked.exchange(1, std::memory_order_acquire) == 0;
         }
 
         void unlock() {
-            _lock.clear(std::memory_order_release);  
+            _locked.store(0, std::memory_order_release);
         }
 
-        typedef std::lock_guard<spinlock> guard;
+        // the contention counters of this lock
+        template<class C = Counters, class = typename std::enable_if<std::is_same<C, detail::lock_counters>::value>::type>
+        spinlock_statistics statistics() const {
+            return C::_counters.statistics();
+        }
+
+        typedef std::lock_guard<basic_spinlock> guard;
     };
+
+    using spinlock = basic_spinlock<detail::no_lock_counters>;
+    using counting_spinlock = basic_spinlock<detail::lock_counters>;
+
+    // Reader-writer spinlock of the same size: any number of readers or a single writer.
+    // A waiting writer stops the new readers from coming in, so a stream of readers can't starve it.
+    // Neither the readers nor the writers may lock it recursively.
+    class shared_spinlock
+    {
+        enum : uint32_t {
+            writer = 1u << 31,
+            writer_waiting = 1u << 30,
+            readers_mask = writer_waiting - 1,
+        };
+
+        std::atomic<uint32_t> _state = 0;
+
+        void lock_contended() {
+            detail::backoff waiting;
+            for (;;) {
+                uint32_t state = _state.load(std::memory_order_relaxed);
+                if ((state & (writer | readers_mask)) == 0) {
+                    if (_state.compare_exchange_weak(state, writer, std::memory_order_acquire, std::memory_order_relaxed)) {
+                        break;
+                    }
+                    continue;
+                }
+                if (!(state & writer_waiting)) {
+                    _state.fetch_or(writer_waiting, std::memory_order_relaxed);
+                }
+                waiting.wait();
+            }
+            waiting.count();
+        }
+
+        void lock_shared_contended() {
+            detail::backoff waiting;
+            for (;;) {
+                uint32_t state = _state.load(std::memory_order_relaxed);
+                if ((state & (writer | writer_waiting)) == 0) {
+                    if (_state.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                        break;
+                    }
+                    continue;
+                }
+                waiting.wait();
+            }
+            waiting.count();
+        }
+
+    public:
+
+        shared_spinlock() {
+            static_assert(sizeof(shared_spinlock) == sizeof(spinlock), "the same size as the spinlock");
+        }
+
+        shared_spinlock(const shared_spinlock&) = delete;
+        shared_spinlock& operator = (const shared_spinlock&) = delete;
+
+        void lock() {
+            uint32_t state = 0;
+            if (!_state.compare_exchange_strong(state, writer, std::memory_order_acquire, std::memory_order_relaxed)) {
+                lock_contended();
+            }
+        }
+
+        // fails if there are readers or a writer, leaves the waiting writers' flag alone
+        bool try_lock() {
+            uint32_t state = _state.load(std::memory_order_relaxed);
+            return (state & (writer | readers_mask)) == 0 &&
+                _state.compare_exchange_strong(state, state | writer, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+
+        // the waiting writers' flag is kept, it belongs to them
+        void unlock() {
+            _state.fetch_and(~uint32_t(writer), std::memory_order_release);
+        }
+
+        void lock_shared() {
+            uint32_t state = _state.load(std::memory_order_relaxed);
+            if ((state & (writer | writer_waiting)) != 0 ||
+                !_state.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                lock_shared_contended();
+            }
+        }
+
+        // fails if there is a writer or a waiting writer
+        bool try_lock_shared() {
+            uint32_t state = _state.load(std::memory_order_relaxed);
+            while ((state & (writer | writer_waiting)) == 0) {
+                if (_state.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void unlock_shared() {
+            _state.fetch_sub(1, std::memory_order_release);
+        }
+
+        typedef std::lock_guard<shared_spinlock> guard;
+
+        class shared_guard {
+            shared_spinlock& _lock;
+
+            shared_guard(const shared_guard&) = delete;
+            shared_guard& operator = (const shared_guard&) = delete;
+
+        public:
+            explicit shared_guard(shared_spinlock& lock) : _lock(lock) { _lock.lock_shared(); }
+            ~shared_guard() { _lock.unlock_shared(); }
+        };
+    };
+
+    // the contention of all the locks (the acquisitions are not counted), summed up over the threads
+    inline spinlock_statistics spinlock_global_statistics() {
+        return detail::contention_registry::instance().total();
+    }
 }
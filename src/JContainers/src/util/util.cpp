@@ -1,5 +1,7 @@
 #include <boost/filesystem/path.hpp>
 #include <windef.h>
+#include <cstdlib>
+#include <new>
 
 namespace util {
 
@@ -22,8 +24,57 @@ namespace util {
         auto imagePath = dll_path();
         return (imagePath.remove_filename() /= relative_path);
     }
+
+#ifdef JC_COUNT_ALLOCATIONS
+    namespace {
+        thread_local allocation_counter *t_counter = nullptr;
+    }
+
+    allocation_counter::allocation_counter() : _outer(t_counter) {
+        t_counter = this;
+    }
+
+    allocation_counter::~allocation_counter() {
+        t_counter = _outer;
+        if (_outer) {
+            _outer->_count += _count;
+            _outer->_bytes += _bytes;
+        }
+    }
+
+    void count_allocation(size_t size) {
+        if (allocation_counter *counter = t_counter) {
+            ++counter->_count;
+            counter->_bytes += size;
+        }
+    }
+#endif
 }
 
+#ifdef JC_COUNT_ALLOCATIONS
+
+// the array and the nothrow forms end up here as well, the aligned ones are not counted.
+// As the standard one, it calls the new-handler until the memory is found or there is no handler
+void* operator new (size_t size) {
+    util::count_allocation(size);
+    for (;;) {
+        if (void *p = std::malloc(size ? size : 1)) {
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void operator delete (void *p) noexcept {
+    std::free(p);
+}
+
+#endif
+
 //////////////////////////////////////////////////////////////////////////
 // boost 'fix'
 //////////////////////////////////////////////////////////////////////////
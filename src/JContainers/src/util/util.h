@@ -14,6 +14,46 @@ namespace util {
     boost::filesystem::path dll_path();
     boost::filesystem::path relative_to_dll_path(const char *relative_path);
 
+    // Counts the heap allocations (and the bytes requested) the current thread makes while the counter exists.
+    // The allocations get counted in the builds with JC_COUNT_ALLOCATIONS defined only (the Debug configurations, which run the tests):
+    // the global operator new gets replaced there (see util.cpp). The other builds keep the CRT allocator and count nothing.
+    // The counters nest, the outer one counts the allocations of the inner ones
+#ifdef JC_COUNT_ALLOCATIONS
+    class allocation_counter {
+        uint64_t _count = 0;
+        uint64_t _bytes = 0;
+        allocation_counter *_outer;
+
+        friend void count_allocation(size_t size);
+
+    public:
+        enum { counted = true };
+
+        allocation_counter();
+        ~allocation_counter();
+
+        allocation_counter(const allocation_counter&) = delete;
+        allocation_counter& operator = (const allocation_counter&) = delete;
+
+        uint64_t count() const { return _count; }
+        // the allocator's own overhead per allocation is not included
+        uint64_t bytes() const { return _bytes; }
+    };
+#else
+    class allocation_counter {
+    public:
+        enum { counted = false };
+
+        allocation_counter() {}
+
+        allocation_counter(const allocation_counter&) = delete;
+        allocation_counter& operator = (const allocation_counter&) = delete;
+
+        uint64_t count() const { return 0; }
+        uint64_t bytes() const { return 0; }
+    };
+#endif
+
     template<class T>
     void do_with_timing(const char *operation_name, T&& func) {
         assert(operation_name);